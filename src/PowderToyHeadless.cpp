@@ -0,0 +1,425 @@
+#include "client/GameSave.h"
+#include "common/String.h"
+#include "common/platform/Platform.h"
+#include "osc/osc.h"
+#include "osc/timetag.h"
+#include "simulation/ActivityMap.h"
+#include "simulation/Air.h"
+#include "simulation/Simulation.h"
+#include "simulation/SimulationData.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs a save without a window and streams its OSC analytics, for rendering sound on a
+// server and for profiling the simulation and OSC path without a display
+
+using Clock = std::chrono::steady_clock;
+
+static uint64_t nowNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static void usage(const char *self)
+{
+	std::cout << "Usage: " << self << " <save> [options]" << std::endl;
+	std::cout << "       " << self << " --fill ELEM [options]" << std::endl;
+	std::cout << "  --fill ELEM     start from a screen full of ELEM instead of a save, for benchmarks" << std::endl;
+	std::cout << "  --frames N      stop after N frames, 0 (the default) runs forever" << std::endl;
+	std::cout << "  --fps N         frames per second, 0 runs as fast as possible, default 60" << std::endl;
+	std::cout << "  --target URI    where to send OSC, may be repeated, default udp://127.0.0.1:9000" << std::endl;
+	std::cout << "  --latency S     added to bundle timetags, in seconds" << std::endl;
+	std::cout << "  --control URI   listen for control messages, e.g. udp://127.0.0.1:9001" << std::endl;
+	std::cout << "  --record PATH   record the OSC stream, see osc-replay" << std::endl;
+	std::cout << "  --grid WxH      stream the spatial map" << std::endl;
+	std::cout << "  --spectrum MAP  stream spatial frequency features of density or pressure" << std::endl;
+	std::cout << "  --onsets        stream /tpt/onset for sudden pressure rises" << std::endl;
+	std::cout << "  --sample MS     sample the handlers' particles to stay within MS per frame" << std::endl;
+	std::cout << "  --perf          stream /tpt/perf once a second" << std::endl;
+	std::cout << "  --threads N     update particles and air on N threads, default 1" << std::endl;
+	std::cout << "  --deterministic make the outcome independent of --threads" << std::endl;
+	std::cout << "  --sleep         skip particles in parts of the simulation that have settled" << std::endl;
+	std::cout << "  --sleep-check   like --sleep, but update them anyway and count what skipping would miss" << std::endl;
+	std::cout << "  --keep-maps     update the particle maps in place instead of rebuilding them every frame" << std::endl;
+	std::cout << "  --check-maps    like --keep-maps, but check each update against a full rebuild" << std::endl;
+	std::cout << "  --compact       move particles into free slots when few of them are in use" << std::endl;
+	std::cout << "  --check-air     check each air update against the plain scalar one" << std::endl;
+	std::cout << "  --no-osc        only simulate" << std::endl;
+}
+
+struct PhaseTimes
+{
+	uint64_t beforeSim = 0;
+	uint64_t particles = 0;
+	uint64_t afterSim = 0;
+	uint64_t frames = 0;
+};
+
+static void report(const char *label, const PhaseTimes &times, uint64_t wallNs)
+{
+	auto perFrameMs = [&times](uint64_t ns) {
+		return times.frames ? ns / 1e6 / times.frames : 0.0;
+	};
+	std::cout << std::fixed << std::setprecision(3)
+	          << label << ": " << times.frames << " frames, "
+	          << (wallNs ? times.frames * 1e9 / wallNs : 0.0) << " fps, per frame: "
+	          << "BeforeSim " << perFrameMs(times.beforeSim) << " ms, "
+	          << "UpdateParticles " << perFrameMs(times.particles) << " ms, "
+	          << "AfterSim " << perFrameMs(times.afterSim) << " ms" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t frames = 0;
+	double fps = 60;
+	double latency = 0;
+	bool osc = true;
+	int gridWidth = 0, gridHeight = 0;
+	float sampleBudgetMs = 0;
+	auto spectrumSource = OscSpectrumOff;
+	bool onsets = false;
+	bool perf = false;
+	int threads = 1;
+	bool deterministic = false;
+	bool sleep = false, sleepCheck = false;
+	bool incrementalMaps = false, validateMaps = false;
+	bool compact = false;
+	bool checkAir = false;
+	std::vector<std::string> targets;
+	std::string control, record;
+	std::string savePath, fill;
+	for (int i = 1; i < argc; ++i)
+	{
+		auto arg = std::string(argv[i]);
+		auto value = [&]() -> std::string {
+			if (i + 1 >= argc)
+			{
+				std::cerr << arg << " needs a value" << std::endl;
+				exit(1);
+			}
+			return argv[++i];
+		};
+		try
+		{
+			if (arg[0] != '-' && savePath.empty() && fill.empty())
+			{
+				savePath = arg;
+			}
+			else if (arg == "--fill" && savePath.empty())
+			{
+				fill = value();
+			}
+			else if (arg == "--frames")
+			{
+				frames = std::stoull(value());
+			}
+			else if (arg == "--fps")
+			{
+				fps = std::stod(value());
+			}
+			else if (arg == "--target")
+			{
+				targets.push_back(value());
+			}
+			else if (arg == "--latency")
+			{
+				latency = std::stod(value());
+			}
+			else if (arg == "--control")
+			{
+				control = value();
+			}
+			else if (arg == "--record")
+			{
+				record = value();
+			}
+			else if (arg == "--grid")
+			{
+				auto size = value();
+				auto x = size.find('x');
+				if (x == std::string::npos)
+				{
+					throw std::invalid_argument(size);
+				}
+				gridWidth = std::stoi(size.substr(0, x));
+				gridHeight = std::stoi(size.substr(x + 1));
+			}
+			else if (arg == "--spectrum")
+			{
+				auto name = value();
+				auto it = std::find(oscSpectrumSourceNames.begin(), oscSpectrumSourceNames.end(), name);
+				if (it == oscSpectrumSourceNames.end())
+				{
+					throw std::invalid_argument(name);
+				}
+				spectrumSource = OscSpectrumSource(it - oscSpectrumSourceNames.begin());
+			}
+			else if (arg == "--onsets")
+			{
+				onsets = true;
+			}
+			else if (arg == "--perf")
+			{
+				perf = true;
+			}
+			else if (arg == "--sample")
+			{
+				sampleBudgetMs = std::stof(value());
+			}
+			else if (arg == "--threads")
+			{
+				threads = std::stoi(value());
+				if (threads < 1)
+				{
+					throw std::invalid_argument(arg);
+				}
+			}
+			else if (arg == "--deterministic")
+			{
+				deterministic = true;
+			}
+			else if (arg == "--sleep")
+			{
+				sleep = true;
+			}
+			else if (arg == "--sleep-check")
+			{
+				sleep = true;
+				sleepCheck = true;
+			}
+			else if (arg == "--keep-maps")
+			{
+				incrementalMaps = true;
+			}
+			else if (arg == "--check-maps")
+			{
+				incrementalMaps = true;
+				validateMaps = true;
+			}
+			else if (arg == "--compact")
+			{
+				compact = true;
+			}
+			else if (arg == "--check-air")
+			{
+				checkAir = true;
+			}
+			else if (arg == "--no-osc")
+			{
+				osc = false;
+			}
+			else
+			{
+				usage(argv[0]);
+				return 1;
+			}
+		}
+		catch (const std::logic_error &)
+		{
+			std::cerr << "invalid value for " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	if (savePath.empty() && fill.empty())
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	auto simulationData = std::make_unique<SimulationData>();
+
+	auto sim = std::make_unique<Simulation>();
+	if (!fill.empty())
+	{
+		auto type = simulationData->GetParticleType(ByteString(fill));
+		if (type <= 0)
+		{
+			std::cerr << "no such element: " << fill << std::endl;
+			return 1;
+		}
+		// the same scene every time, so frame times can be compared between builds
+		sim->rng.seed(0);
+		for (int y = 0; y < YRES; ++y)
+		{
+			for (int x = 0; x < XRES; ++x)
+			{
+				sim->create_part(-1, x, y, type);
+			}
+		}
+	}
+	else
+	{
+		std::vector<char> fileData;
+		if (!Platform::ReadFile(fileData, ByteString(savePath)))
+		{
+			std::cerr << "cannot read " << savePath << std::endl;
+			return 1;
+		}
+		std::unique_ptr<GameSave> gameSave;
+		try
+		{
+			gameSave = std::make_unique<GameSave>(fileData, false);
+		}
+		catch (const ParseException &e)
+		{
+			std::cerr << "cannot load " << savePath << ": " << e.what() << std::endl;
+			return 1;
+		}
+
+		sim->Load(gameSave.get(), true, { 0, 0 });
+		// same as GameModel::SaveToSimParameters
+		sim->gravityMode = gameSave->gravityMode;
+		sim->customGravityX = gameSave->customGravityX;
+		sim->customGravityY = gameSave->customGravityY;
+		sim->air->airMode = gameSave->airMode;
+		sim->air->ambientAirTemp = gameSave->ambientAirTemp;
+		sim->edgeMode = gameSave->edgeMode;
+		sim->legacy_enable = gameSave->legacyEnable;
+		sim->water_equal_test = gameSave->waterEEnabled;
+		sim->aheat_enable = gameSave->aheatEnable;
+		sim->EnableNewtonianGravity(gameSave->gravityEnable);
+		sim->frameCount = gameSave->frameCount;
+		if (gameSave->hasRngState)
+		{
+			sim->rng.state(gameSave->rngState);
+		}
+		sim->ensureDeterminism = gameSave->ensureDeterminism;
+	}
+	// unlike the game, we never start paused
+	sim->sys_pause = 0;
+	sim->updateThreads = threads;
+	sim->deterministicUpdate = deterministic;
+	sim->sleepingTiles = sleep;
+	sim->sleepCheck = sleepCheck;
+	sim->incrementalMaps = incrementalMaps;
+	sim->validateMaps = validateMaps;
+	sim->compactParticles = compact;
+	sim->air->checkReference = checkAir;
+
+	if (osc)
+	{
+		sim->oscClient = std::make_unique<TPTOscClient>();
+		try
+		{
+			if (!targets.empty())
+			{
+				sim->oscClient->SetTargets(targets);
+			}
+			sim->oscClient->SetLatency(latency);
+			sim->oscClient->SetControl(control);
+			sim->oscClient->SetRecording(record);
+		}
+		catch (const std::runtime_error &e)
+		{
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+		sim->oscClient->SetGridSize(gridWidth, gridHeight);
+		sim->oscClient->SetSpectrumSource(spectrumSource);
+		OscOnsetConfig onsetConfig;
+		onsetConfig.enabled = onsets;
+		sim->oscClient->SetOnsetConfig(onsetConfig);
+		sim->oscClient->SetPerf(perf);
+		if (sampleBudgetMs > 0)
+		{
+			OscSamplingConfig samplingConfig;
+			samplingConfig.enabled = true;
+			samplingConfig.budgetMs = sampleBudgetMs;
+			sim->oscClient->SetSamplingConfig(samplingConfig);
+		}
+	}
+
+	uint64_t frameNs = fps > 0 ? uint64_t(1e9 / fps) : 0;
+	auto startNs = nowNs();
+	auto nextFrameNs = startNs;
+	auto lastReportNs = startNs;
+	PhaseTimes total, interval;
+	for (uint64_t frame = 0; !frames || frame < frames; ++frame)
+	{
+		if (frameNs)
+		{
+			auto now = nowNs();
+			if (now > nextFrameNs + frameNs)
+			{
+				// fell more than a frame behind, don't try to catch up with a burst of frames
+				nextFrameNs = now;
+			}
+			std::this_thread::sleep_for(std::chrono::nanoseconds(int64_t(nextFrameNs - std::min(nextFrameNs, now))));
+			SetOscFrameTime(nextFrameNs);
+			nextFrameNs += frameNs;
+		}
+		else
+		{
+			SetOscFrameTime(nowNs());
+		}
+
+		auto t0 = nowNs();
+		sim->BeforeSim();
+		if (sim->oscPauseRequest)
+		{
+			sim->sys_pause = *sim->oscPauseRequest;
+			sim->oscPauseRequest.reset();
+		}
+		auto t1 = nowNs();
+		auto t2 = t1;
+		// /tpt/pause may have paused us; like GameController, only BeforeSim runs then, so
+		// control messages are still applied
+		if (!sim->sys_pause || sim->framerender)
+		{
+			{
+				OscPerfScope perfScope(OscPerfParticles);
+				sim->UpdateParticles(0, NPART);
+			}
+			t2 = nowNs();
+			sim->AfterSim();
+		}
+		auto t3 = nowNs();
+
+		for (auto *times : { &total, &interval })
+		{
+			times->beforeSim += t1 - t0;
+			times->particles += t2 - t1;
+			times->afterSim += t3 - t2;
+			times->frames += 1;
+		}
+		if (t3 - lastReportNs >= 1000000000)
+		{
+			report("last second", interval, t3 - lastReportNs);
+			interval = {};
+			lastReportNs = t3;
+		}
+	}
+	report("total", total, nowNs() - startNs);
+	if (sleep)
+	{
+		std::cout << "Sleeping tiles: " << sim->CountSleepingTiles() << " of " << ACTIVITY_TILES << " asleep";
+		if (sleepCheck)
+		{
+			std::cout << ", " << sim->GetSleepCheckMisses() << " misses";
+		}
+		std::cout << std::endl;
+	}
+	if (validateMaps)
+	{
+		std::cout << "Incremental maps: " << sim->GetMapDrifts() << " drifts" << std::endl;
+	}
+	if (checkAir)
+	{
+		std::cout << "Air: " << sim->air->referenceMismatches << " mismatches" << std::endl;
+	}
+	if (sim->oscClient)
+	{
+		auto stats = sim->oscClient->GetSenderStats();
+		std::cout << "OSC: " << stats.published << " frames published, " << stats.sent << " sent, "
+		          << stats.dropped << " dropped, " << stats.late << " late" << std::endl;
+	}
+	return 0;
+}
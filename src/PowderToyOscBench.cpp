@@ -0,0 +1,114 @@
+#include "common/tpt-rand.h"
+#include "osc/handler.h"
+#include "SimulationConfig.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+// Times the per-frame element ranking that TPTOscClient does against the sorter it replaced.
+// Exits non-zero if the two disagree on the counts of the top HANDLERS types.
+
+using Clock = std::chrono::steady_clock;
+
+// The per-frame element sorter that ElementRanking replaced, kept only to compare against
+struct MapSorter
+{
+	std::unordered_map<int, int> idCounts;
+	std::vector<int> types;
+
+	void update(int v)
+	{
+		idCounts[v]++;
+		if (std::find(types.begin(), types.end(), v) == types.end())
+		{
+			types.push_back(v);
+		}
+	}
+
+	std::vector<int> getres()
+	{
+		std::sort(types.begin(), types.end(), [this](int k1, int k2) {
+			return idCounts[k1] > idCounts[k2];
+		});
+		return types;
+	}
+
+	void reset()
+	{
+		idCounts.clear();
+		types.clear();
+	}
+};
+
+template<class Frame>
+static double timeFrames(int frames, Frame &&frame)
+{
+	auto start = Clock::now();
+	for (int f = 0; f < frames; ++f)
+	{
+		frame();
+	}
+	return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / frames;
+}
+
+// Counts and ranks frames of particles with both, like TPTOscClient does once per frame, and
+// reports the time per frame. The particles are of 14 types, the kth of them about 1/(k+1) as
+// common as the first, in a fixed order so runs can be compared between builds.
+int main()
+{
+	constexpr int benchTypes = 14;
+	RNG rng;
+	rng.seed(0);
+	std::array<int, benchTypes + 1> weights;
+	weights[0] = 0;
+	for (int k = 0; k < benchTypes; ++k)
+	{
+		weights[k + 1] = weights[k] + 840 / (k + 1);
+	}
+	MapSorter sorter;
+	ElementRanking ranking;
+	for (auto particles : { 10000, 100000, XRES * YRES })
+	{
+		std::vector<int> frameTypes(particles);
+		for (auto &type : frameTypes)
+		{
+			auto pick = rng.between(0, weights[benchTypes] - 1);
+			type = 1 + int(std::upper_bound(weights.begin() + 1, weights.end(), pick) - weights.begin() - 1);
+		}
+		auto frames = std::max(2000000 / particles, 10);
+		std::vector<int> sorted;
+		auto mapUs = timeFrames(frames, [&]() {
+			sorter.reset();
+			for (auto type : frameTypes)
+			{
+				sorter.update(type);
+			}
+			sorted = sorter.getres();
+		});
+		auto rankingUs = timeFrames(frames, [&]() {
+			ranking.reset();
+			for (auto type : frameTypes)
+			{
+				ranking.update(type);
+			}
+		});
+		auto agree = ranking.size() == std::min(int(sorted.size()), HANDLERS);
+		for (int rank = 0; agree && rank < ranking.size(); ++rank)
+		{
+			agree = ranking.count(ranking.type(rank)) == sorter.idCounts[sorted[rank]];
+		}
+		std::cout << std::fixed << std::setprecision(0)
+		          << particles << " particles: sorter " << mapUs << " us, ElementRanking " << rankingUs
+		          << " us per frame, top " << HANDLERS << " counts " << (agree ? "agree" : "DIFFER") << std::endl;
+		if (!agree)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
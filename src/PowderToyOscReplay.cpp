@@ -0,0 +1,156 @@
+#include "osc/record.h"
+#include "osc/transport.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#ifdef WINDOWS
+# include <winsock2.h>
+# pragma comment(lib, "WS2_32.lib")
+#endif
+
+// Bundle timetags live at offset 8, right after "#bundle\0"
+constexpr size_t timetagOffset = 8;
+
+static uint64_t ntpToNs(uint64_t timetag)
+{
+	return (timetag >> 32) * UINT64_C(1000000000) + (((timetag & UINT32_MAX) * UINT64_C(1000000000)) >> 32);
+}
+
+static void writeBigEndian(char *out, uint64_t value, int bytes)
+{
+	for (int i = 0; i < bytes; ++i)
+	{
+		out[i] = char(value >> ((bytes - 1 - i) * 8));
+	}
+}
+
+static bool isBundle(const OscLogEntry &entry)
+{
+	return entry.size >= 16 && !std::memcmp(entry.data, "#bundle", 8);
+}
+
+// Sends the recording to target, keeping the original spacing between bundles divided by
+// speed; a speed of 0 sends as fast as the target accepts
+static int stream(OscLogReader &log, const std::string &uri, double speed)
+{
+	auto target = OpenOscTarget(uri);
+	OscLogEntry entry;
+	uint64_t firstTimetagNs = 0;
+	auto start = std::chrono::steady_clock::now();
+	uint64_t sent = 0, failed = 0;
+	bool first = true;
+	while (log.Next(entry))
+	{
+		auto timetagNs = ntpToNs(entry.timetag);
+		if (first)
+		{
+			firstTimetagNs = timetagNs;
+			first = false;
+		}
+		if (speed > 0 && timetagNs > firstTimetagNs)
+		{
+			std::this_thread::sleep_until(start + std::chrono::nanoseconds(int64_t((timetagNs - firstTimetagNs) / speed)));
+		}
+		if (target->transport->Send(entry.data, entry.size))
+		{
+			sent++;
+		}
+		else
+		{
+			failed++;
+		}
+	}
+	std::cout << sent << " packets sent, " << failed << " failed" << std::endl;
+	return 0;
+}
+
+// Writes a SuperCollider NRT score: every packet as a big-endian int32 size followed by the
+// bundle, with timetags rewritten to seconds since the first frame
+static int dumpScore(OscLogReader &log, const std::string &path)
+{
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out)
+	{
+		throw std::runtime_error("cannot create " + path);
+	}
+	OscLogEntry entry;
+	uint64_t firstTimetag = 0;
+	uint64_t written = 0, skipped = 0;
+	bool first = true;
+	std::string packet;
+	while (log.Next(entry))
+	{
+		if (!isBundle(entry))
+		{
+			skipped++;
+			continue;
+		}
+		if (first)
+		{
+			firstTimetag = entry.timetag;
+			first = false;
+		}
+		packet.assign(entry.data, entry.size);
+		writeBigEndian(&packet[timetagOffset], entry.timetag - firstTimetag, 8);
+		char size[4];
+		writeBigEndian(size, packet.size(), 4);
+		out.write(size, sizeof(size));
+		out.write(packet.data(), packet.size());
+		written++;
+	}
+	std::cout << written << " bundles written to " << path;
+	if (skipped)
+	{
+		std::cout << ", " << skipped << " packets without a timetag skipped";
+	}
+	std::cout << std::endl;
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 4 || (std::strcmp(argv[2], "stream") && std::strcmp(argv[2], "nrt")))
+	{
+		std::cout << "Usage: " << argv[0] << " <recording> stream <target> [speed]" << std::endl;
+		std::cout << "       " << argv[0] << " <recording> nrt <output.osc>" << std::endl;
+		std::cout << "Targets are written as in the Osc.Targets preference, e.g. udp://127.0.0.1:57110." << std::endl;
+		std::cout << "A speed of 1 (the default) replays in real time, 0 as fast as possible." << std::endl;
+		return 1;
+	}
+
+#ifdef WINDOWS
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(1, 1), &wsaData) != 0)
+	{
+		std::cerr << "WSAStartup failed" << std::endl;
+		return 1;
+	}
+#endif
+
+	try
+	{
+		OscLogReader log(argv[1]);
+		if (!std::strcmp(argv[2], "stream"))
+		{
+			auto speed = argc > 4 ? std::stod(argv[4]) : 1.0;
+			if (speed < 0)
+			{
+				throw std::runtime_error("speed must not be negative");
+			}
+			return stream(log, argv[3], speed);
+		}
+		return dumpScore(log, argv[3]);
+	}
+	catch (const std::exception &e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+}
@@ -7,6 +7,7 @@
 #include "common/platform/Platform.h"
 #include "common/clipboard/Clipboard.h"
 #include "FrameSchedule.h"
+#include "osc/timetag.h"
 #include <iostream>
 
 int desktopWidth = 1280;
@@ -479,6 +480,8 @@ std::optional<uint64_t> EngineProcess()
 			correctedFrameTimeAvg = correctedFrameTimeAvg + (correctedFrameTime - correctedFrameTimeAvg) * 0.05;
 		}
 		prevContributesToFps = thisContributesToFps;
+		// when the fps is limited, the armed schedule is the tick's nominal start, which is evenly spaced
+		SetOscFrameTime(std::holds_alternative<FpsLimitExplicit>(fpsLimit) ? tickSchedule.GetNow() : nowNs);
 		engine.SimTick();
 		tickSchedule.SetNow(nowNs);
 	}
@@ -3,6 +3,7 @@
 #include <sys/time.h>
 #include <cstdint>
 #include <mach-o/dyld.h>
+#include <mach/mach.h>
 
 namespace Platform
 {
@@ -22,6 +23,17 @@ long unsigned int GetTime()
 	return (unsigned int)(s.tv_sec * 1000 + s.tv_usec / 1000);
 }
 
+std::optional<uint64_t> ResidentMemory()
+{
+	mach_task_basic_info_data_t info;
+	mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+	if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, task_info_t(&info), &count) != KERN_SUCCESS)
+	{
+		return std::nullopt;
+	}
+	return uint64_t(info.resident_size);
+}
+
 ByteString ExecutableNameFirstApprox()
 {
 	ByteString firstApproximation("?");
@@ -36,6 +36,11 @@ long unsigned int GetTime()
 	return s.tv_sec * 1000 + s.tv_nsec / 1000000;
 }
 
+std::optional<uint64_t> ResidentMemory()
+{
+	return std::nullopt;
+}
+
 ByteString ExecutableNameFirstApprox()
 {
 	return "powder.wasm"; // bogus
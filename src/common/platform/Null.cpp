@@ -7,6 +7,11 @@ void OpenURI(ByteString uri)
 	fprintf(stderr, "cannot open URI: not implemented\n");
 }
 
+std::optional<uint64_t> ResidentMemory()
+{
+	return std::nullopt;
+}
+
 bool CanUpdate()
 {
 	return false;
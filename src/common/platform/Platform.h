@@ -73,6 +73,9 @@ namespace Platform
 
 	std::optional<std::vector<String>> StackTrace();
 
+	// resident set size of this process in bytes, if the platform can tell
+	std::optional<uint64_t> ResidentMemory();
+
 	void MarkPresentable();
 }
 
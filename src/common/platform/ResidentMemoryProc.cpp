@@ -0,0 +1,24 @@
+#include "Platform.h"
+#include <cstdio>
+#include <unistd.h>
+
+namespace Platform
+{
+std::optional<uint64_t> ResidentMemory()
+{
+	// second field is resident pages
+	auto *statm = fopen("/proc/self/statm", "r");
+	if (!statm)
+	{
+		return std::nullopt;
+	}
+	unsigned long size, resident;
+	auto fields = fscanf(statm, "%lu %lu", &size, &resident);
+	fclose(statm);
+	if (fields != 2)
+	{
+		return std::nullopt;
+	}
+	return uint64_t(resident) * uint64_t(sysconf(_SC_PAGESIZE));
+}
+}
@@ -8,6 +8,7 @@
 #include <shlobj.h>
 #include <shlwapi.h>
 #include <windows.h>
+#include <psapi.h>
 #include <crtdbg.h>
 #include <memory>
 
@@ -42,6 +43,17 @@ long unsigned int GetTime()
 	return GetTickCount();
 }
 
+std::optional<uint64_t> ResidentMemory()
+{
+	// the K32 variant lives in kernel32, so this needs no psapi.lib
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return std::nullopt;
+	}
+	return uint64_t(counters.WorkingSetSize);
+}
+
 bool Stat(ByteString filename)
 {
 	struct _stat s;
@@ -0,0 +1,159 @@
+#include "OscAnalytics.h"
+#include "gui/interface/Engine.h"
+#include "simulation/Simulation.h"
+#include "simulation/SimulationData.h"
+#include "graphics/Graphics.h"
+#include "graphics/FontReader.h"
+#include "osc/osc.h"
+#include <algorithm>
+
+constexpr auto panelWidth = 232;
+constexpr auto rowHeight = 28;
+constexpr auto sparklineWidth = 72;
+constexpr auto sparklineHeight = 12;
+
+OscAnalyticsDebug::OscAnalyticsDebug(unsigned int id, const Simulation *newSim):
+	DebugInfo(id),
+	sim(newSim),
+	rateStart(std::chrono::steady_clock::now())
+{
+	for (auto &slot : history)
+	{
+		slot.count.fill(0);
+		slot.temp.fill(0);
+		slot.vel.fill(0);
+	}
+}
+
+void OscAnalyticsDebug::DrawSparkline(int x, int y, int width, int height, const std::array<float, historySize> &values, RGB colour) const
+{
+	Graphics *g = ui::Engine::Ref().g;
+	g->BlendRect(RectSized(Vec2{ x - 1, y - 1 }, Vec2{ width + 2, height + 2 }), 0xFFFFFF_rgb .WithAlpha(40));
+	if (historyFilled < 2)
+	{
+		return;
+	}
+	// oldest sample first, scaled to what is on screen so small wobbles stay visible
+	auto at = [this, &values](int i) {
+		return values[(historyPos - historyFilled + i + historySize) % historySize];
+	};
+	auto low = at(0), high = at(0);
+	for (int i = 1; i < historyFilled; ++i)
+	{
+		low = std::min(low, at(i));
+		high = std::max(high, at(i));
+	}
+	auto range = high - low > 0 ? high - low : 1.0f;
+	auto pointOf = [&](int i) {
+		return Vec2{ x + i * (width - 1) / (historySize - 1), y + height - 1 - int((at(i) - low) / range * (height - 1) + 0.5f) };
+	};
+	for (int i = 1; i < historyFilled; ++i)
+	{
+		g->DrawLine(pointOf(i - 1), pointOf(i), colour);
+	}
+}
+
+void OscAnalyticsDebug::Draw()
+{
+	Graphics *g = ui::Engine::Ref().g;
+	auto *oscClient = sim->oscClient.get();
+	if (!oscClient)
+	{
+		return;
+	}
+	auto &elements = SimulationData::CRef().elements;
+	auto &frame = oscClient->GetLastFrame();
+
+	if (frame.frameNumber != lastFrameNumber)
+	{
+		lastFrameNumber = frame.frameNumber;
+		for (int i = 0; i < HANDLERS; ++i)
+		{
+			auto &params = frame.handlers[i];
+			history[i].count[historyPos] = float(params.count);
+			history[i].temp[historyPos] = float(params.temp.first * 2100 - 273.15);
+			history[i].vel[historyPos] = float(params.vel.first);
+		}
+		historyPos = (historyPos + 1) % historySize;
+		historyFilled = std::min(historyFilled + 1, historySize);
+		costAverageMs = costAverageMs * 0.95f + oscClient->GetFrameCostNs() / 1e6f * 0.05f;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	auto elapsed = std::chrono::duration<float>(now - rateStart).count();
+	if (elapsed >= 1)
+	{
+		auto stats = oscClient->GetSenderStats();
+		sendRate = (stats.sent - rateSent) / elapsed;
+		dropRate = (stats.dropped - rateDropped) / elapsed;
+		rateSent = stats.sent;
+		rateDropped = stats.dropped;
+		rateStart = now;
+	}
+
+	auto frameMax = 1.0f;
+	for (auto &params : frame.handlers)
+	{
+		frameMax = std::max(frameMax, float(params.count));
+	}
+	maxCount = std::max(frameMax, maxCount * (1.0f - 0.015f) + frameMax * 0.015f);
+
+	auto histogramsHeight = frame.eventCount * (FONT_H + 26);
+	auto panelHeight = 2 * FONT_H + 8 + HANDLERS * rowHeight + histogramsHeight;
+	int x = XRES - panelWidth - 5;
+	int y = 5;
+	g->BlendFilledRect(RectSized(Vec2{ x - 5, y - 3 }, Vec2{ panelWidth + 10, panelHeight }), 0x000000_rgb .WithAlpha(180));
+
+	g->BlendText({ x, y }, String::Build("OSC frame ", frame.frameNumber, ", analytics ", Format::Precision(costAverageMs, 3), " ms"), 0xFFFFFF_rgb .WithAlpha(255));
+	y += FONT_H;
+	g->BlendText({ x, y }, String::Build(Format::Precision(sendRate, 1), " bundles/s sent, ", Format::Precision(dropRate, 1), "/s dropped"), dropRate > 0 ? 0xFF8080_rgb .WithAlpha(255) : 0xFFFFFF_rgb .WithAlpha(255));
+	y += FONT_H + 6;
+
+	for (int i = 0; i < HANDLERS; ++i)
+	{
+		auto &params = frame.handlers[i];
+		auto type = frame.voiceTypes[i];
+		auto active = type >= 0 && type < PT_NUM && elements[type].Enabled;
+		RGB colour = active ? elements[type].Colour : 0x808080_rgb;
+		g->DrawFilledRect(RectSized(Vec2{ x, y + 1 }, Vec2{ 7, 7 }), colour);
+		auto label = String::Build(i + 1, " ", active ? elements[type].Name : String("free"));
+		g->BlendText({ x + 10, y }, label, 0xFFFFFF_rgb .WithAlpha(active ? 255 : 120));
+		if (active)
+		{
+			auto info = String::Build(params.count, params.sampled ? String("~") : String(), "  ",
+				Format::Precision(params.temp.first * 2100 - 273.15, 1), "C  v", Format::Precision(params.vel.first, 2));
+			g->BlendText({ x + panelWidth - Graphics::TextSize(info).X, y }, info, 0xFFFFFF_rgb .WithAlpha(200));
+		}
+		// count bar, temperature and velocity sparklines
+		auto barY = y + FONT_H + 2;
+		auto barWidth = int(params.count / maxCount * sparklineWidth + 0.5f);
+		g->BlendRect(RectSized(Vec2{ x - 1, barY - 1 }, Vec2{ sparklineWidth + 2, sparklineHeight + 2 }), 0xFFFFFF_rgb .WithAlpha(40));
+		if (barWidth > 0)
+		{
+			g->DrawFilledRect(RectSized(Vec2{ x, barY }, Vec2{ std::min(barWidth, sparklineWidth), sparklineHeight }), colour);
+		}
+		DrawSparkline(x + sparklineWidth + 8, barY, sparklineWidth, sparklineHeight, history[i].temp, 0xFF8040_rgb);
+		DrawSparkline(x + 2 * (sparklineWidth + 8), barY, sparklineWidth, sparklineHeight, history[i].vel, 0x40C0FF_rgb);
+		y += rowHeight;
+	}
+
+	// event histograms, /tptplantnew/ and /tptplantdel/ unless reconfigured
+	for (int i = 0; i < frame.eventCount; ++i)
+	{
+		auto &histogram = frame.events[i];
+		g->BlendText({ x, y }, ByteString(histogram.address).FromUtf8(), 0xFFFFFF_rgb .WithAlpha(200));
+		y += FONT_H;
+		auto binMax = std::max(1, *std::max_element(histogram.counts.begin(), histogram.counts.begin() + histogram.bins));
+		auto binWidth = std::max(1, panelWidth / std::max(histogram.bins, 1));
+		for (int bin = 0; bin < histogram.bins; ++bin)
+		{
+			auto height = histogram.counts[bin] * 20 / binMax;
+			g->BlendFilledRect(RectSized(Vec2{ x + bin * binWidth, y }, Vec2{ binWidth - 1, 20 }), 0xFFFFFF_rgb .WithAlpha(30));
+			if (height > 0)
+			{
+				g->DrawFilledRect(RectSized(Vec2{ x + bin * binWidth, y + 20 - height }, Vec2{ binWidth - 1, height }), 0x40FF60_rgb);
+			}
+		}
+		y += 26;
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "DebugInfo.h"
+#include "graphics/Pixel.h"
+#include "osc/handler.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+class Simulation;
+class OscAnalyticsDebug : public DebugInfo
+{
+	static constexpr int historySize = 120;
+
+	struct History
+	{
+		std::array<float, historySize> count;
+		std::array<float, historySize> temp;
+		std::array<float, historySize> vel;
+	};
+
+	const Simulation *sim;
+	std::array<History, HANDLERS> history;
+	int historyPos = 0;
+	int historyFilled = 0;
+	uint64_t lastFrameNumber = UINT64_MAX;
+	float maxCount = 1;
+	float costAverageMs = 0;
+
+	std::chrono::steady_clock::time_point rateStart;
+	uint64_t rateSent = 0;
+	uint64_t rateDropped = 0;
+	float sendRate = 0;
+	float dropRate = 0;
+
+	void DrawSparkline(int x, int y, int width, int height, const std::array<float, historySize> &values, RGB colour) const;
+
+public:
+	OscAnalyticsDebug(unsigned int id, const Simulation *newSim);
+
+	void Draw() override;
+};
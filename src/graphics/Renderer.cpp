@@ -8,6 +8,7 @@
 #include "simulation/ElementClasses.h"
 #include "simulation/Air.h"
 #include "simulation/gravity/Gravity.h"
+#include "osc/perf.h"
 #include "simulation/orbitalparts.h"
 #include <cmath>
 
@@ -18,6 +19,8 @@ void Renderer::RenderBackground()
 
 void Renderer::RenderSimulation()
 {
+	OscPerfScope perfScope(OscPerfRender);
+	OscPerfCounters::DrawFrame();
 	draw_grav();
 	DrawWalls();
 	render_parts();
@@ -40,10 +40,10 @@ void Brush::SetRadius(ui::Point newRadius)
 		newRadius.X = 0;
 	if (newRadius.Y < 0)
 		newRadius.Y = 0;
-	if (newRadius.X > 200)
-		newRadius.X = 200;
-	if (newRadius.Y > 200)
-		newRadius.Y = 200;
+	if (newRadius.X > BRUSH_RADIUS_MAX)
+		newRadius.X = BRUSH_RADIUS_MAX;
+	if (newRadius.Y > BRUSH_RADIUS_MAX)
+		newRadius.Y = BRUSH_RADIUS_MAX;
 	radius = newRadius;
 	InitOutline();
 }
@@ -4,6 +4,9 @@
 #include <memory>
 #include <vector>
 
+// largest radius the brush can have along either axis
+constexpr int BRUSH_RADIUS_MAX = 200;
+
 class Graphics;
 class Brush
 {
@@ -24,6 +24,7 @@
 #include "debug/DebugLines.h"
 #include "debug/DebugParts.h"
 #include "debug/ElementPopulation.h"
+#include "debug/OscAnalytics.h"
 #include "debug/ParticleDebug.h"
 #include "debug/SurfaceNormals.h"
 #include "debug/AirVelocity.h"
@@ -98,6 +99,7 @@ GameController::GameController():
 
 	debugInfo.push_back(std::make_unique<DebugParts            >(DEBUG_PARTS     , gameModel->GetSimulation()));
 	debugInfo.push_back(std::make_unique<ElementPopulationDebug>(DEBUG_ELEMENTPOP, gameModel->GetSimulation()));
+	debugInfo.push_back(std::make_unique<OscAnalyticsDebug     >(DEBUG_OSC       , gameModel->GetSimulation()));
 	debugInfo.push_back(std::make_unique<DebugLines            >(DEBUG_LINES     , gameView, this));
 	debugInfo.push_back(std::make_unique<ParticleDebug         >(DEBUG_PARTICLE  , gameModel->GetSimulation(), gameModel));
 	debugInfo.push_back(std::make_unique<SurfaceNormals        >(DEBUG_SURFNORM  , gameModel->GetSimulation(), gameView, this));
@@ -21,6 +21,7 @@ constexpr auto DEBUG_SURFNORM   = 0x0010;
 constexpr auto DEBUG_SIMHUD     = 0x0020;
 constexpr auto DEBUG_RENHUD     = 0x0040;
 constexpr auto DEBUG_AIRVEL     = 0x0080;
+constexpr auto DEBUG_OSC        = 0x0100;
 
 class DebugInfo;
 class SaveFile;
@@ -1,6 +1,8 @@
 #pragma once
 #include "common/String.h"
 #include <variant>
+#include <vector>
+#include <utility>
 #include <cstdint>
 
 enum EventTraits : uint32_t
@@ -108,6 +110,12 @@ struct AfterSimEvent
 	static constexpr EventTraits traits = eventTraitSimRng;
 };
 
+struct CompactPartsEvent
+{
+	static constexpr EventTraits traits = eventTraitSimRng;
+	std::vector<std::pair<int, int>> moved; // old id, new id
+};
+
 struct BeforeSimDrawEvent
 {
 	static constexpr EventTraits traits = eventTraitSimGraphics | eventTraitHindersSrt | eventTraitInterface;
@@ -132,6 +140,7 @@ using GameControllerEvent = std::variant<
 	CloseEvent,
 	BeforeSimEvent,
 	AfterSimEvent,
+	CompactPartsEvent,
 	BeforeSimDrawEvent,
 	AfterSimDrawEvent
 >;
@@ -31,6 +31,7 @@
 #include "simulation/ElementClasses.h"
 #include "simulation/ElementGraphics.h"
 #include "simulation/ToolClasses.h"
+#include "osc/osc.h"
 #include "gui/game/tool/DecorationTool.h"
 #include "gui/game/tool/ElementTool.h"
 #include "gui/game/tool/GOLTool.h"
@@ -129,6 +130,80 @@ GameModel::GameModel(GameView *newView):
 	}
 	sim->aheat_enable = prefs.Get("Simulation.AmbientHeat", 0); // TODO: AmbientHeat enum
 	sim->pretty_powder = prefs.Get("Simulation.PrettyPowder", 0); // TODO: PrettyPowder enum
+	sim->updateThreads = std::max(prefs.Get("Simulation.UpdateThreads", 1), 1);
+	sim->deterministicUpdate = prefs.Get("Simulation.DeterministicUpdate", false);
+	sim->sleepingTiles = prefs.Get("Simulation.SleepingTiles", false);
+	sim->sleepCheck = prefs.Get("Simulation.SleepCheck", false);
+	sim->incrementalMaps = prefs.Get("Simulation.IncrementalMaps", false);
+	sim->validateMaps = prefs.Get("Simulation.ValidateMaps", false);
+	sim->compactParticles = prefs.Get("Simulation.CompactParticles", false);
+	sim->air->checkReference = prefs.Get("Simulation.CheckAir", false);
+
+	//Load config into OSC client
+	sim->oscClient = std::make_unique<TPTOscClient>();
+	sim->oscClient->SetLatency(prefs.Get("Osc.Latency", 0.0f));
+	{
+		VoiceAllocatorConfig voiceConfig;
+		voiceConfig.releaseBelow = prefs.Get("Osc.VoiceReleaseBelow", voiceConfig.releaseBelow);
+		voiceConfig.releaseFrames = prefs.Get("Osc.VoiceReleaseFrames", voiceConfig.releaseFrames);
+		voiceConfig.stealRatio = prefs.Get("Osc.VoiceStealRatio", voiceConfig.stealRatio);
+		sim->oscClient->SetVoiceConfig(voiceConfig);
+	}
+	{
+		OscDeltaConfig deltaConfig;
+		deltaConfig.enabled = prefs.Get("Osc.Delta", deltaConfig.enabled);
+		deltaConfig.keyframeInterval = prefs.Get("Osc.DeltaKeyframeInterval", deltaConfig.keyframeInterval);
+		for (int field = 0; field < NUM_HANDLER_FIELDS; field++)
+		{
+			deltaConfig.deadbands[field] = prefs.Get(ByteString("Osc.Deadband.") + oscHandlerFieldNames[field], deltaConfig.deadbands[field]);
+		}
+		sim->oscClient->SetDeltaConfig(deltaConfig);
+	}
+	{
+		OscSamplingConfig samplingConfig;
+		samplingConfig.enabled = prefs.Get("Osc.Sampling", samplingConfig.enabled);
+		samplingConfig.budgetMs = prefs.Get("Osc.SamplingBudgetMs", samplingConfig.budgetMs);
+		samplingConfig.minPerType = prefs.Get("Osc.SamplingMinPerType", samplingConfig.minPerType);
+		sim->oscClient->SetSamplingConfig(samplingConfig);
+	}
+	{
+		OscOnsetConfig onsetConfig;
+		onsetConfig.enabled = prefs.Get("Osc.Onsets", onsetConfig.enabled);
+		onsetConfig.sensitivity = prefs.Get("Osc.OnsetSensitivity", onsetConfig.sensitivity);
+		onsetConfig.minMagnitude = prefs.Get("Osc.OnsetMinMagnitude", onsetConfig.minMagnitude);
+		onsetConfig.adaptRate = prefs.Get("Osc.OnsetAdaptRate", onsetConfig.adaptRate);
+		sim->oscClient->SetOnsetConfig(onsetConfig);
+	}
+	sim->oscClient->SetPerf(prefs.Get("Osc.Perf", false));
+	sim->oscClient->SetGridSize(prefs.Get("Osc.GridWidth", 0), prefs.Get("Osc.GridHeight", 0));
+	{
+		auto source = prefs.Get("Osc.Spectrum", ByteString(oscSpectrumSourceNames[OscSpectrumOff]));
+		auto it = std::find(oscSpectrumSourceNames.begin(), oscSpectrumSourceNames.end(), source);
+		if (it != oscSpectrumSourceNames.end())
+		{
+			sim->oscClient->SetSpectrumSource(OscSpectrumSource(it - oscSpectrumSourceNames.begin()));
+		}
+	}
+	{
+		auto targets = prefs.Get("Osc.Targets", std::vector<ByteString>{ "udp://127.0.0.1:9000" });
+		try
+		{
+			sim->oscClient->SetTargets(std::vector<std::string>(targets.begin(), targets.end()));
+		}
+		catch (const std::runtime_error &e)
+		{
+			std::cerr << "failed to set up OSC targets: " << e.what() << std::endl;
+		}
+	}
+	// off unless configured, e.g. "udp://127.0.0.1:9001"; anyone who can reach the port can draw
+	try
+	{
+		sim->oscClient->SetControl(prefs.Get("Osc.Control", ByteString("")));
+	}
+	catch (const std::runtime_error &e)
+	{
+		std::cerr << "failed to set up OSC control: " << e.what() << std::endl;
+	}
 
 	Favorite::Ref().LoadFavoritesFromPrefs();
 
@@ -1568,7 +1643,10 @@ void GameModel::UpdateUpTo(int upTo)
 	{
 		BeforeSim();
 	}
-	sim->UpdateParticles(sim->debug_nextToUpdate, upTo);
+	{
+		OscPerfScope perfScope(OscPerfParticles);
+		sim->UpdateParticles(sim->debug_nextToUpdate, upTo);
+	}
 	if (upTo < NPART)
 	{
 		sim->debug_nextToUpdate = upTo;
@@ -1587,6 +1665,18 @@ void GameModel::BeforeSim()
 		CommandInterface::Ref().HandleEvent(BeforeSimEvent{});
 	}
 	sim->BeforeSim();
+	if (sim->oscPauseRequest)
+	{
+		// through SetPaused, so the pause button follows and the debug update catches up
+		SetPaused(*sim->oscPauseRequest);
+		sim->oscPauseRequest.reset();
+	}
+	if (!sim->compactedIds.empty())
+	{
+		// for scripts that hold on to particle ids
+		CommandInterface::Ref().HandleEvent(CompactPartsEvent{ std::move(sim->compactedIds) });
+		sim->compactedIds.clear();
+	}
 }
 
 void GameModel::AfterSim()
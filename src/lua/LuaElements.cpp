@@ -878,6 +878,7 @@ void LuaElements::Open(lua_State *L)
 	LCONST(PROP_LIFE_KILL_DEC);
 	LCONST(PROP_SPARKSETTLE);
 	LCONST(PROP_NOAMBHEAT);
+	LCONST(PROP_SERIAL);
 	LCONST(PROP_NOCTYPEDRAW);
 	LCONST(SC_WALL);
 	LCONST(SC_ELEC);
@@ -80,6 +80,7 @@ void LuaEvent::Open(lua_State *L)
 	LVICONST(CloseEvent        , "CLOSE"        );
 	LVICONST(BeforeSimEvent    , "BEFORESIM"    );
 	LVICONST(AfterSimEvent     , "AFTERSIM"     );
+	LVICONST(CompactPartsEvent , "COMPACTPARTS" );
 	LVICONST(BeforeSimDrawEvent, "BEFORESIMDRAW");
 	LVICONST(AfterSimDrawEvent , "AFTERSIMDRAW" );
 #undef LVICONST
@@ -299,6 +299,7 @@ void LuaMisc::Open(lua_State *L)
 	LCONST(DEBUG_SIMHUD);
 	LCONST(DEBUG_RENHUD);
 	LCONST(DEBUG_AIRVEL);
+	LCONST(DEBUG_OSC);
 #undef LCONST
 	{
 		lua_newtable(L);
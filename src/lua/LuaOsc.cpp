@@ -0,0 +1,657 @@
+#include "LuaScriptInterface.h"
+#include "osc/osc.h"
+#include "simulation/Simulation.h"
+#include "simulation/SimulationData.h"
+#include <array>
+#include <stdexcept>
+
+static TPTOscClient *getOscClient(lua_State *L)
+{
+	auto *oscClient = GetLSI()->sim->oscClient.get();
+	if (!oscClient)
+	{
+		luaL_error(L, "OSC is not enabled for this simulation");
+	}
+	return oscClient;
+}
+
+static int targets(lua_State *L)
+{
+	auto *oscClient = getOscClient(L);
+	if (lua_gettop(L))
+	{
+		luaL_checktype(L, 1, LUA_TTABLE);
+		std::vector<std::string> uris;
+		auto count = int(lua_objlen(L, 1));
+		for (auto i = 1; i <= count; ++i)
+		{
+			lua_rawgeti(L, 1, i);
+			uris.push_back(tpt_lua_checkByteString(L, -1));
+			lua_pop(L, 1);
+		}
+		try
+		{
+			oscClient->SetTargets(uris);
+		}
+		catch (const std::runtime_error &e)
+		{
+			return luaL_error(L, "%s", e.what());
+		}
+		return 0;
+	}
+	lua_newtable(L);
+	int i = 0;
+	for (auto &uri : oscClient->GetTargets())
+	{
+		tpt_lua_pushByteString(L, uri);
+		lua_rawseti(L, -2, ++i);
+	}
+	return 1;
+}
+
+static int latency(lua_State *L)
+{
+	auto *oscClient = getOscClient(L);
+	if (lua_gettop(L))
+	{
+		oscClient->SetLatency(luaL_checknumber(L, 1));
+		return 0;
+	}
+	lua_pushnumber(L, oscClient->GetLatency());
+	return 1;
+}
+
+// tpt.osc.record("path") starts recording every sent bundle, tpt.osc.record("") stops
+static int record(lua_State *L)
+{
+	auto *oscClient = getOscClient(L);
+	if (lua_gettop(L))
+	{
+		try
+		{
+			oscClient->SetRecording(tpt_lua_checkByteString(L, 1));
+		}
+		catch (const std::runtime_error &e)
+		{
+			return luaL_error(L, "%s", e.what());
+		}
+		return 0;
+	}
+	auto path = oscClient->GetRecording();
+	if (path.empty())
+	{
+		lua_pushnil(L);
+	}
+	else
+	{
+		tpt_lua_pushByteString(L, path);
+	}
+	return 1;
+}
+
+// tpt.osc.delta{ enabled = true, keyframeInterval = 60, deadbands = { temp = 0.01 } }, fields
+// that are left out keep their current values; without arguments returns the current settings
+static int delta(lua_State *L)
+{
+	auto *oscClient = getOscClient(L);
+	auto config = oscClient->GetDeltaConfig();
+	if (lua_gettop(L))
+	{
+		luaL_checktype(L, 1, LUA_TTABLE);
+		lua_getfield(L, 1, "enabled");
+		if (!lua_isnil(L, -1))
+		{
+			config.enabled = lua_toboolean(L, -1);
+		}
+		lua_pop(L, 1);
+		lua_getfield(L, 1, "keyframeInterval");
+		config.keyframeInterval = luaL_optinteger(L, -1, config.keyframeInterval);
+		lua_pop(L, 1);
+		lua_getfield(L, 1, "deadbands");
+		if (lua_istable(L, -1))
+		{
+			for (int field = 0; field < NUM_HANDLER_FIELDS; ++field)
+			{
+				lua_getfield(L, -1, oscHandlerFieldNames[field]);
+				config.deadbands[field] = float(luaL_optnumber(L, -1, config.deadbands[field]));
+				lua_pop(L, 1);
+			}
+		}
+		lua_pop(L, 1);
+		oscClient->SetDeltaConfig(config);
+		return 0;
+	}
+	lua_newtable(L);
+	lua_pushboolean(L, config.enabled);
+	lua_setfield(L, -2, "enabled");
+	lua_pushinteger(L, config.keyframeInterval);
+	lua_setfield(L, -2, "keyframeInterval");
+	lua_newtable(L);
+	for (int field = 0; field < NUM_HANDLER_FIELDS; ++field)
+	{
+		lua_pushnumber(L, config.deadbands[field]);
+		lua_setfield(L, -2, oscHandlerFieldNames[field]);
+	}
+	lua_setfield(L, -2, "deadbands");
+	return 1;
+}
+
+// tpt.osc.sampling{ enabled = true, budgetMs = 0.25, minPerType = 64 }, fields that are left
+// out keep their current values; without arguments returns the current settings and stride
+static int sampling(lua_State *L)
+{
+	auto *oscClient = getOscClient(L);
+	auto config = oscClient->GetSamplingConfig();
+	if (lua_gettop(L))
+	{
+		luaL_checktype(L, 1, LUA_TTABLE);
+		lua_getfield(L, 1, "enabled");
+		if (!lua_isnil(L, -1))
+		{
+			config.enabled = lua_toboolean(L, -1);
+		}
+		lua_pop(L, 1);
+		lua_getfield(L, 1, "budgetMs");
+		config.budgetMs = float(luaL_optnumber(L, -1, config.budgetMs));
+		lua_pop(L, 1);
+		lua_getfield(L, 1, "minPerType");
+		config.minPerType = luaL_optinteger(L, -1, config.minPerType);
+		lua_pop(L, 1);
+		oscClient->SetSamplingConfig(config);
+		return 0;
+	}
+	lua_newtable(L);
+	lua_pushboolean(L, config.enabled);
+	lua_setfield(L, -2, "enabled");
+	lua_pushnumber(L, config.budgetMs);
+	lua_setfield(L, -2, "budgetMs");
+	lua_pushinteger(L, config.minPerType);
+	lua_setfield(L, -2, "minPerType");
+	lua_pushinteger(L, oscClient->GetSamplingStride());
+	lua_setfield(L, -2, "stride");
+	return 1;
+}
+
+// tpt.osc.onsets{ enabled = true, sensitivity = 4, minMagnitude = 0.5, adaptRate = 0.05 }, fields
+// that are left out keep their current values; without arguments returns the current settings
+static int onsets(lua_State *L)
+{
+	auto *oscClient = getOscClient(L);
+	auto config = oscClient->GetOnsetConfig();
+	if (lua_gettop(L))
+	{
+		luaL_checktype(L, 1, LUA_TTABLE);
+		lua_getfield(L, 1, "enabled");
+		if (!lua_isnil(L, -1))
+		{
+			config.enabled = lua_toboolean(L, -1);
+		}
+		lua_pop(L, 1);
+		lua_getfield(L, 1, "sensitivity");
+		config.sensitivity = float(luaL_optnumber(L, -1, config.sensitivity));
+		lua_pop(L, 1);
+		lua_getfield(L, 1, "minMagnitude");
+		config.minMagnitude = float(luaL_optnumber(L, -1, config.minMagnitude));
+		lua_pop(L, 1);
+		lua_getfield(L, 1, "adaptRate");
+		config.adaptRate = float(luaL_optnumber(L, -1, config.adaptRate));
+		lua_pop(L, 1);
+		oscClient->SetOnsetConfig(config);
+		return 0;
+	}
+	lua_newtable(L);
+	lua_pushboolean(L, config.enabled);
+	lua_setfield(L, -2, "enabled");
+	lua_pushnumber(L, config.sensitivity);
+	lua_setfield(L, -2, "sensitivity");
+	lua_pushnumber(L, config.minMagnitude);
+	lua_setfield(L, -2, "minMagnitude");
+	lua_pushnumber(L, config.adaptRate);
+	lua_setfield(L, -2, "adaptRate");
+	return 1;
+}
+
+// tpt.osc.spectrum("density"), "pressure" or "off"; without arguments returns the current source
+static int spectrum(lua_State *L)
+{
+	auto *oscClient = getOscClient(L);
+	if (lua_gettop(L))
+	{
+		auto name = tpt_lua_checkByteString(L, 1);
+		for (int source = 0; source < NUM_SPECTRUM_SOURCES; ++source)
+		{
+			if (name == oscSpectrumSourceNames[source])
+			{
+				oscClient->SetSpectrumSource(OscSpectrumSource(source));
+				return 0;
+			}
+		}
+		return luaL_error(L, "invalid spectrum source: %s", name.c_str());
+	}
+	lua_pushstring(L, oscSpectrumSourceNames[oscClient->GetSpectrumSource()]);
+	return 1;
+}
+
+// tpt.osc.perf(true) sends /tpt/perf once a second; without arguments returns whether it does
+// The phase times do not overlap: time spent in Lua callbacks counts as luaMs only, not also
+// towards the phase that ran them, so their sum is the time the phases took.
+static int perf(lua_State *L)
+{
+	auto *oscClient = getOscClient(L);
+	if (lua_gettop(L))
+	{
+		oscClient->SetPerf(lua_toboolean(L, 1));
+		return 0;
+	}
+	lua_pushboolean(L, oscClient->GetPerf());
+	return 1;
+}
+
+static int stats(lua_State *L)
+{
+	auto *oscClient = getOscClient(L);
+	auto senderStats = oscClient->GetSenderStats();
+	lua_newtable(L);
+#define LSTAT(k) lua_pushnumber(L, double(senderStats.k)); lua_setfield(L, -2, #k)
+	LSTAT(published);
+	LSTAT(sent);
+	LSTAT(dropped);
+	LSTAT(late);
+#undef LSTAT
+	lua_newtable(L);
+	int i = 0;
+	for (auto &targetStats : oscClient->GetTargetStats())
+	{
+		lua_newtable(L);
+		tpt_lua_pushByteString(L, targetStats.uri);
+		lua_setfield(L, -2, "uri");
+#define LSTAT(k) lua_pushnumber(L, double(targetStats.k)); lua_setfield(L, -2, #k)
+		LSTAT(sent);
+		LSTAT(failed);
+		LSTAT(rateLimited);
+#undef LSTAT
+		lua_rawseti(L, -2, ++i);
+	}
+	lua_setfield(L, -2, "targets");
+	return 1;
+}
+
+static const std::array<const char *, NUM_OSC_EVENTS> eventNames = { "create", "kill", "changefrom", "changeto" };
+static const std::array<const char *, 3> axisNames = { "x", "y", "temp" };
+
+template<size_t N>
+static int checkName(lua_State *L, int index, const char *field, const std::array<const char *, N> &names, int def)
+{
+	lua_getfield(L, index, field);
+	if (lua_isnil(L, -1))
+	{
+		lua_pop(L, 1);
+		return def;
+	}
+	auto name = tpt_lua_checkByteString(L, -1);
+	lua_pop(L, 1);
+	for (size_t i = 0; i < N; ++i)
+	{
+		if (name == names[i])
+		{
+			return int(i);
+		}
+	}
+	return luaL_error(L, "invalid %s: %s", field, name.c_str());
+}
+
+// tpt.osc.addHistogram{ event = "create", elements = { elem.DEFAULT_PT_SAND, "WATR" }, axis = "y", bins = 16, address = "/sand" }
+static int addHistogram(lua_State *L)
+{
+	auto *oscClient = getOscClient(L);
+	luaL_checktype(L, 1, LUA_TTABLE);
+	EventHistogramConfig config;
+	config.kind = OscEventKind(checkName(L, 1, "event", eventNames, OscEventCreate));
+	config.axis = OscEventAxis(checkName(L, 1, "axis", axisNames, OscAxisY));
+	lua_getfield(L, 1, "bins");
+	config.bins = luaL_optinteger(L, -1, config.bins);
+	lua_pop(L, 1);
+	lua_getfield(L, 1, "address");
+	config.address = tpt_lua_checkByteString(L, -1);
+	lua_pop(L, 1);
+	lua_getfield(L, 1, "elements");
+	luaL_checktype(L, -1, LUA_TTABLE);
+	auto count = int(lua_objlen(L, -1));
+	auto &sd = SimulationData::CRef();
+	for (auto i = 1; i <= count; ++i)
+	{
+		lua_rawgeti(L, -1, i);
+		auto type = lua_type(L, -1) == LUA_TSTRING ? sd.GetParticleType(tpt_lua_toByteString(L, -1)) : int(luaL_checkinteger(L, -1));
+		lua_pop(L, 1);
+		config.types.push_back(type);
+	}
+	lua_pop(L, 1);
+	try
+	{
+		oscClient->AddEventHistogram(config);
+	}
+	catch (const std::runtime_error &e)
+	{
+		return luaL_error(L, "%s", e.what());
+	}
+	return 0;
+}
+
+static int clearHistograms(lua_State *L)
+{
+	getOscClient(L)->ClearEventHistograms();
+	return 0;
+}
+
+static int histograms(lua_State *L)
+{
+	auto *oscClient = getOscClient(L);
+	lua_newtable(L);
+	int i = 0;
+	for (auto &config : oscClient->GetEventHistograms())
+	{
+		lua_newtable(L);
+		lua_pushstring(L, eventNames[config.kind]);
+		lua_setfield(L, -2, "event");
+		lua_pushstring(L, axisNames[config.axis]);
+		lua_setfield(L, -2, "axis");
+		lua_pushinteger(L, config.bins);
+		lua_setfield(L, -2, "bins");
+		tpt_lua_pushByteString(L, config.address);
+		lua_setfield(L, -2, "address");
+		lua_newtable(L);
+		int j = 0;
+		for (auto type : config.types)
+		{
+			lua_pushinteger(L, type);
+			lua_rawseti(L, -2, ++j);
+		}
+		lua_setfield(L, -2, "elements");
+		lua_rawseti(L, -2, ++i);
+	}
+	return 1;
+}
+
+template<size_t N>
+static int checkOption(lua_State *L, int index, const char *what, const std::array<const char *, N> &names)
+{
+	auto name = tpt_lua_checkByteString(L, index);
+	for (size_t i = 0; i < N; ++i)
+	{
+		if (name == names[i])
+		{
+			return int(i);
+		}
+	}
+	return luaL_error(L, "invalid %s: %s", what, name.c_str());
+}
+
+// tpt.osc.addReducer{
+//     address = "/hotwater",
+//     elements = { "WATR", elem.DEFAULT_PT_DSTW }, -- optional, every element if left out
+//     region = { x0, y0, x1, y1 },                 -- optional, in pixels, x1 and y1 excluded
+//     where = { { "temp", ">", 373 } },            -- optional, all must hold
+//     fields = { "count", { "mean", "temp" }, { "max", "vy" } },
+// }
+// The filter and fields are compiled into native code paths; no Lua runs per particle. The
+// address names the reducer's results in onReducers, so it is an error if another reducer
+// already has it.
+static int addReducer(lua_State *L)
+{
+	auto *oscClient = getOscClient(L);
+	luaL_checktype(L, 1, LUA_TTABLE);
+	OscReducerConfig config;
+	lua_getfield(L, 1, "address");
+	config.address = tpt_lua_checkByteString(L, -1);
+	lua_pop(L, 1);
+	lua_getfield(L, 1, "elements");
+	if (!lua_isnil(L, -1))
+	{
+		luaL_checktype(L, -1, LUA_TTABLE);
+		auto count = int(lua_objlen(L, -1));
+		auto &sd = SimulationData::CRef();
+		for (auto i = 1; i <= count; ++i)
+		{
+			lua_rawgeti(L, -1, i);
+			auto type = lua_type(L, -1) == LUA_TSTRING ? sd.GetParticleType(tpt_lua_toByteString(L, -1)) : int(luaL_checkinteger(L, -1));
+			lua_pop(L, 1);
+			config.types.push_back(type);
+		}
+	}
+	lua_pop(L, 1);
+	lua_getfield(L, 1, "region");
+	if (!lua_isnil(L, -1))
+	{
+		luaL_checktype(L, -1, LUA_TTABLE);
+		std::array<int *, 4> bounds = { &config.x0, &config.y0, &config.x1, &config.y1 };
+		for (int i = 0; i < 4; ++i)
+		{
+			lua_rawgeti(L, -1, i + 1);
+			*bounds[i] = int(luaL_checkinteger(L, -1));
+			lua_pop(L, 1);
+		}
+	}
+	lua_pop(L, 1);
+	lua_getfield(L, 1, "where");
+	if (!lua_isnil(L, -1))
+	{
+		luaL_checktype(L, -1, LUA_TTABLE);
+		auto count = int(lua_objlen(L, -1));
+		for (auto i = 1; i <= count; ++i)
+		{
+			lua_rawgeti(L, -1, i);
+			luaL_checktype(L, -1, LUA_TTABLE);
+			OscReducerPredicate predicate;
+			lua_rawgeti(L, -1, 1);
+			predicate.property = tpt_lua_checkByteString(L, -1);
+			lua_rawgeti(L, -2, 2);
+			predicate.op = OscCompareOp(checkOption(L, -1, "comparison", oscCompareOpNames));
+			lua_rawgeti(L, -3, 3);
+			predicate.value = float(luaL_checknumber(L, -1));
+			lua_pop(L, 4);
+			config.predicates.push_back(predicate);
+		}
+	}
+	lua_pop(L, 1);
+	lua_getfield(L, 1, "fields");
+	luaL_checktype(L, -1, LUA_TTABLE);
+	{
+		auto count = int(lua_objlen(L, -1));
+		for (auto i = 1; i <= count; ++i)
+		{
+			lua_rawgeti(L, -1, i);
+			OscReducerField field;
+			if (lua_istable(L, -1))
+			{
+				lua_rawgeti(L, -1, 1);
+				field.op = OscReduceOp(checkOption(L, -1, "reduction", oscReduceOpNames));
+				lua_rawgeti(L, -2, 2);
+				if (field.op != OscReduceCount)
+				{
+					field.property = tpt_lua_checkByteString(L, -1);
+				}
+				lua_pop(L, 2);
+			}
+			else
+			{
+				field.op = OscReduceOp(checkOption(L, -1, "reduction", oscReduceOpNames));
+				if (field.op != OscReduceCount)
+				{
+					return luaL_error(L, "%s needs a property, e.g. { \"%s\", \"temp\" }", oscReduceOpNames[field.op], oscReduceOpNames[field.op]);
+				}
+			}
+			lua_pop(L, 1);
+			config.fields.push_back(field);
+		}
+	}
+	lua_pop(L, 1);
+	try
+	{
+		oscClient->AddReducer(config);
+	}
+	catch (const std::runtime_error &e)
+	{
+		return luaL_error(L, "%s", e.what());
+	}
+	return 0;
+}
+
+static int clearReducers(lua_State *L)
+{
+	getOscClient(L)->ClearReducers();
+	return 0;
+}
+
+// returns the reducers in the form addReducer takes them
+static int reducers(lua_State *L)
+{
+	auto *oscClient = getOscClient(L);
+	lua_newtable(L);
+	int i = 0;
+	for (auto &config : oscClient->GetReducers())
+	{
+		lua_newtable(L);
+		tpt_lua_pushByteString(L, config.address);
+		lua_setfield(L, -2, "address");
+		if (!config.types.empty())
+		{
+			lua_newtable(L);
+			int j = 0;
+			for (auto type : config.types)
+			{
+				lua_pushinteger(L, type);
+				lua_rawseti(L, -2, ++j);
+			}
+			lua_setfield(L, -2, "elements");
+		}
+		lua_newtable(L);
+		int j = 0;
+		for (auto bound : { config.x0, config.y0, config.x1, config.y1 })
+		{
+			lua_pushinteger(L, bound);
+			lua_rawseti(L, -2, ++j);
+		}
+		lua_setfield(L, -2, "region");
+		lua_newtable(L);
+		j = 0;
+		for (auto &predicate : config.predicates)
+		{
+			lua_newtable(L);
+			tpt_lua_pushByteString(L, predicate.property);
+			lua_rawseti(L, -2, 1);
+			lua_pushstring(L, oscCompareOpNames[predicate.op]);
+			lua_rawseti(L, -2, 2);
+			lua_pushnumber(L, predicate.value);
+			lua_rawseti(L, -2, 3);
+			lua_rawseti(L, -2, ++j);
+		}
+		lua_setfield(L, -2, "where");
+		lua_newtable(L);
+		j = 0;
+		for (auto &field : config.fields)
+		{
+			lua_newtable(L);
+			lua_pushstring(L, oscReduceOpNames[field.op]);
+			lua_rawseti(L, -2, 1);
+			if (field.op != OscReduceCount)
+			{
+				tpt_lua_pushByteString(L, field.property);
+				lua_rawseti(L, -2, 2);
+			}
+			lua_rawseti(L, -2, ++j);
+		}
+		lua_setfield(L, -2, "fields");
+		lua_rawseti(L, -2, ++i);
+	}
+	return 1;
+}
+
+// tpt.osc.onReducers(function(results) ... end), nil removes it. The only Lua that runs for
+// reducers: once per frame, with results[address] = { value, ... } in field order. Values
+// changed in that table are sent instead of the computed ones.
+static int onReducers(lua_State *L)
+{
+	auto *oscClient = getOscClient(L);
+	auto *lsi = GetLSI();
+	if (lua_isnoneornil(L, 1))
+	{
+		lsi->oscReducerCallback.Clear();
+		oscClient->SetReducerCallback(nullptr);
+		return 0;
+	}
+	luaL_checktype(L, 1, LUA_TFUNCTION);
+	lsi->oscReducerCallback.Assign(L, 1);
+	oscClient->SetReducerCallback([](OscReducerFrame *results, int count) {
+		auto *lsi = GetLSI();
+		auto *L = lsi->L;
+		lsi->oscReducerCallback.Push(L);
+		lua_newtable(L);
+		for (int i = 0; i < count; ++i)
+		{
+			lua_newtable(L);
+			for (int j = 0; j < results[i].fieldCount; ++j)
+			{
+				lua_pushnumber(L, results[i].values[j]);
+				lua_rawseti(L, -2, j + 1);
+			}
+			lua_setfield(L, -2, results[i].address);
+		}
+		lua_pushvalue(L, -1);
+		lua_insert(L, -3); // keep the results table below the function so it can be read back
+		if (tpt_lua_pcall(L, 1, 0, 0, eventTraitNone))
+		{
+			lsi->Log(CommandInterface::LogError, "In OSC reducer callback: " + LuaGetError());
+			lua_pop(L, 1); // LuaGetError took the message, this is the results table
+			return;
+		}
+		for (int i = 0; i < count; ++i)
+		{
+			lua_getfield(L, -1, results[i].address);
+			if (lua_istable(L, -1))
+			{
+				for (int j = 0; j < results[i].fieldCount; ++j)
+				{
+					lua_rawgeti(L, -1, j + 1);
+					if (lua_isnumber(L, -1))
+					{
+						results[i].values[j] = float(lua_tonumber(L, -1));
+					}
+					lua_pop(L, 1);
+				}
+			}
+			lua_pop(L, 1);
+		}
+		lua_pop(L, 1);
+	});
+	return 0;
+}
+
+void LuaOsc::Open(lua_State *L)
+{
+	static const luaL_Reg reg[] = {
+#define LFUNC(v) { #v, v }
+		LFUNC(targets),
+		LFUNC(latency),
+		LFUNC(record),
+		LFUNC(delta),
+		LFUNC(sampling),
+		LFUNC(spectrum),
+		LFUNC(onsets),
+		LFUNC(perf),
+		LFUNC(addReducer),
+		LFUNC(clearReducers),
+		LFUNC(reducers),
+		LFUNC(onReducers),
+		LFUNC(stats),
+		LFUNC(addHistogram),
+		LFUNC(clearHistograms),
+		LFUNC(histograms),
+#undef LFUNC
+		{ nullptr, nullptr }
+	};
+	lua_getglobal(L, "tpt");
+	lua_newtable(L);
+	luaL_register(L, nullptr, reg);
+	lua_setfield(L, -2, "osc");
+	lua_pop(L, 1);
+}
@@ -10,6 +10,7 @@
 #include "gui/interface/Window.h"
 #include "LuaBit.h"
 #include "LuaComponent.h"
+#include "osc/osc.h"
 #include "prefs/GlobalPrefs.h"
 #include "simulation/Simulation.h"
 #include "simulation/SimulationData.h"
@@ -151,6 +152,7 @@ LuaScriptInterface::LuaScriptInterface(GameController *newGameController, GameMo
 	LuaHttp::Open(L);
 	LuaInterface::Open(L);
 	LuaMisc::Open(L);
+	LuaOsc::Open(L);
 	LuaPlatform::Open(L);
 	LuaRenderer::Open(L);
 	LuaSimulation::Open(L);
@@ -185,6 +187,8 @@ LuaScriptInterface::LuaScriptInterface(GameController *newGameController, GameMo
 
 void LuaScriptInterface::InitCustomCanMove()
 {
+	// called whenever elements change, which may well wake what has settled
+	sim->WakeAllTiles();
 	auto &sd = SimulationData::Ref();
 	sd.init_can_move();
 	for (auto moving = 0; moving < PT_NUM; ++moving)
@@ -338,6 +342,9 @@ void LuaSetParticleProperty(lua_State *L, int particleID, StructProperty propert
 	}
 	else
 	{
+		int x = int(sim->parts[particleID].x + 0.5f);
+		int y = int(sim->parts[particleID].y + 0.5f);
+		sim->WakeTiles(x, y, x, y);
 		LuaSetProperty(L, property, propertyAddress, 3);
 	}
 }
@@ -404,6 +411,17 @@ static int pushGameControllerEvent(lua_State *L, const GameControllerEvent &even
 		lua_pushinteger(L, mouseWheelEvent->d);
 		return 3;
 	}
+	else if (auto *compactPartsEvent = std::get_if<CompactPartsEvent>(&event))
+	{
+		// old id -> new id
+		lua_newtable(L);
+		for (auto [ oldId, newId ] : compactPartsEvent->moved)
+		{
+			lua_pushinteger(L, newId);
+			lua_rawseti(L, -2, oldId);
+		}
+		return 1;
+	}
 	return 0;
 }
 
@@ -755,7 +773,14 @@ String CommandInterface::FormatCommand(String command)
 		return highlight(command);
 }
 
-LuaScriptInterface::~LuaScriptInterface() = default;
+LuaScriptInterface::~LuaScriptInterface()
+{
+	// the callback calls back into this interface
+	if (sim->oscClient)
+	{
+		sim->oscClient->SetReducerCallback(nullptr);
+	}
+}
 
 void tpt_lua_pushByteString(lua_State *L, const ByteString &str)
 {
@@ -846,6 +871,7 @@ int tpt_lua_pcall(lua_State *L, int numArgs, int numResults, int errorFunc, Even
 			lsi->eventTraits = oldEventTraits;
 		}
 	} atReturn(newEventTraits);
+	OscPerfScope perfScope(OscPerfLua);
 	return lua_pcall(L, numArgs, numResults, errorFunc);
 }
 
@@ -111,6 +111,7 @@ public:
 	int luaHookTimeout;
 
 	std::map<LuaComponent *, LuaSmartRef> grabbedComponents; // must come after luaState
+	LuaSmartRef oscReducerCallback; // must come after luaState
 
 	LuaScriptInterface(GameController *newGameController, GameModel *newGameModel);
 	~LuaScriptInterface();
@@ -193,6 +194,11 @@ namespace LuaMisc
 	void Tick(lua_State *L);
 }
 
+namespace LuaOsc
+{
+	void Open(lua_State *L);
+}
+
 namespace LuaPlatform
 {
 	void Open(lua_State *L);
@@ -1269,6 +1269,7 @@ static int canMove(lua_State *L)
 	lsi->customCanMove[movingElement][destinationElement] = setting | 0x80;
 	auto &sd = SimulationData::Ref();
 	sd.can_move[movingElement][destinationElement] = setting;
+	lsi->sim->WakeAllTiles();
 	return 0;
 }
 
@@ -1918,6 +1919,119 @@ static int ensureDeterminism(lua_State *L)
 	return 1;
 }
 
+static int updateThreads(lua_State *L)
+{
+	auto *lsi = GetLSI();
+	lsi->AssertInterfaceEvent();
+	if (lua_gettop(L))
+	{
+		auto threads = luaL_checkinteger(L, 1);
+		if (threads < 1)
+		{
+			return luaL_error(L, "Invalid number of threads");
+		}
+		lsi->sim->updateThreads = int(threads);
+		return 0;
+	}
+	lua_pushinteger(L, lsi->sim->updateThreads);
+	return 1;
+}
+
+static int deterministicUpdate(lua_State *L)
+{
+	auto *lsi = GetLSI();
+	lsi->AssertInterfaceEvent();
+	if (lua_gettop(L))
+	{
+		lsi->sim->deterministicUpdate = lua_toboolean(L, 1);
+		return 0;
+	}
+	lua_pushboolean(L, lsi->sim->deterministicUpdate);
+	return 1;
+}
+
+static int sleepingTiles(lua_State *L)
+{
+	auto *lsi = GetLSI();
+	lsi->AssertInterfaceEvent();
+	if (lua_gettop(L))
+	{
+		lsi->sim->sleepingTiles = lua_toboolean(L, 1);
+		return 0;
+	}
+	lua_pushboolean(L, lsi->sim->sleepingTiles);
+	lua_pushinteger(L, lsi->sim->CountSleepingTiles());
+	return 2;
+}
+
+static int sleepCheck(lua_State *L)
+{
+	auto *lsi = GetLSI();
+	lsi->AssertInterfaceEvent();
+	if (lua_gettop(L))
+	{
+		lsi->sim->sleepCheck = lua_toboolean(L, 1);
+		return 0;
+	}
+	lua_pushboolean(L, lsi->sim->sleepCheck);
+	lua_pushinteger(L, lua_Integer(lsi->sim->GetSleepCheckMisses()));
+	return 2;
+}
+
+static int incrementalMaps(lua_State *L)
+{
+	auto *lsi = GetLSI();
+	lsi->AssertInterfaceEvent();
+	if (lua_gettop(L))
+	{
+		lsi->sim->incrementalMaps = lua_toboolean(L, 1);
+		return 0;
+	}
+	lua_pushboolean(L, lsi->sim->incrementalMaps);
+	return 1;
+}
+
+static int validateMaps(lua_State *L)
+{
+	auto *lsi = GetLSI();
+	lsi->AssertInterfaceEvent();
+	if (lua_gettop(L))
+	{
+		lsi->sim->validateMaps = lua_toboolean(L, 1);
+		return 0;
+	}
+	lua_pushboolean(L, lsi->sim->validateMaps);
+	lua_pushinteger(L, lua_Integer(lsi->sim->GetMapDrifts()));
+	return 2;
+}
+
+static int compactParticles(lua_State *L)
+{
+	auto *lsi = GetLSI();
+	lsi->AssertInterfaceEvent();
+	if (lua_gettop(L))
+	{
+		lsi->sim->compactParticles = lua_toboolean(L, 1);
+		return 0;
+	}
+	lua_pushboolean(L, lsi->sim->compactParticles);
+	return 1;
+}
+
+static int checkAir(lua_State *L)
+{
+	auto *lsi = GetLSI();
+	lsi->AssertInterfaceEvent();
+	if (lua_gettop(L))
+	{
+		lsi->sim->air->checkReference = lua_toboolean(L, 1);
+		return 0;
+	}
+	lua_pushboolean(L, lsi->sim->air->checkReference);
+	lua_pushinteger(L, lua_Integer(lsi->sim->air->referenceMismatches));
+	return 2;
+}
+
 void LuaSimulation::Open(lua_State *L)
 {
 	auto *lsi = GetLSI();
@@ -1997,6 +2111,14 @@ void LuaSimulation::Open(lua_State *L)
 		LFUNC(randomSeed),
 		LFUNC(hash),
 		LFUNC(ensureDeterminism),
+		LFUNC(updateThreads),
+		LFUNC(deterministicUpdate),
+		LFUNC(sleepingTiles),
+		LFUNC(sleepCheck),
+		LFUNC(incrementalMaps),
+		LFUNC(validateMaps),
+		LFUNC(compactParticles),
+		LFUNC(checkAir),
 		LFUNC(paused),
 		LFUNC(gravityMass),
 		LFUNC(gravityMask),
@@ -0,0 +1,17 @@
+#pragma once
+#include "handler.h"
+#include "reducer.h"
+#include <array>
+
+// What TPTOscClient::AccumulateParticle collects for one tile of a tiled particle update. The
+// tiles of a phase are updated on different threads, so each fills its own, and
+// TPTOscClient::MergeTile adds it to the frame's in tile order once the phase is over, so the
+// result does not depend on which thread got to a tile first. The spatial grid and the
+// density spectrum are written directly, as tiles cover disjoint cells.
+struct OscTileAccumulator
+{
+	ElementRanking ranking;
+	std::array<MasterHandler, HANDLERS> handlers;
+	std::array<int, HANDLERS> sampled = {}; // particles each handler's type had, for HandlerSampler
+	OscReducerTotals reducers;
+};
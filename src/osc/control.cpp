@@ -0,0 +1,195 @@
+#include "control.h"
+#include <oscpp/server.hpp>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef WINDOWS
+    #include <winsock2.h>
+    #include "Ws2tcpip.h"
+#else
+    #include <sys/socket.h>
+    #include <sys/select.h>
+    #include <sys/types.h>
+    #include <netinet/in.h>
+    #include <netdb.h>
+    #include <unistd.h>
+#endif
+
+constexpr int maxBundleDepth = 8;
+constexpr int pollTimeoutUs = 100000; // how quickly the listener notices it should stop
+constexpr int defaultBrushRadius = 5;
+
+static void closeSocket(int sock) {
+    #ifdef WINDOWS
+    ::closesocket(sock);
+    #else
+    close(sock);
+    #endif
+}
+
+static void copyName(char (&dest)[CONTROL_NAME_SIZE], const char* src) {
+    std::strncpy(dest, src, CONTROL_NAME_SIZE - 1);
+    dest[CONTROL_NAME_SIZE - 1] = 0;
+}
+
+// the element type of create and brush may be sent as an id or a name
+static void readElement(OSCPP::Server::ArgStream& args, OscCommand& command) {
+    if (args.tag() == 's') {
+        command.valueKind = OscCommand::NameValue;
+        copyName(command.name, args.string());
+    } else {
+        command.valueKind = OscCommand::IntValue;
+        command.intValue = args.int32();
+    }
+}
+
+// throws OSCPP::ParseError or OSCPP::UnderrunError on missing or mistyped arguments,
+// returns false for addresses that are not control messages
+static bool decodeMessage(const OSCPP::Server::Message& message, OscCommand& command) {
+    auto args = message.args();
+    if (message == "/tpt/create" || message == "/tpt/brush") {
+        command.kind = message == "/tpt/create" ? OscCommand::Create : OscCommand::Brush;
+        command.x = args.int32();
+        command.y = args.int32();
+        readElement(args, command);
+        if (command.kind == OscCommand::Brush) {
+            command.rx = args.atEnd() ? defaultBrushRadius : args.int32();
+            command.ry = args.atEnd() ? command.rx : args.int32();
+        }
+    } else if (message == "/tpt/pause") {
+        command.kind = OscCommand::Pause;
+        if (!args.atEnd()) {
+            command.valueKind = OscCommand::IntValue;
+            command.intValue = args.int32();
+        }
+    } else if (message == "/tpt/airmode") {
+        command.kind = OscCommand::AirMode;
+        command.valueKind = OscCommand::IntValue;
+        command.intValue = args.int32();
+    } else if (message == "/tpt/setprop") {
+        command.kind = OscCommand::SetProp;
+        command.id = args.int32();
+        copyName(command.property, args.string());
+        switch (args.tag()) {
+        case 'f':
+            command.valueKind = OscCommand::FloatValue;
+            command.floatValue = args.float32();
+            break;
+        case 's':
+            command.valueKind = OscCommand::NameValue;
+            copyName(command.name, args.string());
+            break;
+        default:
+            command.valueKind = OscCommand::IntValue;
+            command.intValue = args.int32();
+            break;
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+OscControlServer::OscControlServer(const std::string& uri) : uri(uri) {
+    // same syntax as udp:// targets, the host selects the interface to listen on
+    auto prefix = std::string("udp://");
+    auto colon = uri.rfind(':');
+    if (uri.compare(0, prefix.size(), prefix) != 0 || colon == std::string::npos || colon < prefix.size()) {
+        throw std::runtime_error("invalid OSC control address, expected udp://host:port: " + uri);
+    }
+    auto host = uri.substr(prefix.size(), colon - prefix.size());
+    auto port = uri.substr(colon + 1);
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result) != 0 || !result) {
+        throw std::runtime_error("cannot resolve " + host + ":" + port);
+    }
+    sock = int(::socket(result->ai_family, SOCK_DGRAM, 0));
+    if (sock < 0) {
+        freeaddrinfo(result);
+        throw std::runtime_error("cannot create UDP socket");
+    }
+    if (::bind(sock, result->ai_addr, socklen_t(result->ai_addrlen)) != 0) {
+        freeaddrinfo(result);
+        closeSocket(sock);
+        throw std::runtime_error("cannot listen on " + uri);
+    }
+    freeaddrinfo(result);
+
+    thr = std::thread([this]() {
+        Run();
+    });
+}
+
+OscControlServer::~OscControlServer() {
+    shouldStop.store(true, std::memory_order_release);
+    thr.join();
+    closeSocket(sock);
+}
+
+uint64_t OscControlServer::Received() const {
+    return received.load(std::memory_order_relaxed);
+}
+
+uint64_t OscControlServer::Rejected() const {
+    return rejected.load(std::memory_order_relaxed);
+}
+
+uint64_t OscControlServer::Dropped() const {
+    return queue.Dropped();
+}
+
+void OscControlServer::Run() {
+    std::array<char, 8192> buffer;
+    while (!shouldStop.load(std::memory_order_acquire)) {
+        // wait with a timeout rather than block in recv so the destructor can stop us
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(sock, &readable);
+        timeval timeout{ 0, pollTimeoutUs };
+        if (::select(sock + 1, &readable, nullptr, nullptr, &timeout) <= 0) {
+            continue;
+        }
+        auto size = ::recv(sock, buffer.data(), buffer.size(), 0);
+        if (size <= 0) {
+            continue;
+        }
+        Decode(buffer.data(), size_t(size), 0);
+    }
+}
+
+void OscControlServer::Decode(const char* data, size_t size, int depth) {
+    try {
+        OSCPP::Server::Packet packet(data, size);
+        if (packet.isBundle()) {
+            if (depth >= maxBundleDepth) {
+                rejected.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            // timetags are ignored, everything in a bundle is applied on the next frame
+            auto packets = OSCPP::Server::Bundle(packet).packets();
+            while (!packets.atEnd()) {
+                auto inner = packets.next();
+                Decode(static_cast<const char*>(inner.data()), inner.size(), depth + 1);
+            }
+            return;
+        }
+        OscCommand command;
+        if (!decodeMessage(OSCPP::Server::Message(packet), command)) {
+            rejected.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        received.fetch_add(1, std::memory_order_relaxed);
+        queue.TryPush(command);
+    } catch (const OSCPP::Error&) {
+        rejected.fetch_add(1, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "ring.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#define CONTROL_QUEUE_SIZE 1024
+#define CONTROL_NAME_SIZE 32
+
+// One decoded control message. Element and property names are resolved on the simulation
+// thread, since element definitions belong to it.
+//   /tpt/create  x y type                 one particle, type is an element id or name
+//   /tpt/brush   x y type [rx [ry]]       ellipse of particles, radius 5 by default, 200 at most
+//   /tpt/pause   [paused]                 toggles without an argument
+//   /tpt/airmode mode
+//   /tpt/setprop id property value        value is an int, float or element name
+struct OscCommand
+{
+	enum Kind
+	{
+		Create,
+		Brush,
+		Pause,
+		AirMode,
+		SetProp,
+	};
+	enum ValueKind
+	{
+		NoValue,
+		IntValue,
+		FloatValue,
+		NameValue,
+	};
+	Kind kind;
+	int x = 0, y = 0;
+	int rx = 0, ry = 0;
+	int id = 0;
+	ValueKind valueKind = NoValue;
+	int intValue = 0;
+	float floatValue = 0;
+	char name[CONTROL_NAME_SIZE] = {}; // element name if valueKind is NameValue
+	char property[CONTROL_NAME_SIZE] = {};
+};
+
+// Listens for control messages on a UDP socket from its own thread and queues them for the
+// simulation thread, which drains the queue at the start of each frame. Malformed packets,
+// unknown addresses and commands that do not fit in the queue are counted and dropped.
+class OscControlServer
+{
+public:
+	// uri is udp://host:port, as for targets; throws std::runtime_error if it cannot be bound
+	OscControlServer(const std::string &uri);
+	~OscControlServer();
+
+	// simulation thread only
+	bool Pop(OscCommand &command)
+	{
+		return queue.Pop(command);
+	}
+
+	const std::string &GetUri() const
+	{
+		return uri;
+	}
+	uint64_t Received() const;
+	uint64_t Rejected() const;
+	uint64_t Dropped() const;
+
+private:
+	void Run();
+	void Decode(const char *data, size_t size, int depth);
+
+	std::string uri;
+	int sock = -1;
+	std::thread thr;
+	std::atomic<bool> shouldStop = false;
+	std::atomic<uint64_t> received = 0;
+	std::atomic<uint64_t> rejected = 0;
+	CommandQueue<OscCommand, CONTROL_QUEUE_SIZE> queue;
+};
@@ -0,0 +1,131 @@
+#include "delta.h"
+#include "osc.h"
+#include <oscpp/client.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+const std::array<const char*, NUM_HANDLER_FIELDS> oscHandlerFieldNames = {
+    "count", "temp", "vel", "liquid", "solid", "gas", "energy", "y", "ysigma", "xmin", "xmax",
+};
+
+static std::array<float, NUM_HANDLER_FIELDS> handlerFields(const MasterReturnParams& params) {
+    return {
+        float(params.count),
+        float(params.temp.first),
+        float(params.vel.first),
+        float(params.p_liquid),
+        float(params.p_solid),
+        float(params.p_gas),
+        float(params.p_energy),
+        float(params.y.first),
+        float(params.y.second),
+        float(params.x.first),
+        float(params.x.second),
+    };
+}
+
+static bool sameGrid(const OscGrid& a, const OscGrid& b) {
+    auto cells = size_t(a.width * a.height);
+    return a.width == b.width && a.height == b.height &&
+        std::equal(a.density.begin(), a.density.begin() + cells, b.density.begin()) &&
+        std::equal(a.temperature.begin(), a.temperature.begin() + cells, b.temperature.begin()) &&
+        std::equal(a.pressure.begin(), a.pressure.begin() + cells, b.pressure.begin());
+}
+
+void OscDeltaEncoder::SetConfig(const OscDeltaConfig& newConfig) {
+    config = newConfig;
+    config.keyframeInterval = std::max(config.keyframeInterval, 1);
+    framesSinceKeyframe = -1;
+}
+
+size_t OscDeltaEncoder::Encode(void* buffer, size_t size, const OscFrame& frame) {
+    if (framesSinceKeyframe < 0 || framesSinceKeyframe + 1 >= config.keyframeInterval) {
+        framesSinceKeyframe = 0;
+        for (int i = 0; i < HANDLERS; i++) {
+            lastSent[i] = handlerFields(frame.handlers[i]);
+        }
+        lastGrid = frame.grid;
+        lastSpectrumFrame = frame.spectrum.frameNumber;
+        lastReducers = frame.reducers;
+        return makeFramePacket(buffer, size, frame);
+    }
+    framesSinceKeyframe++;
+
+    OSCPP::Client::Packet packet(buffer, size);
+    int messages = 0;
+    packet.openBundle(frame.timetag);
+    for (int i = 0; i < HANDLERS; i++) {
+        if (frame.voiceEvents.off[i] >= 0) {
+            writeVoiceEvent(packet, i, "off", frame.voiceEvents.off[i]);
+            messages++;
+        }
+    }
+    for (int i = 0; i < HANDLERS; i++) {
+        if (frame.voiceEvents.on[i] >= 0) {
+            writeVoiceEvent(packet, i, "on", frame.voiceEvents.on[i]);
+            // a new voice starts with everything it has
+            writePowderAnalytics(packet, &frame.handlers[i], i);
+            lastSent[i] = handlerFields(frame.handlers[i]);
+            messages += 2;
+            continue;
+        }
+        auto fields = handlerFields(frame.handlers[i]);
+        for (int field = 0; field < NUM_HANDLER_FIELDS; field++) {
+            if (!(std::abs(fields[field] - lastSent[i][field]) > config.deadbands[field])) {
+                continue;
+            }
+            std::stringstream addr;
+            addr << "/tpt/" << i + 1 << "/" << oscHandlerFieldNames[field];
+            packet.openMessage(addr.str().c_str(), 1);
+            if (field == FieldCount || (field >= FieldLiquid && field <= FieldEnergy)) {
+                packet.int32(int32_t(fields[field]));
+            } else {
+                packet.float32(fields[field]);
+            }
+            packet.closeMessage();
+            lastSent[i][field] = fields[field];
+            messages++;
+        }
+    }
+    for (int i = 0; i < frame.eventCount; i++) {
+        auto& histogram = frame.events[i];
+        if (std::any_of(histogram.counts.begin(), histogram.counts.begin() + histogram.bins, [](int count) { return count != 0; })) {
+            writeEventMessage(packet, histogram);
+            messages++;
+        }
+    }
+    for (int i = 0; i < frame.reducerCount; i++) {
+        auto& reducer = frame.reducers[i];
+        auto& last = lastReducers[i];
+        auto changed = std::strcmp(reducer.address, last.address) || reducer.fieldCount != last.fieldCount ||
+            !std::equal(reducer.values.begin(), reducer.values.begin() + reducer.fieldCount, last.values.begin());
+        if (changed) {
+            writeReducerMessage(packet, reducer);
+            last = reducer;
+            messages++;
+        }
+    }
+    for (int i = 0; i < frame.onsetCount; i++) {
+        writeOnsetMessage(packet, frame.onsets[i]);
+        messages++;
+    }
+    if (frame.grid.width > 0 && !sameGrid(frame.grid, lastGrid)) {
+        writeGridMessage(packet, frame.grid);
+        lastGrid = frame.grid;
+        messages++;
+    }
+    // only new once the worker finishes an analysis
+    if (frame.spectrum.valid && frame.spectrum.frameNumber != lastSpectrumFrame) {
+        writeSpectrumMessage(packet, frame.spectrum);
+        lastSpectrumFrame = frame.spectrum.frameNumber;
+        messages++;
+    }
+    if (frame.perf.valid) {
+        writePerfMessage(packet, frame.perf);
+        messages++;
+    }
+    packet.closeBundle();
+    return messages ? packet.size() : 0;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "grid.h"
+#include "handler.h"
+#include "reducer.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+struct OscFrame;
+
+// The fields of a /tpt/N message, in message order
+enum OscHandlerField
+{
+	FieldCount,
+	FieldTemp,
+	FieldVel,
+	FieldLiquid,
+	FieldSolid,
+	FieldGas,
+	FieldEnergy,
+	FieldY,
+	FieldYSigma,
+	FieldXMin,
+	FieldXMax,
+	NUM_HANDLER_FIELDS
+};
+extern const std::array<const char *, NUM_HANDLER_FIELDS> oscHandlerFieldNames;
+
+struct OscDeltaConfig
+{
+	bool enabled = false;
+	int keyframeInterval = 60; // frames between full frames, for receivers that join late
+	// a field is sent when it moved by more than this since it was last sent, so 0 means any change
+	std::array<float, NUM_HANDLER_FIELDS> deadbands = {
+		0,     // count
+		0.005f, // temp, already scaled to 0-1
+		0.05f, // vel
+		0, 0, 0, 0,
+		1, 1,  // y, ysigma, in pixels
+		1, 1,  // xmin, xmax
+	};
+};
+
+// Encodes frames for delta mode. Keyframes are the usual full bundle; other frames carry only
+// the fields that moved past their deadband as /tpt/N/<field> messages, histograms with any
+// counts, reducers whose results changed, onsets, the spatial map if it changed, spectrum
+// features when there are new ones and perf reports, all in one bundle. It compares against
+// what was last sent rather than the previous frame, so slow drifts and frames dropped before
+// encoding are still caught. Only used from the network thread.
+class OscDeltaEncoder
+{
+public:
+	void SetConfig(const OscDeltaConfig &newConfig);
+	const OscDeltaConfig &GetConfig() const
+	{
+		return config;
+	}
+
+	// returns 0 if there is nothing worth sending
+	size_t Encode(void *buffer, size_t size, const OscFrame &frame);
+
+private:
+	OscDeltaConfig config;
+	int framesSinceKeyframe = -1; // -1 forces a keyframe
+	std::array<std::array<float, NUM_HANDLER_FIELDS>, HANDLERS> lastSent;
+	OscGrid lastGrid;
+	uint64_t lastSpectrumFrame = 0;
+	std::array<OscReducerFrame, MAX_REDUCERS> lastReducers = {};
+};
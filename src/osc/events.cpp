@@ -0,0 +1,83 @@
+#include "events.h"
+#include "SimulationConfig.h"
+#include <algorithm>
+#include <stdexcept>
+
+EventHistograms::EventHistograms() {
+    wanted.fill(0);
+}
+
+void EventHistograms::Add(const EventHistogramConfig& config) {
+    if (histograms.size() >= MAX_EVENT_HISTOGRAMS) {
+        throw std::runtime_error("too many event histograms, at most " + std::to_string(MAX_EVENT_HISTOGRAMS) + " are supported");
+    }
+    if (config.kind < 0 || config.kind >= NUM_OSC_EVENTS) {
+        throw std::runtime_error("invalid event kind");
+    }
+    if (config.axis < OscAxisX || config.axis > OscAxisTemperature) {
+        throw std::runtime_error("invalid histogram axis");
+    }
+    if (config.bins < 1 || config.bins > MAX_EVENT_BINS) {
+        throw std::runtime_error("histograms need between 1 and " + std::to_string(MAX_EVENT_BINS) + " bins");
+    }
+    if (config.address.empty() || config.address[0] != '/' || config.address.size() >= EVENT_ADDRESS_SIZE) {
+        throw std::runtime_error("invalid OSC address " + config.address);
+    }
+    Histogram histogram;
+    histogram.kind = config.kind;
+    histogram.axis = config.axis;
+    histogram.bins = config.bins;
+    histogram.types.fill(false);
+    histogram.counts.fill(0);
+    for (auto type : config.types) {
+        if (type <= 0 || type >= PT_NUM) {
+            throw std::runtime_error("invalid element type " + std::to_string(type));
+        }
+        histogram.types[type] = true;
+    }
+    for (auto type : config.types) {
+        wanted[type] |= 1 << config.kind;
+    }
+    histograms.push_back(histogram);
+    configs.push_back(config);
+}
+
+void EventHistograms::Clear() {
+    histograms.clear();
+    configs.clear();
+    wanted.fill(0);
+}
+
+void EventHistograms::Record(OscEventKind kind, int type, int x, int y, float temp) {
+    for (auto& histogram : histograms) {
+        if (histogram.kind != kind || !histogram.types[type]) {
+            continue;
+        }
+        int bin;
+        switch (histogram.axis) {
+        case OscAxisX:
+            bin = x * histogram.bins / XRES;
+            break;
+        case OscAxisY:
+            bin = (YRES - 1 - y) * histogram.bins / YRES;
+            break;
+        default:
+            bin = int(temp / MAX_TEMP * histogram.bins);
+            break;
+        }
+        histogram.counts[std::clamp(bin, 0, histogram.bins - 1)]++;
+    }
+}
+
+int EventHistograms::Collect(std::array<EventHistogramFrame, MAX_EVENT_HISTOGRAMS>& frames) {
+    for (size_t i = 0; i < histograms.size(); i++) {
+        auto& histogram = histograms[i];
+        auto& frame = frames[i];
+        std::fill(std::begin(frame.address), std::end(frame.address), 0);
+        configs[i].address.copy(frame.address, EVENT_ADDRESS_SIZE - 1);
+        frame.bins = histogram.bins;
+        std::copy_n(histogram.counts.begin(), histogram.bins, frame.counts.begin());
+        std::fill_n(histogram.counts.begin(), histogram.bins, 0);
+    }
+    return int(histograms.size());
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "simulation/ElementDefs.h"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define MAX_EVENT_HISTOGRAMS 8
+#define MAX_EVENT_BINS 64
+#define EVENT_ADDRESS_SIZE 32
+
+enum OscEventKind
+{
+	OscEventCreate,     // create_part
+	OscEventKill,       // kill_part
+	OscEventChangeFrom, // part_change_type, counted for the old type
+	OscEventChangeTo,   // part_change_type, counted for the new type
+	NUM_OSC_EVENTS
+};
+
+enum OscEventAxis
+{
+	OscAxisX,           // 0 is the left edge
+	OscAxisY,           // 0 is the bottom edge
+	OscAxisTemperature, // 0 to MAX_TEMP
+};
+
+struct EventHistogramConfig
+{
+	OscEventKind kind = OscEventCreate;
+	std::vector<int> types;
+	OscEventAxis axis = OscAxisY;
+	int bins = 16;
+	std::string address;
+};
+
+// One histogram's counts for one frame, sent as an OSC message with one int per bin
+struct EventHistogramFrame
+{
+	char address[EVENT_ADDRESS_SIZE];
+	int bins;
+	std::array<int, MAX_EVENT_BINS> counts;
+};
+
+// Per-frame histograms of particle events, configured per event kind and element type. The
+// simulation asks Wants before gathering anything for Record, which is a single table lookup,
+// so events nobody registered a histogram for cost next to nothing.
+class EventHistograms
+{
+public:
+	EventHistograms();
+
+	// throws std::runtime_error if the config is invalid or there are too many histograms
+	void Add(const EventHistogramConfig &config);
+	void Clear();
+	const std::vector<EventHistogramConfig> &GetConfigs() const
+	{
+		return configs;
+	}
+
+	bool Wants(OscEventKind kind, int type) const
+	{
+		return wanted[type] & (1 << kind);
+	}
+	void Record(OscEventKind kind, int type, int x, int y, float temp);
+
+	// copies this frame's counts into frames, returns how many there are, and starts a new frame
+	int Collect(std::array<EventHistogramFrame, MAX_EVENT_HISTOGRAMS> &frames);
+
+private:
+	struct Histogram
+	{
+		OscEventKind kind;
+		OscEventAxis axis;
+		int bins;
+		std::array<bool, PT_NUM> types;
+		std::array<int, MAX_EVENT_BINS> counts;
+	};
+	std::vector<EventHistogramConfig> configs;
+	std::vector<Histogram> histograms;
+	std::array<uint8_t, PT_NUM> wanted; // bit per OscEventKind
+};
@@ -0,0 +1,65 @@
+#include "grid.h"
+#include "simulation/ElementDefs.h"
+#include <algorithm>
+
+SpatialGrid::SpatialGrid() {
+    counts.fill(0);
+    temperatures.fill(0);
+}
+
+void SpatialGrid::SetSize(int newWidth, int newHeight) {
+    if (newWidth <= 0 || newHeight <= 0) {
+        width = height = 0;
+        return;
+    }
+    width = std::min(newWidth, XCELLS);
+    height = std::min({ newHeight, YCELLS, GRID_MAX_CELLS / width });
+}
+
+template<class T>
+static T quantise(float value, float min, float max, float top) {
+    return T(std::clamp((value - min) / (max - min), 0.0f, 1.0f) * top + 0.5f);
+}
+
+void SpatialGrid::Reduce(const float (&pv)[YCELLS][XCELLS], OscGrid& grid) {
+    grid.width = width;
+    grid.height = height;
+    if (!Enabled()) {
+        return;
+    }
+    for (int gy = 0; gy < height; gy++) {
+        int y0 = gy * YCELLS / height;
+        int y1 = (gy + 1) * YCELLS / height;
+        rowCounts.fill(0);
+        rowTemperatures.fill(0);
+        rowPressures.fill(0);
+        for (int y = y0; y < y1; y++) {
+            auto* countRow = &counts[y * XCELLS];
+            auto* temperatureRow = &temperatures[y * XCELLS];
+            auto* pressureRow = pv[y];
+            for (int x = 0; x < XCELLS; x++) {
+                rowCounts[x] += countRow[x];
+                rowTemperatures[x] += temperatureRow[x];
+                rowPressures[x] += pressureRow[x];
+            }
+        }
+        for (int gx = 0; gx < width; gx++) {
+            int x0 = gx * XCELLS / width;
+            int x1 = (gx + 1) * XCELLS / width;
+            int32_t count = 0;
+            float temperature = 0, pressure = 0;
+            for (int x = x0; x < x1; x++) {
+                count += rowCounts[x];
+                temperature += rowTemperatures[x];
+                pressure += rowPressures[x];
+            }
+            auto cells = (x1 - x0) * (y1 - y0);
+            auto index = gy * width + gx;
+            grid.density[index] = quantise<uint8_t>(float(count) / (cells * CELL * CELL), 0.0f, 1.0f, 255.0f);
+            grid.temperature[index] = count ? quantise<uint16_t>(temperature / count, 0.0f, MAX_TEMP, 65535.0f) : 0;
+            grid.pressure[index] = quantise<uint16_t>(pressure / cells, MIN_PRESSURE, MAX_PRESSURE, 65535.0f);
+        }
+    }
+    counts.fill(0);
+    temperatures.fill(0);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "SimulationConfig.h"
+#include "simulation/Particle.h"
+#include <array>
+#include <cstdint>
+
+#define GRID_MAX_CELLS 1024
+
+// One frame of the coarse spatial map, row-major, width * height entries per field
+struct OscGrid
+{
+	int width = 0;
+	int height = 0;
+	std::array<uint8_t, GRID_MAX_CELLS> density;      // particles per pixel, 0-1 mapped to 0-255
+	std::array<uint16_t, GRID_MAX_CELLS> temperature; // mean particle temperature, 0-MAX_TEMP mapped to 0-65535
+	std::array<uint16_t, GRID_MAX_CELLS> pressure;    // mean pv, MIN_PRESSURE-MAX_PRESSURE mapped to 0-65535
+};
+
+// Accumulates particle count and temperature per CELL during the particle loop and reduces
+// them, together with pv, onto a coarse grid once per frame. The reduction adds whole cell
+// rows into a row buffer so the inner loops are contiguous and vectorise, then collapses the
+// row buffer horizontally, which only touches XCELLS entries per grid row.
+class SpatialGrid
+{
+public:
+	SpatialGrid();
+
+	// 0 disables the map; the size is clamped to XCELLS x YCELLS and GRID_MAX_CELLS
+	void SetSize(int width, int height);
+	int GetWidth() const
+	{
+		return width;
+	}
+	int GetHeight() const
+	{
+		return height;
+	}
+	bool Enabled() const
+	{
+		return width > 0;
+	}
+
+	void Accumulate(const Particle &p)
+	{
+		auto cx = unsigned(int(p.x + 0.5f)) / CELL;
+		auto cy = unsigned(int(p.y + 0.5f)) / CELL;
+		if (cx < unsigned(XCELLS) && cy < unsigned(YCELLS))
+		{
+			auto index = cy * XCELLS + cx;
+			counts[index] += 1;
+			temperatures[index] += p.temp;
+		}
+	}
+
+	// fills grid from this frame's accumulators and clears them for the next frame
+	void Reduce(const float (&pv)[YCELLS][XCELLS], OscGrid &grid);
+
+private:
+	int width = 0;
+	int height = 0;
+	std::array<int32_t, NCELL> counts;
+	std::array<float, NCELL> temperatures;
+	std::array<int32_t, XCELLS> rowCounts;
+	std::array<float, XCELLS> rowTemperatures;
+	std::array<float, XCELLS> rowPressures;
+};
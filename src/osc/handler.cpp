@@ -8,60 +8,7 @@
 #include <cmath>
 #include <tuple>
 #include <utility>
-
-// Constructor for BinHandler
-BinHandler::BinHandler(int count) : binCount(count) {
-    bins.resize(binCount, 0);
-}
-
-// Reset all bins to zero
-void BinHandler::reset() {
-    for (int i = 0; i < binCount; ++i) {
-        bins[i] = 0;
-    }
-}
-
-// Update a specific bin by incrementing its count
-void BinHandler::update(int index) {
-    if (index >= 1 && index <= binCount) {
-        bins[index - 1]++;
-    }
-}
-
-// Get the current bin counts
-std::vector<int> BinHandler::get() {
-    return bins;
-}
-
-// Constructor for PlantHandler
-PlantHandler::PlantHandler() 
-    : newBins(16), deletedBins(16) {}
-
-// Reset all plant states
-void PlantHandler::reset() {
-    newBins.reset();
-    deletedBins.reset();
-}
-
-// Update plant state at the given index
-void PlantHandler::update(int y) {
-    int bin = static_cast<int>(std::floor(16 * (383 - y) / 383.0)) + 1;
-    newBins.update(bin);
-}
-
-void PlantHandler::kill(int y){
-    int bin = static_cast<int>(std::floor(16 * (383 - y) / 383.0)) + 1;
-    deletedBins.update(bin);
-}
-
-
-// Get the bin data for new, old, and deleted plants
-std::tuple<std::vector<int>, std::vector<int>> PlantHandler::get() {
-
-    return {newBins.get(), deletedBins.get()};
-}
-
-
+#include <limits>
 
 DistributionHandler::DistributionHandler() : min(MIN), max(MAX) {}
 
@@ -75,59 +22,130 @@ void DistributionHandler::update(int v) {
     min = std::min(min, v);
 }
 
+void DistributionHandler::merge(const DistributionHandler& other) {
+    max = std::max(max, other.max);
+    min = std::min(min, other.min);
+}
+
 std::pair<int, int> DistributionHandler::get() const {
     return {min, max};
 }
 
+GaussDistributionHandler::GaussDistributionHandler(bool higherMoments) : higherMoments(higherMoments) {
+    reset();
+}
+
 void GaussDistributionHandler::update(float v) {
-    samples.push_back(v);
+    auto n1 = double(n);
+    n++;
+    double delta = v - mean;
+    double deltaN = delta / n;
+    double term1 = delta * deltaN * n1;
+    mean += deltaN;
+    if (higherMoments) {
+        double deltaN2 = deltaN * deltaN;
+        m4 += term1 * deltaN2 * (double(n) * n - 3.0 * n + 3.0) + 6.0 * deltaN2 * m2 - 4.0 * deltaN * m3;
+        m3 += term1 * deltaN * (n - 2.0) - 3.0 * deltaN * m2;
+    }
+    m2 += term1;
+    minValue = std::min(minValue, v);
+    maxValue = std::max(maxValue, v);
+}
+
+void GaussDistributionHandler::merge(const GaussDistributionHandler& other) {
+    if (other.n == 0) {
+        return;
+    }
+    if (n == 0) {
+        auto keepHigherMoments = higherMoments;
+        *this = other;
+        higherMoments = keepHigherMoments;
+        return;
+    }
+    double na = double(n);
+    double nb = double(other.n);
+    double nt = na + nb;
+    double delta = other.mean - mean;
+    double delta2 = delta * delta;
+    if (higherMoments && other.higherMoments) {
+        double delta3 = delta2 * delta;
+        double delta4 = delta2 * delta2;
+        m4 += other.m4 + delta4 * na * nb * (na * na - na * nb + nb * nb) / (nt * nt * nt)
+            + 6.0 * delta2 * (na * na * other.m2 + nb * nb * m2) / (nt * nt)
+            + 4.0 * delta * (na * other.m3 - nb * m3) / nt;
+        m3 += other.m3 + delta3 * na * nb * (na - nb) / (nt * nt)
+            + 3.0 * delta * (na * other.m2 - nb * m2) / nt;
+    }
+    m2 += other.m2 + delta2 * na * nb / nt;
+    mean += delta * nb / nt;
+    n += other.n;
+    minValue = std::min(minValue, other.minValue);
+    maxValue = std::max(maxValue, other.maxValue);
 }
 
 void GaussDistributionHandler::reset() {
-    samples.clear();
+    n = 0;
+    mean = 0.0;
+    m2 = 0.0;
+    m3 = 0.0;
+    m4 = 0.0;
+    minValue = std::numeric_limits<float>::max();
+    maxValue = std::numeric_limits<float>::lowest();
 }
 
 std::pair<double, double> GaussDistributionHandler::get() const {
-    if (samples.empty()) {
+    if (n == 0) {
         return {0.0, 0.0};
     }
-
-    double mu = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
-
-    double sigma = 0.0;
-    for (float v : samples) {
-        sigma += (v - mu) * (v - mu);
-    }
-    sigma = std::sqrt(sigma / samples.size());
-
-    return {mu, sigma};
+    return {mean, std::sqrt(m2 / n)};
 }
 
 size_t GaussDistributionHandler::count() const {
-    return samples.size();
+    return n;
 }
 
-ParticleIdCountSorter::ParticleIdCountSorter(): idCounts(), types() {
+float GaussDistributionHandler::min() const {
+    return n ? minValue : 0.f;
 }
 
+float GaussDistributionHandler::max() const {
+    return n ? maxValue : 0.f;
+}
 
-void ParticleIdCountSorter::update(int v) {
-    idCounts[v]++;
-    if (std::find(types.begin(), types.end(), v) == types.end()) {
-        types.push_back(v);
+double GaussDistributionHandler::skewness() const {
+    if (!higherMoments || n == 0 || m2 == 0.0) {
+        return 0.0;
     }
+    return std::sqrt(double(n)) * m3 / std::pow(m2, 1.5);
 }
 
-std::vector<int> ParticleIdCountSorter::getres() {
-    std::sort(types.begin(), types.end(), [&](int k1, int k2) {
-        return idCounts[k1] > idCounts[k2];
-    });
-    return types;
+double GaussDistributionHandler::kurtosis() const {
+    if (!higherMoments || n == 0 || m2 == 0.0) {
+        return 0.0;
+    }
+    return double(n) * m4 / (m2 * m2) - 3.0;
+}
+
+ElementRanking::ElementRanking() {
+    counts.fill(0);
+    rankOf.fill(-1);
+}
+
+void ElementRanking::merge(const ElementRanking& other) {
+    for (int i = 0; i < other.seenCount; i++) {
+        add(other.seen[i], other.counts[other.seen[i]]);
+    }
 }
 
-void ParticleIdCountSorter::reset() {
-    idCounts.clear();
-    types.clear();
+void ElementRanking::reset() {
+    for (int i = 0; i < seenCount; i++) {
+        counts[seen[i]] = 0;
+    }
+    for (int i = 0; i < topCount; i++) {
+        rankOf[top[i]] = -1;
+    }
+    seenCount = 0;
+    topCount = 0;
 }
 
 
@@ -146,7 +164,7 @@ MasterHandler::~MasterHandler() {
     delete tempHandler;
 }
 
-void MasterHandler::update(Particle* p) {
+void MasterHandler::update(const Particle* p) {
     
     yHandler->update(p->y);
     xHandler->update(p->x);
@@ -167,6 +185,24 @@ void MasterHandler::update(Particle* p) {
 
 }
 
+void MasterHandler::merge(const MasterHandler& other) {
+    if (other.p_count == 0) {
+        return;
+    }
+    yHandler->merge(*other.yHandler);
+    xHandler->merge(*other.xHandler);
+    velHandler->merge(*other.velHandler);
+    tempHandler->merge(*other.tempHandler);
+    if (p_count == 0) {
+        p_type = other.p_type;
+        p_solid = other.p_solid;
+        p_liquid = other.p_liquid;
+        p_gas = other.p_gas;
+        p_energy = other.p_energy;
+    }
+    p_count += other.p_count;
+}
+
 void MasterHandler::get(MasterReturnParams* params) const {
     
     auto [muY, sigY] = yHandler->get();
@@ -188,6 +224,10 @@ void MasterHandler::get(MasterReturnParams* params) const {
     params->p_liquid = p_liquid;
     params->p_gas = p_gas;
     params->p_energy = p_energy;
+    params->sampled = false;
+    params->yConfidence = 0;
+    params->velConfidence = 0;
+    params->tempConfidence = 0;
     
 
     /*
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "simulation/ElementDefs.h"
 #include "simulation/Particle.h"
 
+#include <array>
 #include <vector>
 #include <unordered_map>
 #include <algorithm>
@@ -9,30 +11,7 @@
 #include <cmath>
 #include <tuple>
 
-class BinHandler {
-public:
-    BinHandler(int count); // Constructor
-    void reset();          // Reset bin counts
-    void update(int index); // Update a specific bin
-    std::vector<int> get(); // Get bin counts
-
-private:
-    int binCount;
-    std::vector<int> bins;
-};
-
-class PlantHandler {
-public:
-    PlantHandler();       // Constructor
-    void reset();         // Reset plant states
-    void update(int y); // Update plant at index
-    void kill(int y); // Kill plant at index
-    std::tuple<std::vector<int>, std::vector<int>> get(); // Get bin data
-
-private:
-    BinHandler newBins;
-    BinHandler deletedBins;
-};
+#define HANDLERS 6
 
 typedef std::pair<double, double> DistParams;
 typedef std::pair<double, double> GaussParams;
@@ -47,6 +26,11 @@ typedef struct MasterReturnParams {
     bool p_liquid;
     bool p_gas;
     bool p_energy; 
+    // set when the handler only saw a sample of its particles, count is exact regardless
+    bool sampled;
+    float yConfidence; // half-widths of the 95% confidence intervals of the means
+    float velConfidence;
+    float tempConfidence;
 } _MasterReturnParams;
 
 
@@ -58,40 +42,102 @@ public:
     DistributionHandler();
     void reset();
     void update(int v);
+    void merge(const DistributionHandler& other);
     std::pair<int, int> get() const;
 
 private:
     int min, max;
 };
 
+// Streaming mean/variance estimator (Welford), constant memory regardless of sample count.
+// Third and fourth central moments are only tracked if requested at construction.
 class GaussDistributionHandler {
 public:
+    GaussDistributionHandler(bool higherMoments = false);
     void update(float v);
+    void merge(const GaussDistributionHandler& other); // combine partial accumulators (Chan et al.)
     void reset();
-    std::pair<double, double> get() const;
+    std::pair<double, double> get() const; // {mean, population sigma}
     size_t count() const;
+    float min() const;
+    float max() const;
+    double skewness() const;
+    double kurtosis() const; // excess kurtosis
 
 private:
-    std::vector<float> samples;
+    bool higherMoments;
+    size_t n;
+    double mean;
+    double m2;
+    double m3;
+    double m4;
+    float minValue;
+    float maxValue;
 };
 
-class ParticleIdCountSorter {
+// Counts particles per element type and keeps the HANDLERS most common types ranked as it
+// goes, so reading the ranking is O(HANDLERS) instead of sorting every type seen in the frame.
+// Counts only ever grow, so a type only ever climbs, and while counting one particle at a time
+// it climbs at most past the types it just tied with.
+class ElementRanking {
 public:
-    ParticleIdCountSorter();
-    void update(int v);
-    std::vector<int> getres();
+    ElementRanking();
+
+    void update(int type) {
+        add(type, 1);
+    }
+
+    void add(int type, int n) {
+        auto count = counts[type] += n;
+        if (count == n) {
+            seen[seenCount++] = type;
+        }
+        auto pos = rankOf[type];
+        if (pos < 0) {
+            if (topCount < HANDLERS) {
+                pos = topCount++;
+            } else if (count > counts[top[HANDLERS - 1]]) {
+                pos = HANDLERS - 1;
+                rankOf[top[pos]] = -1;
+            } else {
+                return;
+            }
+            top[pos] = type;
+            rankOf[type] = pos;
+        }
+        while (pos > 0 && counts[top[pos - 1]] < count) {
+            std::swap(top[pos], top[pos - 1]);
+            rankOf[top[pos]] = pos;
+            pos--;
+        }
+        rankOf[type] = pos;
+    }
+
+    int size() const { return topCount; }
+    int type(int rank) const { return top[rank]; } // rank 0 is the most common type
+    int count(int type) const { return counts[type]; }
+    bool isRanked(int type) const { return rankOf[type] >= 0; }
+
+    // adds the counts of other, which may have been counted on another thread
+    void merge(const ElementRanking& other);
+    // only touches the types seen since the last reset
     void reset();
 
 private:
-    std::unordered_map<int, int> idCounts;
-    std::vector<int> types;
+    std::array<int, PT_NUM> counts;
+    std::array<int, PT_NUM> rankOf; // position in top, -1 if not ranked
+    std::array<int, PT_NUM> seen;
+    int seenCount = 0;
+    std::array<int, HANDLERS> top;
+    int topCount = 0;
 };
 
 class MasterHandler {
 public:
     MasterHandler();
     ~MasterHandler();
-    void update(Particle* p);
+    void update(const Particle* p);
+    void merge(const MasterHandler& other);
     void get(MasterReturnParams* params) const;
     void reset();
 
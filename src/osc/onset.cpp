@@ -0,0 +1,97 @@
+#include "onset.h"
+#include <algorithm>
+#include <cmath>
+
+void OnsetDetector::SetConfig(const OscOnsetConfig& newConfig) {
+    config = newConfig;
+    config.sensitivity = std::max(config.sensitivity, 1.0f);
+    config.minMagnitude = std::max(config.minMagnitude, 0.0f);
+    config.adaptRate = std::clamp(config.adaptRate, 0.001f, 1.0f);
+    if (!config.enabled) {
+        primed = false;
+        previous = {};
+        change = {};
+        usual = {};
+        threshold = {};
+        candidates = {};
+    }
+}
+
+int OnsetDetector::Detect(const float (&pv)[YCELLS][XCELLS], std::array<OscOnset, MAX_ONSETS>& onsets) {
+    if (!config.enabled) {
+        return 0;
+    }
+    auto* current = &pv[0][0];
+    if (!primed) {
+        previous.assign(current, current + NCELL);
+        change.assign(NCELL, 0.0f);
+        usual.assign(NCELL, 0.0f);
+        threshold.assign(NCELL, 0.0f);
+        primed = true;
+        return 0;
+    }
+
+    // branch-free over the whole map
+    auto rate = config.adaptRate;
+    auto sensitivity = config.sensitivity;
+    auto minMagnitude = config.minMagnitude;
+    candidates.clear();
+    for (int y = 0; y < YCELLS; y++) {
+        auto* currentRow = current + y * XCELLS;
+        auto* previousRow = &previous[y * XCELLS];
+        auto* changeRow = &change[y * XCELLS];
+        auto* usualRow = &usual[y * XCELLS];
+        auto* thresholdRow = &threshold[y * XCELLS];
+        int over = 0;
+        for (int x = 0; x < XCELLS; x++) {
+            // only rises count, the same wave falling back is not a new hit
+            auto delta = std::max(std::abs(currentRow[x]) - std::abs(previousRow[x]), 0.0f);
+            // compared against the average before it takes this frame in
+            thresholdRow[x] = std::max(minMagnitude, sensitivity * usualRow[x]);
+            over += delta > thresholdRow[x];
+            changeRow[x] = delta;
+            usualRow[x] += (delta - usualRow[x]) * rate;
+            previousRow[x] = currentRow[x];
+        }
+        if (!over) {
+            continue;
+        }
+        for (int x = 0; x < XCELLS; x++) {
+            if (changeRow[x] > thresholdRow[x]) {
+                candidates.push_back(y * XCELLS + x);
+            }
+        }
+    }
+
+    // ties go to the first cell in row-major order, so a flat plateau fires once
+    auto isPeak = [this](int index) {
+        auto x = index % XCELLS;
+        auto y = index / XCELLS;
+        auto value = change[index];
+        for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, YCELLS - 1); ny++) {
+            for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, XCELLS - 1); nx++) {
+                auto neighbour = ny * XCELLS + nx;
+                if (neighbour == index) {
+                    continue;
+                }
+                if (change[neighbour] > value || (change[neighbour] == value && neighbour < index)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+    candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&isPeak](int index) {
+        return !isPeak(index);
+    }), candidates.end());
+
+    auto count = std::min(int(candidates.size()), MAX_ONSETS);
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), [this](int a, int b) {
+        return change[a] > change[b];
+    });
+    for (int i = 0; i < count; i++) {
+        auto index = candidates[i];
+        onsets[i] = { (index % XCELLS) * CELL + CELL / 2, (index / XCELLS) * CELL + CELL / 2, change[index] };
+    }
+    return count;
+}
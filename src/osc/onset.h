@@ -0,0 +1,53 @@
+#pragma once
+#include "SimulationConfig.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#define MAX_ONSETS 16
+
+struct OscOnsetConfig
+{
+	bool enabled = false;
+	float sensitivity = 4;    // how many times a cell's usual rise in |pv| counts as an onset
+	float minMagnitude = 0.5f; // rises in |pv| below this are never onsets, keeps calm air quiet
+	float adaptRate = 0.05f;  // weight of the newest frame in each cell's usual rise
+};
+
+struct OscOnset
+{
+	int x, y; // centre of the cell, in pixels
+	float magnitude; // rise in |pv| over the frame
+};
+
+// Finds sudden pressure changes, e.g. the front of an explosion, once per frame after the air
+// update. A cell is an onset if the rise in |pv| since the last frame exceeds both minMagnitude
+// and sensitivity times its own running average of that rise, and is the largest in its 3x3
+// neighbourhood, so one wavefront does not fire every cell it covers.
+// The per-cell passes run over whole rows and vectorise; only cells over the threshold get
+// the neighbourhood test. At most MAX_ONSETS of the largest are reported per frame.
+class OnsetDetector
+{
+public:
+	void SetConfig(const OscOnsetConfig &newConfig);
+	const OscOnsetConfig &GetConfig() const
+	{
+		return config;
+	}
+	bool Enabled() const
+	{
+		return config.enabled;
+	}
+
+	// returns the number of onsets written, the first frame after enabling only takes a reference
+	int Detect(const float (&pv)[YCELLS][XCELLS], std::array<OscOnset, MAX_ONSETS> &onsets);
+
+private:
+	OscOnsetConfig config;
+	bool primed = false;
+	std::vector<float> previous; // pv of the last frame
+	std::vector<float> change;   // rise in |pv| this frame
+	std::vector<float> usual;    // running average of change
+	std::vector<float> threshold;
+	std::vector<int> candidates;
+};
@@ -1,55 +1,24 @@
 #include <osc/osc.h>
+#include <osc/timetag.h>
+#include "simulation/ElementClasses.h"
+#include "common/platform/Platform.h"
 #include <iostream>
 #include <oscpp/client.hpp>
 #include <cstring>
 #include <iostream>
 #include <string>
 #include <array>
-#include <unordered_map>
+#include <chrono>
 #include <algorithm>
-#include <limits>
 
-#ifdef WINDOWS
-    #include <winsock2.h>
-    #pragma comment(lib, "WS2_32.lib")
-    #include "Ws2tcpip.h"
-    #include <tchar.h>
-#else
-    #include <sys/socket.h>
-    #include <sys/types.h>
-    #include <netinet/in.h>
-    #include <arpa/inet.h>
-    #include <unistd.h>
-#endif
 
 
-
-size_t makePacket(void* buffer, size_t size)
-{
-    // Construct a packet
-    OSCPP::Client::Packet packet(buffer, size);
-    packet
-        // Open a bundle with a timetag
-        .openBundle(1234ULL)
-        // for efficiency this needs to be known in advance.
-        .openMessage("/s_new", 1)
-        // Write the arguments
-        .string("hello world!")
-        .closeMessage()
-        .closeBundle();
-    return packet.size();
-}
-
-size_t makePowderAnalytics(void* buffer, size_t size, MasterReturnParams* params, int index){
-    // Construct a packet
-    OSCPP::Client::Packet packet(buffer, size);
+void writePowderAnalytics(OSCPP::Client::Packet& packet, const MasterReturnParams* params, int index){
     std::stringstream addr;
     addr << "/tpt/" << index + 1;
     packet
-        // Open a bundle with a timetag
-        .openBundle(1234ULL)
         // for efficiency this needs to be known in advance.
-        .openMessage(addr.str().c_str(), 11)
+        .openMessage(addr.str().c_str(), params->sampled ? 14 : 11)
         // Write the arguments
         .int32(params->count)
         .float32(params->temp.first)
@@ -61,141 +30,438 @@ size_t makePowderAnalytics(void* buffer, size_t size, MasterReturnParams* params
         .float32(params->y.first)
         .float32(params->y.second)
         .float32(params->x.first)
-        .float32(params->x.second)
-        
-        
-        
-        .closeMessage()
-        .closeBundle();
+        .float32(params->x.second);
+    if (params->sampled){
+        // appended so receivers that only know the first eleven arguments keep working
+        packet
+            .float32(params->tempConfidence)
+            .float32(params->velConfidence)
+            .float32(params->yConfidence);
+    }
+    packet.closeMessage();
+}
+
+void writeEventMessage(OSCPP::Client::Packet& packet, const EventHistogramFrame& histogram){
+    // for efficiency this needs to be known in advance.
+    packet.openMessage(histogram.address, histogram.bins);
+    for (int i = 0; i < histogram.bins; i++){
+        packet.int32(histogram.counts[i]);
+    }
+    packet.closeMessage();
+}
+
+size_t makePowderAnalytics(void* buffer, size_t size, const MasterReturnParams* params, int index, uint64_t timetag){
+    // Construct a packet
+    OSCPP::Client::Packet packet(buffer, size);
+    packet.openBundle(timetag);
+    writePowderAnalytics(packet, params, index);
+    packet.closeBundle();
     return packet.size();
 }
 
-size_t makePlantPacket(void* buffer, size_t size, std::vector<int> bins, const char* addr){
+size_t makeEventPacket(void* buffer, size_t size, const EventHistogramFrame& histogram, uint64_t timetag){
     // Construct a packet
     OSCPP::Client::Packet packet(buffer, size);
+    packet.openBundle(timetag);
+    writeEventMessage(packet, histogram);
+    packet.closeBundle();
+    return packet.size();
+}
+
+void writeVoiceEvent(OSCPP::Client::Packet& packet, int index, const char* event, int type){
+    std::stringstream addr;
+    addr << "/tpt/" << index + 1 << "/" << event;
     packet
-        // Open a bundle with a timetag
-        .openBundle(1234ULL)
-        // for efficiency this needs to be known in advance.
-        .openMessage(addr, 16);
-    
-    for (int i = 0; i < bins.size(); i++){
-        packet.int32(bins[i]);
-    }
-        
-        
-    packet    
-        .closeMessage()
-        .closeBundle();
+        .openMessage(addr.str().c_str(), 1)
+        .int32(type)
+        .closeMessage();
+}
+
+// /tpt/grid width height density temperature pressure, the fields being blobs of uint8 and
+// big-endian uint16, see OscGrid
+void writeGridMessage(OSCPP::Client::Packet& packet, const OscGrid& grid){
+    auto cells = size_t(grid.width * grid.height);
+    std::array<uint8_t, GRID_MAX_CELLS * 2> temperature, pressure;
+    for (size_t i = 0; i < cells; i++){
+        temperature[i * 2] = uint8_t(grid.temperature[i] >> 8);
+        temperature[i * 2 + 1] = uint8_t(grid.temperature[i]);
+        pressure[i * 2] = uint8_t(grid.pressure[i] >> 8);
+        pressure[i * 2 + 1] = uint8_t(grid.pressure[i]);
+    }
+    packet
+        .openMessage("/tpt/grid", 5)
+        .int32(grid.width)
+        .int32(grid.height)
+        .blob(OSCPP::Blob(grid.density.data(), cells))
+        .blob(OSCPP::Blob(temperature.data(), cells * 2))
+        .blob(OSCPP::Blob(pressure.data(), cells * 2))
+        .closeMessage();
+}
+
+const std::array<const char*, NUM_SPECTRUM_SOURCES> oscSpectrumSourceNames = {
+    "off", "density", "pressure",
+};
+
+// /tpt/spectrum frame power centroid orientation coherence band0..band7, frame being the one
+// the map was taken from, see OscSpectrumFeatures
+void writeSpectrumMessage(OSCPP::Client::Packet& packet, const OscSpectrumFeatures& spectrum){
+    packet
+        .openMessage("/tpt/spectrum", 5 + SPECTRUM_BANDS)
+        .int32(int32_t(spectrum.frameNumber))
+        .float32(spectrum.power)
+        .float32(spectrum.centroid)
+        .float32(spectrum.orientation)
+        .float32(spectrum.coherence);
+    for (auto band : spectrum.bands){
+        packet.float32(band);
+    }
+    packet.closeMessage();
+}
+
+// /tpt/onset x y magnitude, see OnsetDetector
+void writeOnsetMessage(OSCPP::Client::Packet& packet, const OscOnset& onset){
+    packet
+        .openMessage("/tpt/onset", 3)
+        .int32(onset.x)
+        .int32(onset.y)
+        .float32(onset.magnitude)
+        .closeMessage();
+}
+
+// the reducer's address with one argument per field, counts as ints
+void writeReducerMessage(OSCPP::Client::Packet& packet, const OscReducerFrame& reducer){
+    packet.openMessage(reducer.address, reducer.fieldCount);
+    for (int i = 0; i < reducer.fieldCount; i++){
+        if (reducer.ops[i] == OscReduceCount){
+            packet.int32(int32_t(reducer.values[i]));
+        } else {
+            packet.float32(reducer.values[i]);
+        }
+    }
+    packet.closeMessage();
+}
+
+// /tpt/perf simFps drawFps numParts lastActiveIndex airMs gravityMs particlesMs renderMs luaMs rssMB
+// the phase times are exclusive, see OscPerfScope
+void writePerfMessage(OSCPP::Client::Packet& packet, const OscPerfReport& perf){
+    packet
+        .openMessage("/tpt/perf", 5 + NUM_OSC_PERF_PHASES)
+        .float32(perf.simFps)
+        .float32(perf.drawFps)
+        .int32(perf.numParts)
+        .int32(perf.lastActiveIndex);
+    for (auto ms : perf.phaseMs){
+        packet.float32(ms);
+    }
+    packet
+        .float32(perf.rssMB)
+        .closeMessage();
+}
+
+// One bundle per simulation frame carrying every handler and event histogram. Voice
+// changes come first so receivers can set up a voice before its first analytics arrive.
+size_t makeFramePacket(void* buffer, size_t size, const OscFrame& frame){
+    OSCPP::Client::Packet packet(buffer, size);
+    packet.openBundle(frame.timetag);
+    for (int i = 0; i < HANDLERS; i++){
+        if (frame.voiceEvents.off[i] >= 0){
+            writeVoiceEvent(packet, i, "off", frame.voiceEvents.off[i]);
+        }
+    }
+    for (int i = 0; i < HANDLERS; i++){
+        if (frame.voiceEvents.on[i] >= 0){
+            writeVoiceEvent(packet, i, "on", frame.voiceEvents.on[i]);
+        }
+    }
+    for (int i = 0; i < HANDLERS; i++){
+        writePowderAnalytics(packet, &frame.handlers[i], i);
+    }
+    for (int i = 0; i < frame.eventCount; i++){
+        writeEventMessage(packet, frame.events[i]);
+    }
+    for (int i = 0; i < frame.reducerCount; i++){
+        writeReducerMessage(packet, frame.reducers[i]);
+    }
+    for (int i = 0; i < frame.onsetCount; i++){
+        writeOnsetMessage(packet, frame.onsets[i]);
+    }
+    if (frame.grid.width > 0){
+        writeGridMessage(packet, frame.grid);
+    }
+    if (frame.spectrum.valid){
+        writeSpectrumMessage(packet, frame.spectrum);
+    }
+    if (frame.perf.valid){
+        writePerfMessage(packet, frame.perf);
+    }
+    packet.closeBundle();
     return packet.size();
 }
 
 
-void oscTest(){
-    
-	std::cout << "hello world" << std::endl;
+ TPTOscClient::TPTOscClient() : partSorter() {
+    // the plant histograms this client always had, new plants and plants turning into something else
+    EventHistogramConfig plantNew;
+    plantNew.kind = OscEventCreate;
+    plantNew.types = { PT_PLNT, PT_VINE };
+    plantNew.axis = OscAxisY;
+    plantNew.bins = 16;
+    plantNew.address = "/tptplantnew/";
+    events.Add(plantNew);
+    auto plantDel = plantNew;
+    plantDel.kind = OscEventChangeFrom;
+    plantDel.address = "/tptplantdel/";
+    events.Add(plantDel);
 }
 
 // Used for polyphonic handling so grains don't jump between handlers
-void reorder_second_array(std::vector<int>* first_array, std::vector<int>* second_array) {
-    // Create a map to store element to index mapping from the first array
-    std::unordered_map<int, size_t> element_to_index;
-    for (size_t index = 0; index < first_array->size(); ++index) {
-        element_to_index[(*first_array)[index]] = index;
+void TPTOscClient::SortParticles(uint64_t seed){
+    auto start = std::chrono::steady_clock::now();
+    voices.Update(partSorter);
+    int population = 0;
+    for (int i = 0; i < HANDLERS; i++){
+        auto type = voices.TypeOf(i);
+        if (type >= 0){
+            population += partSorter.count(type);
+        }
     }
-    
-    // Sort the second array based on the indices in the first array
-    std::sort(second_array->begin(), second_array->end(), [&](int a, int b) {
-        size_t index_a = element_to_index.count(a) ? element_to_index[a] : std::numeric_limits<size_t>::max();
-        size_t index_b = element_to_index.count(b) ? element_to_index[b] : std::numeric_limits<size_t>::max();
-        return index_a < index_b;
-    });
+    sampler.BeginFrame(seed, population);
+    partSorter.reset();
+    frameCostNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    lastFrameCostNs = frameCostNs;
+    frameCostNs = 0;
 }
 
- TPTOscClient::TPTOscClient() : partSorter() {
-    // MAKEWORD(1,1) for Winsock 1.1, MAKEWORD(2,0) for Winsock 2.0
-    #ifdef WINDOWS
-	  WSADATA wsaData;
-    if (WSAStartup(MAKEWORD(1, 1), &wsaData) != 0) {
-        fprintf(stderr, "WSAStartup failed.\n");
-        //exit(1);
+// Tiles are merged in tile order, so the ranking breaks ties the same way on any number of
+// threads, and the handlers combine their moments with the pairwise updates of Chan et al.
+void TPTOscClient::MergeTile(OscTileAccumulator& tile){
+    partSorter.merge(tile.ranking);
+    tile.ranking.reset();
+    for (int i = 0; i < HANDLERS; i++){
+        handlers[i].merge(tile.handlers[i]);
+        tile.handlers[i].reset();
     }
-    #endif
+    tile.sampled.fill(0);
+    reducers.Merge(reducerTotals, tile.reducers);
+}
 
+void TPTOscClient::AddEventHistogram(const EventHistogramConfig& config){
+    events.Add(config);
+}
 
-    // Set up connection
-    std::string hostname{ "127.0.0.1" };
-    uint16_t port = 9000;
-	
-	sock = ::socket(AF_INET, SOCK_DGRAM, 0);
+void TPTOscClient::ClearEventHistograms(){
+    events.Clear();
+}
 
-    destination.sin_family = AF_INET;
-    destination.sin_port = htons(port);
-	destination.sin_addr.s_addr = inet_addr("127.0.0.1");
+std::vector<EventHistogramConfig> TPTOscClient::GetEventHistograms() const {
+    return events.GetConfigs();
 }
 
-TPTOscClient::~TPTOscClient(){
-    #ifdef WINDOWS
-    WSACleanup();
-    ::closesocket(sock);
-    #else
-    close(sock);
-    #endif
 
+
+// Only snapshots this frame's results, encoding and sending happens on the sender's thread
+void TPTOscClient::AnalyzeAndSend(const float (&pv)[YCELLS][XCELLS]){
+    auto start = std::chrono::steady_clock::now();
+    auto& frame = sender.Writable();
+    frame.frameNumber = frameNumber++;
+    frame.publishNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    frame.timetag = OscFrameTimetag(latencyNs);
+    for (int i = 0; i < HANDLERS; i++){
+        auto& params = frame.handlers[i];
+        handlers[i].get(&params);
+        handlers[i].reset();
+        auto type = voices.TypeOf(i);
+        frame.voiceTypes[i] = type;
+        if (sampler.Enabled() && type >= 0){
+            // handlers only count what they were fed, the ranking saw every particle
+            auto sampleCount = params.count;
+            auto population = partSorter.count(type);
+            params.sampled = true;
+            params.count = population;
+            params.yConfidence = float(MeanConfidence(params.y.second, sampleCount, population));
+            params.velConfidence = float(MeanConfidence(params.vel.second, sampleCount, population));
+            params.tempConfidence = float(MeanConfidence(params.temp.second, sampleCount, population) / 2100);
+        }
+    }
+
+    frame.eventCount = events.Collect(frame.events);
+    frame.reducerCount = reducers.Collect(reducerTotals, frame.reducers);
+    if (reducerCallback && frame.reducerCount){
+        reducerCallback(frame.reducers.data(), frame.reducerCount);
+    }
+    frame.voiceEvents = voices.TakeEvents();
+    // detected in BeforeSim of this frame, so they share its timetag
+    frame.onsetCount = onsetCount;
+    std::copy(onsets.begin(), onsets.begin() + onsetCount, frame.onsets.begin());
+    onsetCount = 0;
+    grid.Reduce(pv, frame.grid);
+    frame.spectrum = {};
+    if (spectrum){
+        if (spectrumSource == OscSpectrumPressure){
+            std::copy(&pv[0][0], &pv[0][0] + NCELL, spectrumInput.begin());
+        }
+        spectrum->Exchange(spectrumInput, frame.frameNumber, frame.spectrum);
+        // either the worker's old buffer or this frame's, which it was too busy to take
+        std::fill(spectrumInput.begin(), spectrumInput.end(), 0.f);
+    }
+    frame.perf = perf;
+    perf.valid = false;
+
+    sender.Publish();
+    frameCostNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
 }
 
-void TPTOscClient::CountParticle(Particle* p){
-    partSorter.update(p->type);
+void TPTOscClient::AddReducer(const OscReducerConfig& config){
+    reducers.Add(config);
 }
 
-void TPTOscClient::SortParticles(){
-    auto newSorted = partSorter.getres();
-    reorder_second_array(&sorted, &newSorted);
-    sorted = newSorted;
-    std::stringstream sortStream;
-    /*for (size_t i = 0; i < sorted.size(); i++){
-        sortStream << i + 1 << " : " << sorted[i] << "\n";
-    }
-    std::cout << sortStream.str() << std::endl;*/
-    partSorter.reset();
+void TPTOscClient::ClearReducers(){
+    reducers.Clear();
+    reducerTotals = {};
+}
+
+std::vector<OscReducerConfig> TPTOscClient::GetReducers() const {
+    return reducers.GetConfigs();
 }
 
-void TPTOscClient::NewPlant(int y){
-    plantHandler.update(y);
+void TPTOscClient::SetReducerCallback(ReducerCallback callback){
+    reducerCallback = std::move(callback);
 }
 
-void TPTOscClient::KillPlant(int y){
-    plantHandler.kill(y);
+void TPTOscClient::SetLatency(double seconds){
+    latencyNs = int64_t(seconds * 1e9);
 }
 
+double TPTOscClient::GetLatency() const {
+    return latencyNs / 1e9;
+}
 
+void TPTOscClient::SetVoiceConfig(const VoiceAllocatorConfig& config){
+    voices.SetConfig(config);
+}
 
-void TPTOscClient::ProcessParticle(Particle* p){
-    int searchSize = std::min(sorted.size(), handlers.size());
-    for (int i = 0; i < searchSize; i++){
-        if (sorted[i] == p->type){
-            handlers[i].update(p);
-            break;
-        }
-            
+VoiceAllocatorConfig TPTOscClient::GetVoiceConfig() const {
+    return voices.GetConfig();
+}
+
+void TPTOscClient::SetSamplingConfig(const OscSamplingConfig& config){
+    sampler.SetConfig(config);
+}
+
+OscSamplingConfig TPTOscClient::GetSamplingConfig() const {
+    return sampler.GetConfig();
+}
+
+int TPTOscClient::GetSamplingStride() const {
+    return sampler.GetStride();
+}
+
+void TPTOscClient::SetGridSize(int width, int height){
+    grid.SetSize(width, height);
+}
+
+std::pair<int, int> TPTOscClient::GetGridSize() const {
+    return { grid.GetWidth(), grid.GetHeight() };
+}
+
+void TPTOscClient::SetOnsetConfig(const OscOnsetConfig& config){
+    onsetDetector.SetConfig(config);
+}
+
+OscOnsetConfig TPTOscClient::GetOnsetConfig() const {
+    return onsetDetector.GetConfig();
+}
+
+void TPTOscClient::SetPerf(bool enabled){
+    OscPerfCounters::SetEnabled(enabled);
+    lastPerfNs = 0;
+}
+
+bool TPTOscClient::GetPerf() const {
+    return OscPerfCounters::Enabled();
+}
+
+void TPTOscClient::MakePerfReport(int numParts, int lastActiveIndex){
+    auto nowNs = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    if (!lastPerfNs){
+        lastPerfNs = nowNs;
+        return;
     }
+    auto elapsedNs = nowNs - lastPerfNs;
+    if (elapsedNs < 1000000000){
+        return;
+    }
+    lastPerfNs = nowNs;
+    auto snapshot = OscPerfCounters::Take();
+    auto perFrameMs = [](uint64_t ns, uint64_t frames) {
+        return frames ? float(ns / 1e6 / frames) : 0.f;
+    };
+    perf.valid = true;
+    perf.simFps = float(snapshot.simFrames * 1e9 / elapsedNs);
+    perf.drawFps = float(snapshot.drawFrames * 1e9 / elapsedNs);
+    perf.numParts = numParts;
+    perf.lastActiveIndex = lastActiveIndex;
+    for (int i = 0; i < NUM_OSC_PERF_PHASES; i++){
+        perf.phaseMs[i] = perFrameMs(snapshot.phaseNs[i], i == OscPerfRender ? snapshot.drawFrames : snapshot.simFrames);
+    }
+    auto rss = Platform::ResidentMemory();
+    perf.rssMB = rss ? float(*rss / 1048576.0) : -1.f;
 }
 
-void TPTOscClient::AnalyzeAndSend(){
-    MasterReturnParams params;
-    for (int i = 0; i < handlers.size(); i++){
-        
-        handlers[i].get(&params);
-        handlers[i].reset();
-        const size_t packetSize = makePowderAnalytics(sendBuffer.data(), sendBuffer.size(), &params, i);
-        int n_bytes = ::sendto(sock, sendBuffer.data(), packetSize, 0, reinterpret_cast<sockaddr*>(&destination), sizeof(destination));
+void TPTOscClient::SetSpectrumSource(OscSpectrumSource source){
+    spectrumSource = source;
+    if (source == OscSpectrumOff){
+        spectrum.reset();
+        spectrumInput = {};
+        return;
     }
+    spectrumInput.assign(NCELL, 0.f);
+    if (!spectrum){
+        spectrum = OscSpectrum::Create();
+    }
+}
 
-     auto [newBins, deletedBins] = plantHandler.get();
-    const size_t packetSize = makePlantPacket(sendBuffer.data(), sendBuffer.size(), newBins, "/tptplantnew/");
-    int n_bytes = ::sendto(sock, sendBuffer.data(), packetSize, 0, reinterpret_cast<sockaddr*>(&destination), sizeof(destination));
+OscSenderStats TPTOscClient::GetSenderStats() const {
+    return sender.GetStats();
+}
 
-    const size_t packetSize2 = makePlantPacket(sendBuffer.data(), sendBuffer.size(), deletedBins, "/tptplantdel/");
-    n_bytes = ::sendto(sock, sendBuffer.data(), packetSize, 0, reinterpret_cast<sockaddr*>(&destination), sizeof(destination));
-     plantHandler.reset();
+std::vector<OscTargetStats> TPTOscClient::GetTargetStats() const {
+    return sender.GetTargetStats();
+}
+
+void TPTOscClient::SetTargets(const std::vector<std::string>& uris){
+    sender.SetTargets(uris);
+}
+
+std::vector<std::string> TPTOscClient::GetTargets() const {
+    return sender.GetTargets();
+}
+
+void TPTOscClient::SetRecording(const std::string& path){
+    sender.SetRecording(path);
+}
+
+std::string TPTOscClient::GetRecording() const {
+    return sender.GetRecording();
+}
+
+void TPTOscClient::SetDeltaConfig(const OscDeltaConfig& config){
+    sender.SetDeltaConfig(config);
+}
+
+OscDeltaConfig TPTOscClient::GetDeltaConfig() const {
+    return sender.GetDeltaConfig();
+}
+
+void TPTOscClient::SetControl(const std::string& uri){
+    if (uri.empty()) {
+        control.reset();
+        return;
+    }
+    if (control && control->GetUri() == uri) {
+        return;
+    }
+    // free the port before binding it again in case only the host changed
+    control.reset();
+    control = std::make_unique<OscControlServer>(uri);
 }
@@ -1,46 +1,209 @@
 #pragma once
 #include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include "accumulator.h"
+#include "control.h"
 #include "handler.h"
-
-#ifdef WINDOWS
-    #include <winsock2.h>
-    #pragma comment(lib, "WS2_32.lib")
-		#undef GetUserNameW
-    #include "Ws2tcpip.h"
-#else
-    #include <sys/socket.h>
-    #include <sys/types.h>
-    #include <netinet/in.h>
-    #include <arpa/inet.h>
-#endif
-
+#include "onset.h"
+#include "perf.h"
+#include "sampler.h"
+#include "sender.h"
+#include "spectrum.h"
+#include "simulation/ElementDefs.h"
 
 #include "simulation/Particle.h"
 
-#define kMaxPacketSize 8192
-#define HANDLERS 6
-
-void oscTest();
+namespace OSCPP::Client
+{
+	class Packet;
+}
 
+void writePowderAnalytics(OSCPP::Client::Packet& packet, const MasterReturnParams* params, int index);
+void writeEventMessage(OSCPP::Client::Packet& packet, const EventHistogramFrame& histogram);
+void writeVoiceEvent(OSCPP::Client::Packet& packet, int index, const char* event, int type); // /tpt/N/on, /tpt/N/off
+void writeGridMessage(OSCPP::Client::Packet& packet, const OscGrid& grid);
+void writeSpectrumMessage(OSCPP::Client::Packet& packet, const OscSpectrumFeatures& spectrum);
+void writeOnsetMessage(OSCPP::Client::Packet& packet, const OscOnset& onset);
+void writeReducerMessage(OSCPP::Client::Packet& packet, const OscReducerFrame& reducer);
+void writePerfMessage(OSCPP::Client::Packet& packet, const OscPerfReport& perf);
+size_t makePowderAnalytics(void* buffer, size_t size, const MasterReturnParams* params, int index, uint64_t timetag);
+size_t makeEventPacket(void* buffer, size_t size, const EventHistogramFrame& histogram, uint64_t timetag);
+size_t makeFramePacket(void* buffer, size_t size, const OscFrame& frame);
 
 class TPTOscClient
 {
 public:
 	TPTOscClient();
-	~TPTOscClient();
-	void AnalyzeAndSend();
-	void ProcessParticle(Particle* p);
-	void CountParticle(Particle* p);
-	void SortParticles();
-	void KillPlant(int y);
-	void NewPlant(int y);
+	void AnalyzeAndSend(const float (&pv)[YCELLS][XCELLS]);
+	void SortParticles(uint64_t seed); // seed for the next frame's sample, see HandlerSampler
+	// once per frame before AnalyzeAndSend, puts a /tpt/perf report in the frame if one is due
+	void UpdatePerf(int numParts, int lastActiveIndex)
+	{
+		if (OscPerfCounters::Enabled())
+		{
+			MakePerfReport(numParts, lastActiveIndex);
+		}
+	}
+	// right after the air update, the onsets go out with this frame's bundle
+	void DetectOnsets(const float (&pv)[YCELLS][XCELLS])
+	{
+		if (onsetDetector.Enabled())
+		{
+			auto start = std::chrono::steady_clock::now();
+			onsetCount = onsetDetector.Detect(pv, onsets);
+			frameCostNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		}
+	}
+
+	// The frame most recently handed to the sender. AnalyzeAndSend fills another slot of the
+	// sender's ring, so this stays whole for the simulation thread and whatever runs in step
+	// with it, like the debug overlay, without copying or recomputing anything.
+	const OscFrame &GetLastFrame() const
+	{
+		return sender.LastPublished();
+	}
+	// time the last frame spent in the per-frame analytics stages, not counting the
+	// per-particle accumulation inside the particle loop
+	uint64_t GetFrameCostNs() const
+	{
+		return lastFrameCostNs;
+	}
+
+	// Single-pass analytics: counts the particle towards the next frame's ranking and feeds it
+	// to the handler its type was assigned to after the previous frame
+	void AccumulateParticle(const Particle &p)
+	{
+		accumulate(p, reducerTotals, partSorter, handlers, [this](int slot) {
+			return sampler.Take(slot);
+		});
+	}
+	// the same for a particle updated on a worker of a tiled update, see OscTileAccumulator
+	void AccumulateParticle(const Particle &p, OscTileAccumulator &tile)
+	{
+		accumulate(p, tile.reducers, tile.ranking, tile.handlers, [this, &tile](int slot) {
+			return sampler.Take(slot, tile.sampled[slot]++);
+		});
+	}
+	// adds what a tile accumulated to this frame's and clears it for the next frame
+	void MergeTile(OscTileAccumulator &tile);
+
+	// per-frame event histograms, see events.h; /tptplantnew/ and /tptplantdel/ are registered
+	// by default
+	bool WantsEvent(OscEventKind kind, int type) const
+	{
+		return events.Wants(kind, type);
+	}
+	void RecordEvent(OscEventKind kind, int type, int x, int y, float temp)
+	{
+		events.Record(kind, type, x, y, temp);
+	}
+	void AddEventHistogram(const EventHistogramConfig& config); // throws std::runtime_error
+	void ClearEventHistograms();
+	std::vector<EventHistogramConfig> GetEventHistograms() const;
+	// user-defined reducers, see reducer.h
+	void AddReducer(const OscReducerConfig& config); // throws std::runtime_error
+	void ClearReducers();
+	std::vector<OscReducerConfig> GetReducers() const;
+	// called once per frame with every reducer's results, which it may change before they are
+	// sent; never called per particle. Pass an empty function to remove it.
+	using ReducerCallback = std::function<void (OscReducerFrame *results, int count)>;
+	void SetReducerCallback(ReducerCallback callback);
+	OscSenderStats GetSenderStats() const;
+	std::vector<OscTargetStats> GetTargetStats() const;
+	void SetTargets(const std::vector<std::string>& uris); // see transport.h, throws std::runtime_error
+	std::vector<std::string> GetTargets() const;
+	void SetRecording(const std::string& path); // see OscSender::SetRecording
+	std::string GetRecording() const;
+	void SetDeltaConfig(const OscDeltaConfig& config); // see OscDeltaEncoder
+	OscDeltaConfig GetDeltaConfig() const;
+	void SetLatency(double seconds); // added to bundle timetags so receivers can schedule ahead
+	double GetLatency() const;
+	void SetVoiceConfig(const VoiceAllocatorConfig& config);
+	VoiceAllocatorConfig GetVoiceConfig() const;
+	void SetSamplingConfig(const OscSamplingConfig& config);
+	OscSamplingConfig GetSamplingConfig() const;
+	int GetSamplingStride() const; // 1 when every particle is looked at
+	void SetGridSize(int width, int height); // spatial map, see grid.h; 0 turns it off
+	std::pair<int, int> GetGridSize() const;
+	void SetOnsetConfig(const OscOnsetConfig& config); // see onset.h
+	OscOnsetConfig GetOnsetConfig() const;
+	// /tpt/perf once a second, see perf.h; the counters are process-wide
+	void SetPerf(bool enabled);
+	bool GetPerf() const;
+	// spatial frequency features of a cell map, see spectrum.h; starts or stops the worker
+	void SetSpectrumSource(OscSpectrumSource source);
+	OscSpectrumSource GetSpectrumSource() const
+	{
+		return spectrumSource;
+	}
+	// starts listening for control messages, see control.h; an empty uri stops listening.
+	// throws std::runtime_error if the uri cannot be bound, which leaves control disabled
+	void SetControl(const std::string& uri);
+	OscControlServer *GetControl() const
+	{
+		return control.get();
+	}
 	
 private:
-	int sock;
-	sockaddr_in destination;
-	PlantHandler plantHandler;
-	std::array<char, kMaxPacketSize> sendBuffer;
+	void MakePerfReport(int numParts, int lastActiveIndex);
+
+	// both AccumulateParticle; take says whether a handler that is being sampled gets the particle
+	template<class Take>
+	void accumulate(const Particle &p, OscReducerTotals &reducerInto, ElementRanking &ranking, std::array<MasterHandler, HANDLERS> &handlerInto, Take &&take)
+	{
+		if (reducers.Any())
+		{
+			reducers.Accumulate(p, reducerInto);
+		}
+		if (grid.Enabled())
+		{
+			grid.Accumulate(p);
+		}
+		if (spectrumSource == OscSpectrumDensity)
+		{
+			auto cx = unsigned(int(p.x + 0.5f)) / CELL;
+			auto cy = unsigned(int(p.y + 0.5f)) / CELL;
+			if (cx < unsigned(XCELLS) && cy < unsigned(YCELLS))
+			{
+				spectrumInput[cy * XCELLS + cx] += 1;
+			}
+		}
+		if (p.vx != 0 && p.vy != 0)
+		{
+			ranking.update(p.type);
+			auto slot = voices.VoiceOf(p.type);
+			if (slot >= 0 && (!sampler.Enabled() || take(slot)))
+			{
+				handlerInto[slot].update(&p);
+			}
+		}
+	}
+
+	EventHistograms events;
+	OscReducers reducers;
+	OscReducerTotals reducerTotals;
+	ReducerCallback reducerCallback;
 	std::array<MasterHandler, HANDLERS> handlers; 
-	ParticleIdCountSorter partSorter;
-	std::vector<int> sorted;
+	ElementRanking partSorter;
+	VoiceAllocator voices;
+	SpatialGrid grid;
+	HandlerSampler sampler;
+	OscSpectrumSource spectrumSource = OscSpectrumOff;
+	OscSpectrumInput spectrumInput;
+	OscSpectrumPtr spectrum;
+	OnsetDetector onsetDetector;
+	int onsetCount = 0;
+	std::array<OscOnset, MAX_ONSETS> onsets;
+	OscPerfReport perf;
+	uint64_t lastPerfNs = 0;
+	uint64_t frameNumber = 0;
+	uint64_t frameCostNs = 0;
+	uint64_t lastFrameCostNs = 0;
+	int64_t latencyNs = 0;
+	OscSender sender;
+	std::unique_ptr<OscControlServer> control;
 };
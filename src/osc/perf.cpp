@@ -0,0 +1,25 @@
+#include "perf.h"
+
+std::atomic<bool> OscPerfCounters::enabled = false;
+std::array<std::atomic<uint64_t>, NUM_OSC_PERF_PHASES> OscPerfCounters::phaseNs = {};
+std::atomic<uint64_t> OscPerfCounters::simFrames = 0;
+std::atomic<uint64_t> OscPerfCounters::drawFrames = 0;
+thread_local OscPerfScope *OscPerfScope::innermost = nullptr;
+
+void OscPerfCounters::SetEnabled(bool newEnabled) {
+    if (newEnabled && !Enabled()) {
+        // don't report whatever was left over from the last time
+        Take();
+    }
+    enabled.store(newEnabled, std::memory_order_relaxed);
+}
+
+OscPerfSnapshot OscPerfCounters::Take() {
+    OscPerfSnapshot snapshot;
+    for (int i = 0; i < NUM_OSC_PERF_PHASES; i++) {
+        snapshot.phaseNs[i] = phaseNs[i].exchange(0, std::memory_order_relaxed);
+    }
+    snapshot.simFrames = simFrames.exchange(0, std::memory_order_relaxed);
+    snapshot.drawFrames = drawFrames.exchange(0, std::memory_order_relaxed);
+    return snapshot;
+}
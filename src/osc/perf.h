@@ -0,0 +1,118 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+enum OscPerfPhase
+{
+	OscPerfAir,       // Air::update_air and update_airh
+	OscPerfGravity,   // dispatching Newtonian gravity
+	OscPerfParticles, // Simulation::UpdateParticles
+	OscPerfRender,    // Renderer::RenderSimulation, may be on the render thread
+	OscPerfLua,       // Lua callbacks, not counted in whatever phase called them
+	NUM_OSC_PERF_PHASES
+};
+
+struct OscPerfSnapshot
+{
+	std::array<uint64_t, NUM_OSC_PERF_PHASES> phaseNs;
+	uint64_t simFrames;
+	uint64_t drawFrames;
+};
+
+// /tpt/perf, sent with the first frame after each second
+struct OscPerfReport
+{
+	bool valid = false;
+	float simFps = 0;
+	float drawFps = 0;
+	int numParts = 0;
+	int lastActiveIndex = 0;
+	std::array<float, NUM_OSC_PERF_PHASES> phaseMs = {}; // per simulated frame, render per drawn frame
+	float rssMB = -1; // -1 if the platform cannot tell
+};
+
+// Process-wide time spent in each phase, fed by OscPerfScope from whichever thread runs the
+// phase and drained once a second for /tpt/perf. Nothing is timed while disabled, so the
+// scopes cost one relaxed load each.
+class OscPerfCounters
+{
+public:
+	static bool Enabled()
+	{
+		return enabled.load(std::memory_order_relaxed);
+	}
+	static void SetEnabled(bool newEnabled);
+
+	static void Add(OscPerfPhase phase, uint64_t ns)
+	{
+		phaseNs[phase].fetch_add(ns, std::memory_order_relaxed);
+	}
+	static void SimFrame()
+	{
+		if (Enabled())
+		{
+			simFrames.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	static void DrawFrame()
+	{
+		if (Enabled())
+		{
+			drawFrames.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	// returns everything counted since the last call and starts over
+	static OscPerfSnapshot Take();
+
+private:
+	static std::atomic<bool> enabled;
+	static std::array<std::atomic<uint64_t>, NUM_OSC_PERF_PHASES> phaseNs;
+	static std::atomic<uint64_t> simFrames;
+	static std::atomic<uint64_t> drawFrames;
+};
+
+// Adds the time until the end of the scope to a phase, minus the time spent in scopes nested
+// in it on the same thread, which count towards their own phase instead. The phases thus never
+// overlap: a Lua callback run by an element's update counts as OscPerfLua only, and a Lua
+// callback running a Lua callback counts once.
+class OscPerfScope
+{
+public:
+	OscPerfScope(OscPerfPhase newPhase) : phase(newPhase)
+	{
+		if (OscPerfCounters::Enabled())
+		{
+			timing = true;
+			parent = innermost;
+			innermost = this;
+			start = std::chrono::steady_clock::now();
+		}
+	}
+	~OscPerfScope()
+	{
+		if (timing)
+		{
+			uint64_t elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+			OscPerfCounters::Add(phase, elapsedNs - nestedNs);
+			if (parent)
+			{
+				parent->nestedNs += elapsedNs;
+			}
+			innermost = parent;
+		}
+	}
+
+	OscPerfScope(const OscPerfScope &) = delete;
+	OscPerfScope &operator =(const OscPerfScope &) = delete;
+
+private:
+	OscPerfPhase phase;
+	bool timing = false;
+	std::chrono::steady_clock::time_point start;
+	OscPerfScope *parent = nullptr;
+	uint64_t nestedNs = 0;
+	static thread_local OscPerfScope *innermost;
+};
@@ -0,0 +1,71 @@
+#include "record.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+static size_t padded(size_t size) {
+    return (size + 7) & ~size_t(7);
+}
+
+OscRecorder::OscRecorder(const std::string& path) : path(path), file(path, std::ios::binary | std::ios::trunc) {
+    if (!file) {
+        throw std::runtime_error("cannot create " + path);
+    }
+    OscLogHeader header{};
+    std::memcpy(header.magic, oscLogMagic, sizeof(oscLogMagic));
+    header.version = oscLogVersion;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void OscRecorder::Write(uint64_t frameNumber, uint64_t timetag, const char* data, size_t size) {
+    static const char padding[8] = {};
+    OscLogRecord record{};
+    record.size = uint32_t(size);
+    record.frameNumber = frameNumber;
+    record.timetag = timetag;
+    file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    file.write(data, size);
+    file.write(padding, padded(size) - size);
+}
+
+OscLogReader::OscLogReader(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("cannot open " + path);
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    OscLogHeader header;
+    if (data.size() < sizeof(header)) {
+        throw std::runtime_error(path + " is not an OSC recording");
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, oscLogMagic, sizeof(oscLogMagic)) != 0) {
+        throw std::runtime_error(path + " is not an OSC recording");
+    }
+    if (header.version != oscLogVersion) {
+        throw std::runtime_error(path + " has unsupported version " + std::to_string(header.version));
+    }
+    Rewind();
+}
+
+void OscLogReader::Rewind() {
+    position = sizeof(OscLogHeader);
+}
+
+bool OscLogReader::Next(OscLogEntry& entry) {
+    OscLogRecord record;
+    if (data.size() - position < sizeof(record)) {
+        return false;
+    }
+    std::memcpy(&record, data.data() + position, sizeof(record));
+    if (data.size() - position - sizeof(record) < record.size) {
+        return false;
+    }
+    entry.frameNumber = record.frameNumber;
+    entry.timetag = record.timetag;
+    entry.data = data.data() + position + sizeof(record);
+    entry.size = record.size;
+    position = std::min(data.size(), position + sizeof(record) + padded(record.size));
+    return true;
+}
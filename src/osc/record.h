@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Layout of an OSC recording. The file starts with an OscLogHeader and is followed by records,
+// each an OscLogRecord and then the packet exactly as it was sent, padded to 8 bytes so every
+// record header stays aligned when the file is mapped. Integers are in host byte order.
+constexpr char     oscLogMagic[8] = "TPTOSCL";
+constexpr uint32_t oscLogVersion  = 1;
+struct OscLogHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+};
+struct OscLogRecord
+{
+	uint32_t size; // of the packet, without padding
+	uint32_t reserved;
+	uint64_t frameNumber;
+	uint64_t timetag; // NTP, the same as the bundle's
+};
+
+class OscRecorder
+{
+public:
+	// throws std::runtime_error if the file cannot be created
+	OscRecorder(const std::string &path);
+
+	void Write(uint64_t frameNumber, uint64_t timetag, const char *data, size_t size);
+	const std::string &GetPath() const
+	{
+		return path;
+	}
+
+private:
+	std::string path;
+	std::ofstream file;
+};
+
+struct OscLogEntry
+{
+	uint64_t frameNumber;
+	uint64_t timetag;
+	const char *data;
+	size_t size;
+};
+
+// Reads a whole recording into memory and walks its records
+class OscLogReader
+{
+public:
+	// throws std::runtime_error if the file cannot be read or is not a recording
+	OscLogReader(const std::string &path);
+
+	// returns false at the end of the log or at a truncated record
+	bool Next(OscLogEntry &entry);
+	void Rewind();
+
+private:
+	std::vector<char> data;
+	size_t position;
+};
@@ -0,0 +1,176 @@
+#include "reducer.h"
+#include "simulation/ElementClasses.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+const std::array<const char*, NUM_REDUCE_OPS> oscReduceOpNames = {
+    "count", "sum", "mean", "min", "max", "sigma",
+};
+
+const std::array<const char*, NUM_COMPARE_OPS> oscCompareOpNames = {
+    "<", "<=", ">", ">=", "==", "~=",
+};
+
+// resolves aliases such as "life" the way tpt.set_property does
+static const StructProperty& findProperty(const std::string& name) {
+    auto resolved = ByteString(name);
+    for (auto& alias : Particle::GetPropertyAliases()) {
+        if (alias.from == resolved) {
+            resolved = alias.to;
+        }
+    }
+    auto& properties = Particle::GetProperties();
+    auto it = std::find_if(properties.begin(), properties.end(), [&resolved](const StructProperty& property) {
+        return property.Name == resolved;
+    });
+    if (it == properties.end()) {
+        throw std::runtime_error("unknown particle property: " + name);
+    }
+    switch (it->Type) {
+    case StructProperty::ParticleType:
+    case StructProperty::Integer:
+    case StructProperty::UInteger:
+    case StructProperty::Float:
+    case StructProperty::Colour:
+        return *it;
+    default:
+        throw std::runtime_error("particle property is not a number: " + name);
+    }
+}
+
+void OscReducers::Add(const OscReducerConfig& config) {
+    if (compiled.size() >= MAX_REDUCERS) {
+        throw std::runtime_error("too many reducers");
+    }
+    if (config.address.empty() || config.address[0] != '/' || config.address.size() >= REDUCER_ADDRESS_SIZE) {
+        throw std::runtime_error("reducer address must start with / and be shorter than " + std::to_string(REDUCER_ADDRESS_SIZE) + " characters");
+    }
+    for (auto& other : configs) {
+        if (other.address == config.address) {
+            throw std::runtime_error("there is already a reducer with address " + config.address);
+        }
+    }
+    if (config.fields.empty() || config.fields.size() > MAX_REDUCER_FIELDS) {
+        throw std::runtime_error("reducers need between 1 and " + std::to_string(MAX_REDUCER_FIELDS) + " fields");
+    }
+    if (config.predicates.size() > MAX_REDUCER_PREDICATES) {
+        throw std::runtime_error("reducers can have at most " + std::to_string(MAX_REDUCER_PREDICATES) + " predicates");
+    }
+
+    auto kindOf = [](const StructProperty& property) {
+        switch (property.Type) {
+        case StructProperty::Float:
+            return FloatValue;
+        case StructProperty::UInteger:
+        case StructProperty::Colour:
+            return UIntValue;
+        default:
+            return IntValue;
+        }
+    };
+
+    CompiledReducer reducer{};
+    if (config.types.empty()) {
+        reducer.typeMask.fill(true);
+        reducer.typeMask[PT_NONE] = false;
+    } else {
+        reducer.typeMask.fill(false);
+        for (auto type : config.types) {
+            if (type <= 0 || type >= PT_NUM) {
+                throw std::runtime_error("invalid element type " + std::to_string(type));
+            }
+            reducer.typeMask[type] = true;
+        }
+    }
+    reducer.x0 = config.x0;
+    reducer.y0 = config.y0;
+    reducer.x1 = config.x1;
+    reducer.y1 = config.y1;
+    reducer.predicateCount = int(config.predicates.size());
+    for (int i = 0; i < reducer.predicateCount; ++i) {
+        auto& predicate = config.predicates[i];
+        auto& property = findProperty(predicate.property);
+        reducer.predicates[i] = { property.Offset, kindOf(property), predicate.op, predicate.value };
+    }
+    reducer.fieldCount = int(config.fields.size());
+    for (int i = 0; i < reducer.fieldCount; ++i) {
+        auto& field = config.fields[i];
+        auto& compiledField = reducer.fields[i];
+        compiledField.op = field.op;
+        if (field.op != OscReduceCount) {
+            auto& property = findProperty(field.property);
+            compiledField.offset = property.Offset;
+            compiledField.kind = kindOf(property);
+        }
+    }
+    configs.push_back(config);
+    compiled.push_back(reducer);
+}
+
+void OscReducers::Clear() {
+    configs.clear();
+    compiled.clear();
+}
+
+void OscReducers::Merge(OscReducerTotals& into, OscReducerTotals& from) const {
+    for (size_t r = 0; r < compiled.size(); ++r) {
+        auto& total = into.reducers[r];
+        auto& partial = from.reducers[r];
+        if (!partial.matched) {
+            continue;
+        }
+        total.matched += partial.matched;
+        for (int i = 0; i < compiled[r].fieldCount; ++i) {
+            auto& field = total.fields[i];
+            auto& partialField = partial.fields[i];
+            field.sum += partialField.sum;
+            field.sumSquares += partialField.sumSquares;
+            field.min = std::min(field.min, partialField.min);
+            field.max = std::max(field.max, partialField.max);
+        }
+        partial = {};
+    }
+}
+
+int OscReducers::Collect(OscReducerTotals& totals, std::array<OscReducerFrame, MAX_REDUCERS>& frames) const {
+    for (size_t r = 0; r < compiled.size(); ++r) {
+        auto& reducer = compiled[r];
+        auto& total = totals.reducers[r];
+        auto& frame = frames[r];
+        std::strncpy(frame.address, configs[r].address.c_str(), REDUCER_ADDRESS_SIZE);
+        frame.fieldCount = reducer.fieldCount;
+        auto n = total.matched;
+        for (int i = 0; i < reducer.fieldCount; ++i) {
+            auto& field = total.fields[i];
+            float value = 0;
+            switch (reducer.fields[i].op) {
+            case OscReduceCount:
+                value = float(n);
+                break;
+            case OscReduceSum:
+                value = float(field.sum);
+                break;
+            case OscReduceMean:
+                value = n ? float(field.sum / n) : 0.0f;
+                break;
+            case OscReduceMin:
+                value = n ? field.min : 0.0f;
+                break;
+            case OscReduceMax:
+                value = n ? field.max : 0.0f;
+                break;
+            default:
+                if (n) {
+                    auto mean = field.sum / n;
+                    value = float(std::sqrt(std::max(field.sumSquares / n - mean * mean, 0.0)));
+                }
+                break;
+            }
+            frame.ops[i] = reducer.fields[i].op;
+            frame.values[i] = value;
+        }
+        total = {};
+    }
+    return int(compiled.size());
+}
@@ -0,0 +1,235 @@
+#pragma once
+#include "SimulationConfig.h"
+#include "simulation/ElementDefs.h"
+#include "simulation/Particle.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#define MAX_REDUCERS 16
+#define MAX_REDUCER_FIELDS 16
+#define MAX_REDUCER_PREDICATES 8
+#define REDUCER_ADDRESS_SIZE 32
+
+enum OscReduceOp
+{
+	OscReduceCount, // matching particles, takes no property
+	OscReduceSum,
+	OscReduceMean,
+	OscReduceMin,
+	OscReduceMax,
+	OscReduceSigma,
+	NUM_REDUCE_OPS
+};
+extern const std::array<const char *, NUM_REDUCE_OPS> oscReduceOpNames;
+
+enum OscCompareOp
+{
+	OscCompareLess,
+	OscCompareLessEqual,
+	OscCompareGreater,
+	OscCompareGreaterEqual,
+	OscCompareEqual,
+	OscCompareNotEqual,
+	NUM_COMPARE_OPS
+};
+extern const std::array<const char *, NUM_COMPARE_OPS> oscCompareOpNames; // Lua spelling, "~=" for not equal
+
+struct OscReducerPredicate
+{
+	std::string property;
+	OscCompareOp op = OscCompareGreater;
+	float value = 0;
+};
+
+struct OscReducerField
+{
+	OscReduceOp op = OscReduceCount;
+	std::string property; // ignored for count
+};
+
+// A user-defined analytics stream: particles that pass the filter are aggregated into one
+// OSC message per frame with one argument per field
+struct OscReducerConfig
+{
+	std::string address;
+	std::vector<int> types; // empty matches every element
+	int x0 = 0, y0 = 0, x1 = XRES, y1 = YRES; // region in pixels, x1 and y1 excluded
+	std::vector<OscReducerPredicate> predicates; // all must hold
+	std::vector<OscReducerField> fields;
+};
+
+// One reducer's results for one frame, count goes out as an int and everything else as a float
+struct OscReducerFrame
+{
+	char address[REDUCER_ADDRESS_SIZE];
+	int fieldCount;
+	std::array<OscReduceOp, MAX_REDUCER_FIELDS> ops;
+	std::array<float, MAX_REDUCER_FIELDS> values;
+};
+
+// What the reducers matched so far in a frame. The client keeps one for the frame, and each
+// tile of a tiled particle update fills its own, which Merge adds to the frame's.
+struct OscReducerTotals
+{
+	struct Field
+	{
+		double sum = 0, sumSquares = 0;
+		float min = std::numeric_limits<float>::max();
+		float max = std::numeric_limits<float>::lowest();
+	};
+	struct Reducer
+	{
+		int matched = 0;
+		std::array<Field, MAX_REDUCER_FIELDS> fields;
+	};
+	std::array<Reducer, MAX_REDUCERS> reducers;
+};
+
+// Runs user-defined reducers in the fused particle pass. Add compiles each config down to an
+// element mask, a region, and byte offsets into Particle for its predicates and fields, so
+// Accumulate is a handful of loads and compares per reducer with no strings or lookups. Only
+// the simulation thread changes the reducers, Accumulate may run on any thread that has its
+// own totals.
+class OscReducers
+{
+public:
+	// throws std::runtime_error for unknown properties, bad or duplicate addresses or too many
+	// of anything
+	void Add(const OscReducerConfig &config);
+	void Clear();
+	const std::vector<OscReducerConfig> &GetConfigs() const
+	{
+		return configs;
+	}
+	bool Any() const
+	{
+		return !compiled.empty();
+	}
+
+	void Accumulate(const Particle &p, OscReducerTotals &totals) const
+	{
+		auto *base = reinterpret_cast<const char *>(&p);
+		for (size_t r = 0; r < compiled.size(); ++r)
+		{
+			auto &reducer = compiled[r];
+			if (!reducer.typeMask[p.type])
+			{
+				continue;
+			}
+			auto x = int(p.x + 0.5f);
+			auto y = int(p.y + 0.5f);
+			if (x < reducer.x0 || x >= reducer.x1 || y < reducer.y0 || y >= reducer.y1)
+			{
+				continue;
+			}
+			bool pass = true;
+			for (int i = 0; i < reducer.predicateCount && pass; ++i)
+			{
+				auto &predicate = reducer.predicates[i];
+				auto value = read(base, predicate.offset, predicate.kind);
+				switch (predicate.op)
+				{
+				case OscCompareLess:         pass = value <  predicate.value; break;
+				case OscCompareLessEqual:    pass = value <= predicate.value; break;
+				case OscCompareGreater:      pass = value >  predicate.value; break;
+				case OscCompareGreaterEqual: pass = value >= predicate.value; break;
+				case OscCompareEqual:        pass = value == predicate.value; break;
+				default:                     pass = value != predicate.value; break;
+				}
+			}
+			if (!pass)
+			{
+				continue;
+			}
+			auto &total = totals.reducers[r];
+			total.matched += 1;
+			for (int i = 0; i < reducer.fieldCount; ++i)
+			{
+				auto &field = reducer.fields[i];
+				if (field.op == OscReduceCount)
+				{
+					continue;
+				}
+				auto value = read(base, field.offset, field.kind);
+				auto &fieldTotal = total.fields[i];
+				fieldTotal.sum += value;
+				fieldTotal.sumSquares += double(value) * value;
+				fieldTotal.min = std::min(fieldTotal.min, value);
+				fieldTotal.max = std::max(fieldTotal.max, value);
+			}
+		}
+	}
+
+	// adds from to into and clears from
+	void Merge(OscReducerTotals &into, OscReducerTotals &from) const;
+
+	// writes the results in totals into frames, returns how many there are, and clears totals
+	// for the next frame
+	int Collect(OscReducerTotals &totals, std::array<OscReducerFrame, MAX_REDUCERS> &frames) const;
+
+private:
+	enum ValueKind
+	{
+		FloatValue,
+		IntValue,
+		UIntValue,
+	};
+
+	static float read(const char *base, intptr_t offset, ValueKind kind)
+	{
+		switch (kind)
+		{
+		case FloatValue:
+		{
+			float value;
+			std::memcpy(&value, base + offset, sizeof(value));
+			return value;
+		}
+		case IntValue:
+		{
+			int value;
+			std::memcpy(&value, base + offset, sizeof(value));
+			return float(value);
+		}
+		default:
+		{
+			unsigned int value;
+			std::memcpy(&value, base + offset, sizeof(value));
+			return float(value);
+		}
+		}
+	}
+
+	struct CompiledPredicate
+	{
+		intptr_t offset;
+		ValueKind kind;
+		OscCompareOp op;
+		float value;
+	};
+
+	struct CompiledField
+	{
+		OscReduceOp op;
+		intptr_t offset;
+		ValueKind kind;
+	};
+
+	struct CompiledReducer
+	{
+		std::array<bool, PT_NUM> typeMask;
+		int x0, y0, x1, y1;
+		int predicateCount;
+		std::array<CompiledPredicate, MAX_REDUCER_PREDICATES> predicates;
+		int fieldCount;
+		std::array<CompiledField, MAX_REDUCER_FIELDS> fields;
+	};
+
+	std::vector<OscReducerConfig> configs;
+	std::vector<CompiledReducer> compiled;
+};
@@ -0,0 +1,178 @@
+#pragma once
+#include <atomic>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Single-producer/single-consumer handoff of large items that never copies them and never
+// blocks the producer. Each of the Capacity slots belongs to one side at a time: the producer
+// fills the slot it owns and publishes its index with one release store, and the consumer takes
+// the oldest published index and owns that slot until it hands it back. When the consumer falls
+// behind and no slot has been handed back, the producer takes back the oldest slot the consumer
+// has not picked up yet and counts it as dropped.
+template<class Item, size_t Capacity>
+class FrameRing
+{
+	// the producer's, the consumer's, the last published one, which the producer may still
+	// read, and one to spare
+	static_assert(Capacity >= 4);
+
+	std::array<Item, Capacity> slots;
+	// indices of published slots, oldest first; both sides take from the front
+	std::array<std::atomic<uint32_t>, Capacity> published;
+	alignas(64) std::atomic<uint64_t> publishedWrite = 0;
+	alignas(64) std::atomic<uint64_t> publishedRead = 0;
+	// indices of slots the consumer handed back
+	std::array<std::atomic<uint32_t>, Capacity> handedBack;
+	alignas(64) std::atomic<uint64_t> handedBackWrite = 0;
+	alignas(64) uint64_t handedBackRead = 0;
+	uint32_t writing = 0;
+	uint32_t last = Capacity - 1;
+	uint32_t reading = 0;
+	std::atomic<uint64_t> dropped = 0;
+
+	uint32_t TakeSlot()
+	{
+		while (true)
+		{
+			if (handedBackRead != handedBackWrite.load(std::memory_order_acquire))
+			{
+				return handedBack[handedBackRead++ % Capacity].load(std::memory_order_relaxed);
+			}
+			// there is always one of these if nothing was handed back, the consumer holds at
+			// most one slot; if it picks that one up first it is about to hand one back
+			auto front = publishedRead.load(std::memory_order_relaxed);
+			if (front != publishedWrite.load(std::memory_order_relaxed))
+			{
+				auto index = published[front % Capacity].load(std::memory_order_relaxed);
+				if (publishedRead.compare_exchange_strong(front, front + 1, std::memory_order_relaxed))
+				{
+					dropped.fetch_add(1, std::memory_order_relaxed);
+					return index;
+				}
+			}
+		}
+	}
+
+public:
+	// every slot starts out as a copy of initial; Last returns one of them until the first Publish
+	FrameRing(const Item &initial = Item())
+	{
+		slots.fill(initial);
+		for (uint32_t i = 1; i < Capacity; ++i)
+		{
+			handedBack[i - 1].store(i, std::memory_order_relaxed);
+		}
+		handedBackWrite.store(Capacity - 1, std::memory_order_relaxed);
+	}
+
+	// producer side, the slot to fill, which stays the producer's until Publish
+	Item &Writable()
+	{
+		return slots[writing];
+	}
+
+	// producer side, hands the slot returned by Writable to the consumer and takes another one
+	void Publish()
+	{
+		auto back = publishedWrite.load(std::memory_order_relaxed);
+		published[back % Capacity].store(writing, std::memory_order_relaxed);
+		publishedWrite.store(back + 1, std::memory_order_release);
+		last = writing;
+		writing = TakeSlot();
+	}
+
+	// producer side, the item most recently published. The consumer only reads it, and the
+	// producer does not take it back before the next Publish, so it stays whole until then.
+	const Item &Last() const
+	{
+		return slots[last];
+	}
+
+	// consumer side, the oldest published item, which stays the consumer's until Release, or
+	// nullptr if there is nothing to read
+	const Item *Acquire()
+	{
+		auto front = publishedRead.load(std::memory_order_relaxed);
+		while (front != publishedWrite.load(std::memory_order_acquire))
+		{
+			auto index = published[front % Capacity].load(std::memory_order_relaxed);
+			// fails if the producer took it back, front is then the new front
+			if (publishedRead.compare_exchange_weak(front, front + 1, std::memory_order_relaxed))
+			{
+				reading = index;
+				return &slots[index];
+			}
+		}
+		return nullptr;
+	}
+
+	// consumer side, hands the item returned by Acquire back to the producer
+	void Release()
+	{
+		auto back = handedBackWrite.load(std::memory_order_relaxed);
+		handedBack[back % Capacity].store(reading, std::memory_order_relaxed);
+		handedBackWrite.store(back + 1, std::memory_order_release);
+	}
+
+	uint64_t Published() const
+	{
+		return publishedWrite.load(std::memory_order_acquire);
+	}
+
+	uint64_t Dropped() const
+	{
+		return dropped.load(std::memory_order_relaxed);
+	}
+};
+
+// Bounded single-producer/single-consumer FIFO. Unlike FrameRing every item matters, so a full
+// queue rejects new items instead of overwriting old ones; the producer counts those as dropped.
+template<class Item, size_t Capacity>
+class CommandQueue
+{
+	static_assert(Capacity > 0);
+
+	std::array<Item, Capacity> items;
+	alignas(64) std::atomic<uint64_t> writeIndex = 0;
+	alignas(64) std::atomic<uint64_t> readIndex = 0;
+	std::atomic<uint64_t> dropped = 0;
+
+public:
+	// producer side, returns false if the queue is full
+	bool TryPush(const Item &item)
+	{
+		auto index = writeIndex.load(std::memory_order_relaxed);
+		if (index - readIndex.load(std::memory_order_acquire) >= Capacity)
+		{
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		items[index % Capacity] = item;
+		writeIndex.store(index + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer side, returns false if there is nothing to read
+	bool Pop(Item &item)
+	{
+		auto index = readIndex.load(std::memory_order_relaxed);
+		if (index == writeIndex.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		item = items[index % Capacity];
+		readIndex.store(index + 1, std::memory_order_release);
+		return true;
+	}
+
+	uint64_t Pushed() const
+	{
+		return writeIndex.load(std::memory_order_acquire);
+	}
+
+	uint64_t Dropped() const
+	{
+		return dropped.load(std::memory_order_relaxed);
+	}
+};
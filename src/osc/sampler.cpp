@@ -0,0 +1,64 @@
+#include "sampler.h"
+#include "SimulationConfig.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+constexpr int calibrationUpdates = 4096;
+
+static uint64_t splitmix64(uint64_t x) {
+    x += UINT64_C(0x9E3779B97F4A7C15);
+    x = (x ^ (x >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    x = (x ^ (x >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return x ^ (x >> 31);
+}
+
+HandlerSampler::HandlerSampler() {
+    offsets.fill(0);
+    seenBySlot.fill(0);
+
+    MasterHandler handler;
+    Particle p{};
+    p.type = 1;
+    p.vx = 1;
+    p.vy = 1;
+    p.temp = 295.15f;
+    handler.update(&p); // the first update looks up element properties, keep it out of the timing
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < calibrationUpdates; i++) {
+        p.x = float(i % XRES);
+        p.y = float(i % YRES);
+        handler.update(&p);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    updateNs = std::max(1.0, std::chrono::duration<double, std::nano>(elapsed).count() / calibrationUpdates);
+}
+
+void HandlerSampler::SetConfig(const OscSamplingConfig& newConfig) {
+    config = newConfig;
+    config.budgetMs = std::max(config.budgetMs, 0.001f);
+    config.minPerType = std::max(config.minPerType, 1);
+    stride = 1;
+}
+
+void HandlerSampler::BeginFrame(uint64_t seed, int population) {
+    seenBySlot.fill(0);
+    if (!config.enabled) {
+        stride = 1;
+        return;
+    }
+    auto budgetUpdates = std::max(1.0, config.budgetMs * 1e6 / updateNs);
+    stride = std::max(1, int(std::ceil(population / budgetUpdates)));
+    for (int i = 0; i < HANDLERS; i++) {
+        offsets[i] = int(splitmix64(seed + i) % uint64_t(stride));
+    }
+}
+
+double MeanConfidence(double sigma, int sampleCount, int populationCount) {
+    if (sampleCount <= 0 || sampleCount >= populationCount) {
+        return 0;
+    }
+    // finite population correction, the sample is drawn without replacement
+    auto correction = std::sqrt(double(populationCount - sampleCount) / (populationCount - 1));
+    return 1.96 * sigma / std::sqrt(double(sampleCount)) * correction;
+}
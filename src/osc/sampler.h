@@ -0,0 +1,62 @@
+#pragma once
+#include "handler.h"
+#include <array>
+#include <cstdint>
+
+struct OscSamplingConfig
+{
+	bool enabled = false;
+	float budgetMs = 0.25f; // time per frame the handlers may spend on particles
+	int minPerType = 64;    // always take this many particles of each handler's type
+};
+
+// Decides which particles are fed to the handlers when there are too many to look at all of
+// them. Each handler's particles form a stratum sampled systematically: the first minPerType
+// are always taken, after that every stride-th one from a random offset. The stride is chosen
+// at the end of each frame from the number of particles the handlers saw and the calibrated
+// cost of one handler update, and the offsets come from a seed derived from the simulation's
+// RNG state, so a given save and frame always sample the same particles.
+class HandlerSampler
+{
+public:
+	HandlerSampler();
+
+	void SetConfig(const OscSamplingConfig &newConfig);
+	const OscSamplingConfig &GetConfig() const
+	{
+		return config;
+	}
+	bool Enabled() const
+	{
+		return config.enabled;
+	}
+
+	bool Take(int slot)
+	{
+		return Take(slot, seenBySlot[slot]++);
+	}
+	// for a tile of a tiled particle update, which counts the particles it has seen itself, so
+	// each tile takes the first minPerType of each handler's type
+	bool Take(int slot, int seen) const
+	{
+		return seen < config.minPerType || (seen + offsets[slot]) % stride == 0;
+	}
+
+	// population is how many particles the handlers are expected to see next frame
+	void BeginFrame(uint64_t seed, int population);
+	int GetStride() const
+	{
+		return stride;
+	}
+
+private:
+	OscSamplingConfig config;
+	double updateNs; // measured cost of one MasterHandler::update
+	int stride = 1;
+	std::array<int, HANDLERS> offsets;
+	std::array<int, HANDLERS> seenBySlot;
+};
+
+// Half-width of the 95% confidence interval of a mean estimated from sampleCount of
+// populationCount values with the given standard deviation, 0 if every value was seen
+double MeanConfidence(double sigma, int sampleCount, int populationCount);
@@ -0,0 +1,163 @@
+#include "sender.h"
+#include "osc.h"
+#include <chrono>
+#include <cstdio>
+
+#ifdef WINDOWS
+    #include <winsock2.h>
+    #pragma comment(lib, "WS2_32.lib")
+    #include "Ws2tcpip.h"
+#endif
+
+static uint64_t steadyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static OscFrame emptyFrame() {
+    OscFrame frame{};
+    frame.voiceTypes.fill(-1);
+    return frame;
+}
+
+OscSender::OscSender() : ring(emptyFrame()) {
+    // MAKEWORD(1,1) for Winsock 1.1, MAKEWORD(2,0) for Winsock 2.0
+    #ifdef WINDOWS
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(1, 1), &wsaData) != 0) {
+        fprintf(stderr, "WSAStartup failed.\n");
+    }
+    #endif
+
+    SetTargets({ "udp://127.0.0.1:9000" });
+
+    thr = std::thread([this]() {
+        Run();
+    });
+}
+
+OscSender::~OscSender() {
+    shouldStop.store(true, std::memory_order_release);
+    wakeups.fetch_add(1, std::memory_order_release);
+    wakeups.notify_one();
+    thr.join();
+    targets.clear();
+
+    #ifdef WINDOWS
+    WSACleanup();
+    #endif
+}
+
+void OscSender::Publish() {
+    ring.Publish();
+    wakeups.fetch_add(1, std::memory_order_release);
+    wakeups.notify_one();
+}
+
+OscSenderStats OscSender::GetStats() const {
+    return {
+        ring.Published(),
+        sent.load(std::memory_order_relaxed),
+        ring.Dropped(),
+        late.load(std::memory_order_relaxed),
+    };
+}
+
+std::vector<OscTargetStats> OscSender::GetTargetStats() const {
+    std::lock_guard lk(targetsMx);
+    std::vector<OscTargetStats> stats;
+    for (auto& target : targets) {
+        stats.push_back({ target->uri, target->sent, target->failed, target->rateLimited });
+    }
+    return stats;
+}
+
+void OscSender::SetTargets(const std::vector<std::string>& uris) {
+    std::vector<std::unique_ptr<OscTarget>> newTargets;
+    for (auto& uri : uris) {
+        newTargets.push_back(OpenOscTarget(uri));
+    }
+    std::lock_guard lk(targetsMx);
+    std::swap(targets, newTargets);
+}
+
+std::vector<std::string> OscSender::GetTargets() const {
+    std::lock_guard lk(targetsMx);
+    std::vector<std::string> uris;
+    for (auto& target : targets) {
+        uris.push_back(target->uri);
+    }
+    return uris;
+}
+
+void OscSender::SetRecording(const std::string& path) {
+    std::unique_ptr<OscRecorder> newRecorder;
+    if (!path.empty()) {
+        newRecorder = std::make_unique<OscRecorder>(path);
+    }
+    std::lock_guard lk(targetsMx);
+    std::swap(recorder, newRecorder);
+}
+
+std::string OscSender::GetRecording() const {
+    std::lock_guard lk(targetsMx);
+    return recorder ? recorder->GetPath() : std::string();
+}
+
+void OscSender::SetDeltaConfig(const OscDeltaConfig& config) {
+    std::lock_guard lk(targetsMx);
+    delta.SetConfig(config);
+}
+
+OscDeltaConfig OscSender::GetDeltaConfig() const {
+    std::lock_guard lk(targetsMx);
+    return delta.GetConfig();
+}
+
+void OscSender::SetLateThreshold(uint64_t ns) {
+    lateThresholdNs.store(ns, std::memory_order_relaxed);
+}
+
+void OscSender::Run() {
+    while (true) {
+        auto seen = wakeups.load(std::memory_order_acquire);
+        while (auto* frame = ring.Acquire()) {
+            if (steadyNowNs() - frame->publishNs > lateThresholdNs.load(std::memory_order_relaxed)) {
+                late.fetch_add(1, std::memory_order_relaxed);
+            }
+            Send(*frame);
+            ring.Release();
+            sent.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (shouldStop.load(std::memory_order_acquire)) {
+            break;
+        }
+        wakeups.wait(seen, std::memory_order_acquire);
+    }
+}
+
+void OscSender::Send(const OscFrame& frame) {
+    auto nowNs = steadyNowNs();
+    // only the network thread and configuration changes take this, never the simulation thread
+    std::lock_guard lk(targetsMx);
+    size_t packetSize;
+    if (delta.GetConfig().enabled) {
+        packetSize = delta.Encode(sendBuffer.data(), sendBuffer.size(), frame);
+        if (!packetSize) {
+            return;
+        }
+    } else {
+        packetSize = makeFramePacket(sendBuffer.data(), sendBuffer.size(), frame);
+    }
+    if (recorder) {
+        recorder->Write(frame.frameNumber, frame.timetag, sendBuffer.data(), packetSize);
+    }
+    for (auto& target : targets) {
+        if (!target->Admit(nowNs)) {
+            target->rateLimited++;
+        } else if (target->transport->Send(sendBuffer.data(), packetSize)) {
+            target->sent++;
+        } else {
+            target->failed++;
+        }
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include "delta.h"
+#include "events.h"
+#include "grid.h"
+#include "handler.h"
+#include "onset.h"
+#include "perf.h"
+#include "record.h"
+#include "reducer.h"
+#include "spectrum.h"
+#include "voice.h"
+#include "ring.h"
+#include "transport.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define kMaxPacketSize 16384
+#define FRAME_RING_SIZE 8
+
+// Everything the network thread needs to encode one simulation frame
+struct OscFrame {
+    uint64_t frameNumber;
+    uint64_t publishNs; // steady clock, used for late frame accounting
+    uint64_t timetag; // NTP, see timetag.h
+    std::array<MasterReturnParams, HANDLERS> handlers;
+    std::array<int, HANDLERS> voiceTypes; // element each handler was fed, -1 for free voices
+    VoiceEvents voiceEvents; // voice changes that take effect with this frame's handlers
+    int eventCount;
+    std::array<EventHistogramFrame, MAX_EVENT_HISTOGRAMS> events;
+    OscGrid grid; // width 0 if the spatial map is off
+    int reducerCount;
+    std::array<OscReducerFrame, MAX_REDUCERS> reducers;
+    int onsetCount;
+    std::array<OscOnset, MAX_ONSETS> onsets;
+    OscSpectrumFeatures spectrum; // not valid if off; lags the frame while the worker catches up
+    OscPerfReport perf; // valid about once a second if on
+};
+
+struct OscSenderStats {
+    uint64_t published;
+    uint64_t sent;
+    uint64_t dropped;
+    uint64_t late;
+};
+
+struct OscTargetStats {
+    std::string uri;
+    uint64_t sent;
+    uint64_t failed;
+    uint64_t rateLimited;
+};
+
+// Owns the transports and a network thread that encodes and sends frames published by the
+// simulation thread, so the simulation thread never blocks in sendto
+class OscSender {
+public:
+    OscSender();
+    ~OscSender();
+    // The frame the simulation thread fills next. It is the simulation thread's until Publish
+    // hands it to the network thread, which then owns it until it has been sent.
+    OscFrame& Writable() {
+        return ring.Writable();
+    }
+    void Publish(); // simulation thread only
+    // The frame most recently published, which stays whole for the simulation thread until
+    // the next Publish; the network thread only reads it
+    const OscFrame& LastPublished() const {
+        return ring.Last();
+    }
+    OscSenderStats GetStats() const;
+    std::vector<OscTargetStats> GetTargetStats() const;
+    void SetLateThreshold(uint64_t ns);
+
+    // replaces all targets, see transport.h for the URI format; throws std::runtime_error
+    // and keeps the current targets if any of them cannot be opened
+    void SetTargets(const std::vector<std::string>& uris);
+    std::vector<std::string> GetTargets() const;
+
+    // appends every packet sent from now on to a recording, see record.h; an empty path stops
+    // recording. throws std::runtime_error and keeps recording to the current file, if any,
+    // if the file cannot be created
+    void SetRecording(const std::string& path);
+    std::string GetRecording() const;
+
+    void SetDeltaConfig(const OscDeltaConfig& config); // see delta.h
+    OscDeltaConfig GetDeltaConfig() const;
+
+private:
+    void Run();
+    void Send(const OscFrame& frame);
+
+    mutable std::mutex targetsMx;
+    std::vector<std::unique_ptr<OscTarget>> targets;
+    std::unique_ptr<OscRecorder> recorder;
+    OscDeltaEncoder delta;
+    std::array<char, kMaxPacketSize> sendBuffer;
+
+    FrameRing<OscFrame, FRAME_RING_SIZE> ring;
+    std::thread thr;
+    std::atomic<uint32_t> wakeups = 0;
+    std::atomic<bool> shouldStop = false;
+    std::atomic<uint64_t> sent = 0;
+    std::atomic<uint64_t> late = 0;
+    std::atomic<uint64_t> lateThresholdNs = 50000000; // 50ms, a few frames at 60fps
+};
@@ -0,0 +1,58 @@
+#pragma once
+#include "SimulationConfig.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#define SPECTRUM_BANDS 8
+
+enum OscSpectrumSource
+{
+	OscSpectrumOff,
+	OscSpectrumDensity,  // particles per cell
+	OscSpectrumPressure, // pv
+	NUM_SPECTRUM_SOURCES
+};
+extern const std::array<const char *, NUM_SPECTRUM_SOURCES> oscSpectrumSourceNames;
+
+// Features of the 2D power spectrum of one frame's cell map. Spatial frequencies are given as
+// a fraction of the Nyquist frequency of the cell map along an axis, so diagonal detail goes
+// up to 1.41.
+struct OscSpectrumFeatures
+{
+	bool valid = false;       // false until the first analysis finishes
+	uint64_t frameNumber = 0; // frame the input was taken from
+	float power = 0;          // mean squared deviation of the map from its mean
+	float centroid = 0;       // power-weighted mean frequency
+	// direction of the dominant stripes, radians in [0, pi) counterclockwise from +x, y up
+	float orientation = 0;
+	float coherence = 0;      // 0 if power is spread over all directions, 1 if it all lies along one
+	// share of power per octave, the last band ends at Nyquist and holds the corners
+	std::array<float, SPECTRUM_BANDS> bands = {};
+};
+
+using OscSpectrumInput = std::vector<float>; // NCELL entries, row-major like pv
+
+class OscSpectrum;
+struct OscSpectrumDeleter
+{
+	void operator ()(OscSpectrum *ptr) const;
+};
+using OscSpectrumPtr = std::unique_ptr<OscSpectrum, OscSpectrumDeleter>;
+
+// Runs the FFT on a worker thread. Builds without FFTW get an implementation that never
+// produces features.
+class OscSpectrum
+{
+protected:
+	OscSpectrum() = default;
+
+public:
+	// Simulation thread only. If the worker is idle, swaps input with its buffer and starts an
+	// analysis; otherwise the frame is skipped and input is left alone. Either way features
+	// gets the newest finished analysis, so this never waits for the worker.
+	void Exchange(OscSpectrumInput &input, uint64_t frameNumber, OscSpectrumFeatures &features);
+
+	static OscSpectrumPtr Create();
+};
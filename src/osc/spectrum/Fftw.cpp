@@ -0,0 +1,227 @@
+#include "osc/spectrum.h"
+#include "Config.h"
+#include "common/tpt-compat.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <condition_variable>
+#include <fftw3.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// https://www.fftw.org/fftw3_doc/Multi_002dDimensional-DFTs-of-Real-Data.html#Multi_002dDimensional-DFTs-of-Real-Data
+constexpr auto transWidth = XCELLS / 2 + 1;
+constexpr auto transSize = transWidth * YCELLS;
+
+namespace
+{
+	static_assert(sizeof(std::complex<float>) == sizeof(fftwf_complex));
+	struct FftwArrayDeleter        { void operator ()(float               ptr[]) const { fftwf_free(ptr);         } };
+	struct FftwComplexArrayDeleter { void operator ()(std::complex<float> ptr[]) const { fftwf_free(ptr);         } };
+	struct FftwPlanDeleter         { void operator ()(fftwf_plan          ptr  ) const { fftwf_destroy_plan(ptr); } };
+	using  FftwArrayPtr        = std::unique_ptr<float                              [], FftwArrayDeleter       >;
+	using  FftwComplexArrayPtr = std::unique_ptr<std::complex<float>                [], FftwComplexArrayDeleter>;
+	using  FftwPlanPtr         = std::unique_ptr<std::remove_pointer<fftwf_plan>::type, FftwPlanDeleter        >;
+
+	// everything about a frequency bin that does not depend on the input
+	struct Bin
+	{
+		float weight;    // 2 for bins that stand for their mirror image too, 0 for DC
+		float frequency; // fraction of Nyquist
+		float cos2, sin2; // of twice the angle of the frequency vector
+		int band;
+	};
+}
+
+struct OscSpectrumImpl : public OscSpectrum
+{
+	FftwArrayPtr windowed;
+	FftwComplexArrayPtr transformed;
+	FftwPlanPtr forward;
+	std::array<float, XCELLS> windowX;
+	std::array<float, YCELLS> windowY;
+	std::vector<Bin> bins;
+	bool initDone = false;
+
+	std::thread thr;
+	bool working = false;
+	bool shouldStop = false;
+	std::mutex stateMx;
+	std::condition_variable stateCv;
+
+	// owned by the worker while working is set
+	OscSpectrumInput input = OscSpectrumInput(NCELL);
+	uint64_t inputFrame = 0;
+	OscSpectrumFeatures result;
+	// simulation thread only
+	OscSpectrumFeatures latest;
+
+	~OscSpectrumImpl();
+
+	void Init();
+	void Work();
+};
+
+OscSpectrumImpl::~OscSpectrumImpl()
+{
+	if (initDone)
+	{
+		{
+			std::unique_lock lk(stateMx);
+			shouldStop = true;
+		}
+		stateCv.notify_one();
+		thr.join();
+	}
+}
+
+void OscSpectrumImpl::Init()
+{
+	auto fftwPlanFlags = FFTW_PLAN_MEASURE ? FFTW_MEASURE : FFTW_ESTIMATE;
+	windowed = FftwArrayPtr(reinterpret_cast<float *>(fftwf_malloc(NCELL * sizeof(float))));
+	transformed = FftwComplexArrayPtr(reinterpret_cast<std::complex<float> *>(fftwf_malloc(transSize * sizeof(std::complex<float>))));
+	// planning with FFTW_MEASURE clobbers the arrays, which hold nothing yet
+	forward = FftwPlanPtr(fftwf_plan_dft_r2c_2d(YCELLS, XCELLS, windowed.get(), reinterpret_cast<fftwf_complex *>(transformed.get()), fftwPlanFlags));
+
+	// Hann windows, so the walls of the simulation don't show up as a cross of high frequencies
+	for (int x = 0; x < XCELLS; ++x)
+	{
+		windowX[x] = 0.5f - 0.5f * std::cos(2 * TPT_PI_FLT * x / (XCELLS - 1));
+	}
+	for (int y = 0; y < YCELLS; ++y)
+	{
+		windowY[y] = 0.5f - 0.5f * std::cos(2 * TPT_PI_FLT * y / (YCELLS - 1));
+	}
+
+	bins.resize(transSize);
+	for (int ky = 0; ky < YCELLS; ++ky)
+	{
+		for (int kx = 0; kx < transWidth; ++kx)
+		{
+			auto &bin = bins[ky * transWidth + kx];
+			// in cycles per cell, y flipped so it points up
+			auto fx = float(kx) / XCELLS;
+			auto fy = -float(ky <= YCELLS / 2 ? ky : ky - YCELLS) / YCELLS;
+			auto r2 = fx * fx + fy * fy;
+			// the r2c transform leaves out the negative x frequencies, which mirror the ones kept
+			auto mirrored = kx > 0 && !(XCELLS % 2 == 0 && kx == XCELLS / 2);
+			bin.weight = (kx == 0 && ky == 0) ? 0.f : (mirrored ? 2.f : 1.f);
+			bin.frequency = std::sqrt(r2) / 0.5f;
+			bin.cos2 = r2 > 0 ? (fx * fx - fy * fy) / r2 : 0.f;
+			bin.sin2 = r2 > 0 ? 2 * fx * fy / r2 : 0.f;
+			auto octave = bin.frequency > 0 ? int(std::floor(std::log2(bin.frequency))) : -SPECTRUM_BANDS;
+			bin.band = std::clamp(SPECTRUM_BANDS - 1 + octave, 0, SPECTRUM_BANDS - 1);
+		}
+	}
+
+	thr = std::thread([this]() {
+		while (true)
+		{
+			{
+				std::unique_lock lk(stateMx);
+				stateCv.wait(lk, [this]() {
+					return working || shouldStop;
+				});
+				if (shouldStop)
+				{
+					break;
+				}
+			}
+			Work();
+			{
+				std::unique_lock lk(stateMx);
+				working = false;
+			}
+		}
+	});
+}
+
+void OscSpectrumImpl::Work()
+{
+	float mean = 0;
+	for (auto value : input)
+	{
+		mean += value;
+	}
+	mean /= NCELL;
+	for (int y = 0; y < YCELLS; ++y)
+	{
+		auto *in = &input[y * XCELLS];
+		auto *out = &windowed[y * XCELLS];
+		for (int x = 0; x < XCELLS; ++x)
+		{
+			out[x] = (in[x] - mean) * windowX[x] * windowY[y];
+		}
+	}
+	fftwf_execute(forward.get());
+
+	float total = 0, centroid = 0, orientX = 0, orientY = 0;
+	std::array<float, SPECTRUM_BANDS> bands = {};
+	for (int i = 0; i < transSize; ++i)
+	{
+		auto &bin = bins[i];
+		auto power = std::norm(transformed[i]) * bin.weight;
+		total += power;
+		centroid += power * bin.frequency;
+		orientX += power * bin.cos2;
+		orientY += power * bin.sin2;
+		bands[bin.band] += power;
+	}
+
+	result.valid = true;
+	result.frameNumber = inputFrame;
+	// Parseval, FFTW's transform is unnormalised
+	result.power = total / (float(NCELL) * NCELL);
+	result.centroid = total > 0 ? centroid / total : 0.f;
+	result.coherence = total > 0 ? std::hypot(orientX, orientY) / total : 0.f;
+	// stripes run perpendicular to the frequency vector
+	auto orientation = std::atan2(orientY, orientX) / 2 + TPT_PI_FLT / 2;
+	result.orientation = orientation >= TPT_PI_FLT ? orientation - TPT_PI_FLT : orientation;
+	for (int band = 0; band < SPECTRUM_BANDS; ++band)
+	{
+		result.bands[band] = total > 0 ? bands[band] / total : 0.f;
+	}
+}
+
+void OscSpectrum::Exchange(OscSpectrumInput &input, uint64_t frameNumber, OscSpectrumFeatures &features)
+{
+	auto *fftSpectrum = static_cast<OscSpectrumImpl *>(this);
+
+	// lazy init, planning for a map this size is quick
+	if (!fftSpectrum->initDone)
+	{
+		fftSpectrum->Init();
+		fftSpectrum->initDone = true;
+	}
+
+	{
+		// the worker only holds the lock to flip working, so this does not wait on an analysis
+		std::unique_lock lk(fftSpectrum->stateMx);
+		if (!fftSpectrum->working)
+		{
+			// take output
+			if (fftSpectrum->result.valid)
+			{
+				fftSpectrum->latest = fftSpectrum->result;
+			}
+			// pass input, a pointer swap
+			std::swap(input, fftSpectrum->input);
+			fftSpectrum->inputFrame = frameNumber;
+			fftSpectrum->working = true;
+			lk.unlock();
+			fftSpectrum->stateCv.notify_one();
+		}
+	}
+	features = fftSpectrum->latest;
+}
+
+OscSpectrumPtr OscSpectrum::Create()
+{
+	return OscSpectrumPtr(new OscSpectrumImpl());
+}
+
+void OscSpectrumDeleter::operator ()(OscSpectrum *ptr) const
+{
+	delete static_cast<OscSpectrumImpl *>(ptr);
+}
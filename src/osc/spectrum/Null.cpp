@@ -0,0 +1,15 @@
+#include "osc/spectrum.h"
+
+void OscSpectrum::Exchange(OscSpectrumInput &input, uint64_t frameNumber, OscSpectrumFeatures &features)
+{
+}
+
+OscSpectrumPtr OscSpectrum::Create()
+{
+	return OscSpectrumPtr(new OscSpectrum());
+}
+
+void OscSpectrumDeleter::operator ()(OscSpectrum *ptr) const
+{
+	delete ptr;
+}
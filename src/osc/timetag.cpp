@@ -0,0 +1,40 @@
+#include "timetag.h"
+#include <chrono>
+#include <cstdlib>
+
+// seconds between the NTP epoch (1900) and the unix epoch (1970)
+constexpr uint64_t ntpUnixOffset = UINT64_C(2208988800);
+// re-anchor the frame clock if it drifts this far from the wall clock
+constexpr int64_t maxDriftNs = 100'000'000;
+
+// only touched by the simulation thread
+static bool anchored = false;
+static uint64_t anchorFrameNs = 0;
+static int64_t anchorWallNs = 0;
+static uint64_t currentFrameNs = 0;
+
+static int64_t wallNowNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void SetOscFrameTime(uint64_t frameNs)
+{
+	auto nowNs = wallNowNs();
+	if (!anchored || std::llabs(anchorWallNs + int64_t(frameNs - anchorFrameNs) - nowNs) > maxDriftNs)
+	{
+		anchored = true;
+		anchorFrameNs = frameNs;
+		anchorWallNs = nowNs;
+	}
+	currentFrameNs = frameNs;
+}
+
+uint64_t OscFrameTimetag(int64_t offsetNs)
+{
+	auto wallNs = anchored ? anchorWallNs + int64_t(currentFrameNs - anchorFrameNs) : wallNowNs();
+	wallNs += offsetNs;
+	auto seconds = uint64_t(wallNs / 1'000'000'000) + ntpUnixOffset;
+	auto fraction = (uint64_t(wallNs % 1'000'000'000) << 32) / UINT64_C(1'000'000'000);
+	return (seconds << 32) | fraction;
+}
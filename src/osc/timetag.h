@@ -0,0 +1,11 @@
+#pragma once
+#include <cstdint>
+
+// Nominal start time of the simulation tick about to run, on the main loop's FrameSchedule
+// clock. Bundle timetags are derived from this so they advance with simulated frames rather
+// than with whenever the network thread gets around to sending them.
+void SetOscFrameTime(uint64_t frameNs);
+
+// NTP 32.32 timetag of the current frame, offsetNs later. Falls back to the wall clock if
+// SetOscFrameTime was never called.
+uint64_t OscFrameTimetag(int64_t offsetNs);
@@ -0,0 +1,237 @@
+#include "transport.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#ifdef WINDOWS
+    #include <winsock2.h>
+    #include "Ws2tcpip.h"
+#else
+    #include <sys/socket.h>
+    #include <sys/types.h>
+    #include <sys/un.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <netinet/in.h>
+    #include <netdb.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+constexpr uint32_t defaultShmSize = 1 << 20;
+
+static void setNonBlocking(int sock) {
+    #ifdef WINDOWS
+    u_long mode = 1;
+    ioctlsocket(sock, FIONBIO, &mode);
+    #else
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+    #endif
+}
+
+static void closeSocket(int sock) {
+    #ifdef WINDOWS
+    ::closesocket(sock);
+    #else
+    close(sock);
+    #endif
+}
+
+class UdpTransport : public OscTransport {
+    int sock = -1;
+    sockaddr_storage destination;
+    socklen_t destinationSize;
+
+public:
+    UdpTransport(const std::string& host, const std::string& port) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+        addrinfo* result = nullptr;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0 || !result) {
+            throw std::runtime_error("cannot resolve " + host + ":" + port);
+        }
+        std::memcpy(&destination, result->ai_addr, result->ai_addrlen);
+        destinationSize = socklen_t(result->ai_addrlen);
+        sock = int(::socket(result->ai_family, SOCK_DGRAM, 0));
+        freeaddrinfo(result);
+        if (sock < 0) {
+            throw std::runtime_error("cannot create UDP socket");
+        }
+        setNonBlocking(sock);
+    }
+
+    ~UdpTransport() {
+        closeSocket(sock);
+    }
+
+    bool Send(const char* data, size_t size) override {
+        return ::sendto(sock, data, size, 0, reinterpret_cast<sockaddr*>(&destination), destinationSize) == int(size);
+    }
+};
+
+#ifndef WINDOWS
+class UnixTransport : public OscTransport {
+    int sock = -1;
+    sockaddr_un destination{};
+
+public:
+    UnixTransport(const std::string& path) {
+        if (path.size() >= sizeof(destination.sun_path)) {
+            throw std::runtime_error("socket path too long: " + path);
+        }
+        destination.sun_family = AF_UNIX;
+        std::strcpy(destination.sun_path, path.c_str());
+        sock = ::socket(AF_UNIX, SOCK_DGRAM, 0);
+        if (sock < 0) {
+            throw std::runtime_error("cannot create unix socket");
+        }
+        setNonBlocking(sock);
+    }
+
+    ~UnixTransport() {
+        closeSocket(sock);
+    }
+
+    bool Send(const char* data, size_t size) override {
+        // a consumer that is not running or not keeping up makes this fail with ENOENT or EAGAIN, never block
+        return ::sendto(sock, data, size, 0, reinterpret_cast<sockaddr*>(&destination), sizeof(destination)) == ssize_t(size);
+    }
+};
+
+class ShmTransport : public OscTransport {
+    OscShmHeader* header = nullptr;
+    char* data = nullptr;
+    size_t mappingSize = 0;
+
+public:
+    ShmTransport(const std::string& path, uint32_t capacity) {
+        capacity = std::max<uint32_t>(capacity & ~3U, 4096);
+        mappingSize = sizeof(OscShmHeader) + capacity;
+        int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("cannot open " + path);
+        }
+        if (ftruncate(fd, off_t(mappingSize)) != 0) {
+            close(fd);
+            throw std::runtime_error("cannot resize " + path);
+        }
+        auto* mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("cannot map " + path);
+        }
+        header = new(mapping) OscShmHeader;
+        std::memcpy(header->magic, shmMagic, sizeof(shmMagic));
+        header->version = shmVersion;
+        header->capacity = capacity;
+        header->writePosition.store(0, std::memory_order_release);
+        data = reinterpret_cast<char*>(mapping) + sizeof(OscShmHeader);
+    }
+
+    ~ShmTransport() {
+        munmap(header, mappingSize);
+    }
+
+    bool Send(const char* packet, size_t size) override {
+        auto capacity = header->capacity;
+        auto recordSize = sizeof(uint32_t) + ((size + 3) & ~size_t(3));
+        if (recordSize > capacity) {
+            return false;
+        }
+        auto position = header->writePosition.load(std::memory_order_relaxed);
+        auto offset = uint32_t(position % capacity);
+        if (capacity - offset < recordSize) {
+            std::memcpy(data + offset, &shmWrapMarker, sizeof(shmWrapMarker));
+            position += capacity - offset;
+            offset = 0;
+        }
+        auto size32 = uint32_t(size);
+        std::memcpy(data + offset, &size32, sizeof(size32));
+        std::memcpy(data + offset + sizeof(size32), packet, size);
+        header->writePosition.store(position + recordSize, std::memory_order_release);
+        return true;
+    }
+};
+#endif
+
+bool OscTarget::Admit(uint64_t nowNs) {
+    if (maxRate <= 0) {
+        return true;
+    }
+    tokens = std::min(1.0, tokens + (nowNs - lastRefillNs) * 1e-9 * maxRate);
+    lastRefillNs = nowNs;
+    if (tokens < 1.0) {
+        return false;
+    }
+    tokens -= 1.0;
+    return true;
+}
+
+std::unique_ptr<OscTarget> OpenOscTarget(const std::string& uri) {
+    auto schemeEnd = uri.find("://");
+    if (schemeEnd == std::string::npos) {
+        throw std::runtime_error("invalid OSC target, expected scheme://address: " + uri);
+    }
+    auto scheme = uri.substr(0, schemeEnd);
+    auto address = uri.substr(schemeEnd + 3);
+
+    // ?key=value&key=value
+    float rate = 0;
+    uint32_t shmSize = defaultShmSize;
+    auto queryBegin = address.find('?');
+    if (queryBegin != std::string::npos) {
+        auto query = address.substr(queryBegin + 1);
+        address.resize(queryBegin);
+        size_t begin = 0;
+        while (begin < query.size()) {
+            auto end = query.find('&', begin);
+            if (end == std::string::npos) {
+                end = query.size();
+            }
+            auto item = query.substr(begin, end - begin);
+            auto equals = item.find('=');
+            auto key = item.substr(0, equals);
+            auto value = equals == std::string::npos ? std::string() : item.substr(equals + 1);
+            try {
+                if (key == "rate") {
+                    rate = std::stof(value);
+                } else if (key == "size") {
+                    shmSize = uint32_t(std::stoul(value));
+                } else {
+                    throw std::runtime_error("unknown OSC target option " + key);
+                }
+            } catch (const std::logic_error&) {
+                throw std::runtime_error("invalid value for OSC target option " + key);
+            }
+            begin = end + 1;
+        }
+    }
+
+    auto target = std::make_unique<OscTarget>();
+    target->uri = uri;
+    target->maxRate = rate;
+    if (scheme == "udp") {
+        auto colon = address.rfind(':');
+        if (colon == std::string::npos) {
+            throw std::runtime_error("invalid OSC target, expected udp://host:port: " + uri);
+        }
+        auto host = address.substr(0, colon);
+        if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+            host = host.substr(1, host.size() - 2);
+        }
+        target->transport = std::make_unique<UdpTransport>(host, address.substr(colon + 1));
+    }
+#ifndef WINDOWS
+    else if (scheme == "unix") {
+        target->transport = std::make_unique<UnixTransport>(address);
+    } else if (scheme == "shm") {
+        target->transport = std::make_unique<ShmTransport>(address, shmSize);
+    }
+#endif
+    else {
+        throw std::runtime_error("unsupported OSC target scheme " + scheme);
+    }
+    return target;
+}
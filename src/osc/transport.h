@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Where OSC packets go. Targets are written as URIs:
+//   udp://host:port         UDP datagrams
+//   unix:///path/to/socket  AF_UNIX datagram socket (not on Windows)
+//   shm:///path/to/file     memory-mapped ring of packets for same-host consumers (not on Windows),
+//                           ?size=N sets the ring size in bytes
+// Any target may end in ?rate=N to send it at most N packets per second.
+class OscTransport
+{
+public:
+	virtual ~OscTransport() = default;
+
+	// must never block; returns false if the packet could not be delivered
+	virtual bool Send(const char *data, size_t size) = 0;
+};
+
+// Layout of the shm:// ring. Records start at data[position % capacity] and are a uint32_t
+// size followed by the packet, padded to 4 bytes. Records never straddle the end of the ring;
+// a size of shmWrapMarker means the rest of the ring is unused and the next record is at 0.
+// writePosition only ever grows and is stored with release semantics after each record, so
+// a reader that is more than capacity bytes behind it has been overrun.
+constexpr char     shmMagic[8]   = "TPTOSC1";
+constexpr uint32_t shmVersion    = 1;
+constexpr uint32_t shmWrapMarker = UINT32_MAX;
+struct OscShmHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t capacity; // size of the data area following the header
+	std::atomic<uint64_t> writePosition;
+};
+
+struct OscTarget
+{
+	std::string uri;
+	std::unique_ptr<OscTransport> transport;
+	float maxRate = 0; // packets per second, 0 means unlimited
+	double tokens = 1;
+	uint64_t lastRefillNs = 0;
+
+	uint64_t sent = 0;
+	uint64_t failed = 0;
+	uint64_t rateLimited = 0;
+
+	// token bucket with a burst of one packet so the rate limit also smooths the stream
+	bool Admit(uint64_t nowNs);
+};
+
+// throws std::runtime_error if the URI is invalid or the transport could not be opened
+std::unique_ptr<OscTarget> OpenOscTarget(const std::string &uri);
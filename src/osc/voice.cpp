@@ -0,0 +1,104 @@
+#include "voice.h"
+#include <algorithm>
+
+VoiceAllocator::VoiceAllocator() {
+    voiceOf.fill(-1);
+    events.on.fill(-1);
+    events.off.fill(-1);
+}
+
+void VoiceAllocator::SetConfig(const VoiceAllocatorConfig& newConfig) {
+    config = newConfig;
+    config.releaseBelow = std::max(config.releaseBelow, 1);
+    config.releaseFrames = std::max(config.releaseFrames, 1);
+    config.stealRatio = std::max(config.stealRatio, 1.0f);
+}
+
+void VoiceAllocator::Release(int voice) {
+    auto& v = voices[voice];
+    // an on and off for the same voice within one batch of events cancel out
+    if (events.on[voice] == v.type) {
+        events.on[voice] = -1;
+    } else {
+        events.off[voice] = v.type;
+    }
+    voiceOf[v.type] = -1;
+    v.type = -1;
+    v.weakFrames = 0;
+}
+
+void VoiceAllocator::Assign(int voice, int type) {
+    auto& v = voices[voice];
+    v.type = type;
+    v.weakFrames = 0;
+    voiceOf[type] = voice;
+    events.on[voice] = type;
+}
+
+void VoiceAllocator::Update(const ElementRanking& ranking) {
+    // voices that are free, in order, and voices whose type fell out of the ranking
+    std::array<int, HANDLERS> freeVoices;
+    int freeCount = 0;
+    std::array<int, HANDLERS> unranked;
+    int unrankedCount = 0;
+    for (int i = 0; i < HANDLERS; i++) {
+        auto& v = voices[i];
+        if (v.type >= 0) {
+            if (ranking.count(v.type) < config.releaseBelow) {
+                v.weakFrames++;
+                if (v.weakFrames >= config.releaseFrames) {
+                    Release(i);
+                }
+            } else {
+                v.weakFrames = 0;
+            }
+        }
+        if (v.type < 0) {
+            freeVoices[freeCount++] = i;
+        } else if (!ranking.isRanked(v.type)) {
+            unranked[unrankedCount++] = i;
+        }
+    }
+
+    int nextFree = 0;
+    for (int rank = 0; rank < ranking.size(); rank++) {
+        auto type = ranking.type(rank);
+        auto count = ranking.count(type);
+        if (voiceOf[type] >= 0 || count < config.releaseBelow) {
+            continue;
+        }
+        int target;
+        if (nextFree < freeCount) {
+            target = freeVoices[nextFree++];
+        } else {
+            // there are no more ranked types than voices, so with all voices taken and this type
+            // left out, some voice belongs to a type that is not ranked; those have no more
+            // particles than any ranked type, so the weakest voice is among them
+            if (!unrankedCount) {
+                break;
+            }
+            int weakest = 0;
+            for (int k = 1; k < unrankedCount; k++) {
+                if (ranking.count(voices[unranked[k]].type) < ranking.count(voices[unranked[weakest]].type)) {
+                    weakest = k;
+                }
+            }
+            target = unranked[weakest];
+            if (count < ranking.count(voices[target].type) * config.stealRatio) {
+                // ranked in order, so no later type can steal either
+                break;
+            }
+            std::copy(unranked.begin() + weakest + 1, unranked.begin() + unrankedCount, unranked.begin() + weakest);
+            unrankedCount--;
+            Release(target);
+        }
+        Assign(target, type);
+    }
+}
+
+VoiceEvents VoiceAllocator::TakeEvents() {
+    auto taken = events;
+    events.on.fill(-1);
+    events.off.fill(-1);
+    return taken;
+}
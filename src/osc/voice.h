@@ -0,0 +1,62 @@
+#pragma once
+#include "handler.h"
+#include <array>
+
+struct VoiceAllocatorConfig
+{
+	int releaseBelow = 1;    // a voice whose type has fewer particles than this is weak
+	int releaseFrames = 30;  // a voice is released after being weak for this many frames in a row
+	float stealRatio = 2.0f; // a new type takes the weakest voice only if it has this many times its particles
+};
+
+// What happened to each voice during the last Update, -1 if nothing. A voice that was stolen
+// has both an off (the old type) and an on (the new type).
+struct VoiceEvents
+{
+	std::array<int, HANDLERS> on;
+	std::array<int, HANDLERS> off;
+};
+
+// Assigns element types to handler slots ("voices") from the per-frame ranking. A type keeps
+// its voice while it stays strong enough, so voices only change when a type fades out or is
+// clearly outnumbered, never just because two counts crossed. Update is O(HANDLERS) with no
+// allocation, plus a scan of the voices of types that fell out of the ranking for each voice
+// it steals, and reading a type's voice is a table lookup.
+class VoiceAllocator
+{
+public:
+	VoiceAllocator();
+
+	void SetConfig(const VoiceAllocatorConfig &newConfig);
+	const VoiceAllocatorConfig &GetConfig() const
+	{
+		return config;
+	}
+
+	// call once per frame with the frame's counts; events accumulate until TakeEvents
+	void Update(const ElementRanking &ranking);
+	VoiceEvents TakeEvents();
+
+	int VoiceOf(int type) const // -1 if the type has no voice
+	{
+		return voiceOf[type];
+	}
+	int TypeOf(int voice) const // -1 if the voice is free
+	{
+		return voices[voice].type;
+	}
+
+private:
+	struct Voice
+	{
+		int type = -1;
+		int weakFrames = 0;
+	};
+	void Release(int voice);
+	void Assign(int voice, int type);
+
+	VoiceAllocatorConfig config;
+	std::array<Voice, HANDLERS> voices;
+	std::array<int, PT_NUM> voiceOf;
+	VoiceEvents events;
+};
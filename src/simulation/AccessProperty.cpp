@@ -11,6 +11,7 @@ void AccessProperty::Set(Simulation *sim, int i) const
 		sim->part_change_type(i, int(part.x + 0.5f), int(part.y + 0.5f), std::get<int>(propertyValue));
 		return;
 	}
+	sim->WakeTiles(int(part.x + 0.5f), int(part.y + 0.5f), int(part.x + 0.5f), int(part.y + 0.5f));
 	switch (prop.Type)
 	{
 	case StructProperty::Float:
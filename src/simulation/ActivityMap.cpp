@@ -0,0 +1,335 @@
+#include "ActivityMap.h"
+#include "Simulation.h"
+#include "SimulationData.h"
+#include "Air.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
+// frames a tile has to stay quiet for before it falls asleep
+constexpr int sleepAfterFrames = 30;
+// how much the air, ambient heat and gravity over a sleeping tile may drift from what they were
+// when it was last awake, and how much pressure and ambient heat may vary across it
+constexpr float driftEpsilon = 0.005f;
+constexpr float pressureEpsilon = 0.05f;
+constexpr float gradientEpsilon = 0.05f;
+// conducting heat between particles at the same temperature wobbles the last bits of their
+// temperatures; differences smaller than this are not worth waking anything up for
+constexpr float temperatureStep = 1.0f / 64.0f;
+
+static uint32_t HashParticle(const Particle &part)
+{
+	static_assert(sizeof(Particle) % sizeof(uint32_t) == 0);
+	std::array<uint32_t, sizeof(Particle) / sizeof(uint32_t)> words;
+	std::memcpy(words.data(), &part, sizeof(Particle));
+	auto temp = std::floor(part.temp / temperatureStep);
+	std::memcpy(&words[offsetof(Particle, temp) / sizeof(uint32_t)], &temp, sizeof(temp));
+	// only needs to tell whether a particle changed; the factors are odd, so a change to any
+	// one field always changes the hash, and the loop vectorizes
+	uint32_t hash = 0;
+	for (auto k = 0U; k < words.size(); k++)
+	{
+		hash += words[k] * (UINT32_C(0x9E3779B1) + 2 * k);
+	}
+	return hash | 1U; // 0 is for empty slots
+}
+
+static void TileCells(int tile, int &cx0, int &cy0, int &cx1, int &cy1)
+{
+	cx0 = (tile % ACTIVITY_TILES_X) * ACTIVITY_TILE_CELLS;
+	cy0 = (tile / ACTIVITY_TILES_X) * ACTIVITY_TILE_CELLS;
+	cx1 = std::min(cx0 + ACTIVITY_TILE_CELLS, XCELLS);
+	cy1 = std::min(cy0 + ACTIVITY_TILE_CELLS, YCELLS);
+}
+
+ActivityMap::ActivityMap(Simulation &newSim) :
+	sim(newSim),
+	hashes(NPART, 0U),
+	surroundings(NCELL)
+{
+	settings = CurrentSettings();
+	WakeAll();
+	busy.fill(false);
+	loose.fill(true);
+	sleepable.fill(false);
+	pushable.fill(true);
+	conductive.fill(false);
+	minTemp.fill(std::numeric_limits<float>::max());
+	maxTemp.fill(std::numeric_limits<float>::lowest());
+}
+
+ActivityMap::Settings ActivityMap::CurrentSettings() const
+{
+	return {
+		sim.gravityMode,
+		sim.customGravityX,
+		sim.customGravityY,
+		sim.legacy_enable,
+		sim.water_equal_test,
+		sim.aheat_enable,
+		sim.edgeMode,
+		sim.air->airMode,
+		sim.air->ambientAirTemp,
+		bool(sim.grav),
+	};
+}
+
+void ActivityMap::BeginFrame()
+{
+	auto newSettings = CurrentSettings();
+	if (!(newSettings == settings))
+	{
+		settings = newSettings;
+		WakeAll();
+	}
+
+	// legacy mode gives every element an update function
+	auto &elements = SimulationData::CRef().elements;
+	for (int t = 0; t < PT_NUM; t++)
+	{
+		auto &el = elements[t];
+		sleepable[t] = !sim.legacy_enable && el.Enabled && !el.Update && !(el.Properties & PROP_SERIAL) && !el.HotAir;
+		pushable[t] = el.Advection != 0 || (!(el.Properties & TYPE_SOLID) && (el.Gravity != 0 || el.NewtonianGravity != 0));
+		conductive[t] = el.HeatConduct > 0;
+	}
+
+	// what the particles of a sleeping tile would notice has to be caught before they are skipped
+	for (auto tile = 0; tile < ACTIVITY_TILES; tile++)
+	{
+		if (!asleep[tile])
+		{
+			// filled in again by Updated
+			loose[tile] = false;
+			minTemp[tile] = std::numeric_limits<float>::max();
+			maxTemp[tile] = std::numeric_limits<float>::lowest();
+		}
+		else if (!Calm(tile))
+		{
+			asleep[tile] = false;
+			active[tile] = true;
+			quietFrames[tile] = 0;
+		}
+	}
+}
+
+void ActivityMap::Updated(int i, int tileBefore)
+{
+	auto &part = sim.parts[i];
+	auto tileAfter = -1;
+	auto hash = 0U;
+	if (part.type)
+	{
+		tileAfter = TileAt(int(part.x + 0.5f), int(part.y + 0.5f));
+		hash = HashParticle(part);
+	}
+	if (hash != hashes[i])
+	{
+		hashes[i] = hash;
+		if (tileBefore >= 0)
+		{
+			if (asleep[tileBefore])
+			{
+				misses += 1;
+			}
+			active[tileBefore] = true;
+		}
+		if (tileAfter >= 0)
+		{
+			active[tileAfter] = true;
+		}
+	}
+	if (tileAfter >= 0)
+	{
+		if (!sleepable[part.type])
+		{
+			busy[tileAfter] = true;
+		}
+		if (pushable[part.type])
+		{
+			loose[tileAfter] = true;
+		}
+		if (conductive[part.type])
+		{
+			minTemp[tileAfter] = std::min(minTemp[tileAfter], part.temp);
+			maxTemp[tileAfter] = std::max(maxTemp[tileAfter], part.temp);
+		}
+	}
+}
+
+bool ActivityMap::Calm(int tile) const
+{
+	int cx0, cy0, cx1, cy1;
+	TileCells(tile, cx0, cy0, cx1, cy1);
+	// heat conducts across tile borders too; tiles without conductive particles have an empty
+	// range and do not count
+	auto tx = tile % ACTIVITY_TILES_X, ty = tile / ACTIVITY_TILES_X;
+	auto lowest = minTemp[tile], highest = maxTemp[tile];
+	for (auto ny = std::max(ty - 1, 0); ny <= std::min(ty + 1, ACTIVITY_TILES_Y - 1); ny++)
+	{
+		for (auto nx = std::max(tx - 1, 0); nx <= std::min(tx + 1, ACTIVITY_TILES_X - 1); nx++)
+		{
+			lowest = std::min(lowest, minTemp[ny * ACTIVITY_TILES_X + nx]);
+			highest = std::max(highest, maxTemp[ny * ACTIVITY_TILES_X + nx]);
+		}
+	}
+	if (highest - lowest > temperatureStep)
+	{
+		return false;
+	}
+
+	auto aheat = sim.aheat_enable;
+	auto pushed = loose[tile];
+	auto newtonian = pushed && bool(sim.grav);
+	for (auto cy = cy0; cy < cy1; cy++)
+	{
+		for (auto cx = cx0; cx < cx1; cx++)
+		{
+			// sparked conductive walls, and detector walls, which are set off by particles
+			if (sim.emap[cy][cx] || sim.bmap[cy][cx] == WL_DETECT)
+			{
+				return false;
+			}
+			auto &s = surroundings[cy * XCELLS + cx];
+			if (std::abs(sim.pv[cy][cx] - s.pv) > pressureEpsilon)
+			{
+				return false;
+			}
+			if (pushed && (std::abs(sim.vx[cy][cx] - s.vx) > driftEpsilon ||
+			               std::abs(sim.vy[cy][cx] - s.vy) > driftEpsilon))
+			{
+				return false;
+			}
+			if (aheat && std::abs(sim.hv[cy][cx] - s.hv) > driftEpsilon)
+			{
+				return false;
+			}
+			if (newtonian && (std::abs(sim.gravOut.forceX[{ cx, cy }] - s.gravX) > driftEpsilon ||
+			                  std::abs(sim.gravOut.forceY[{ cx, cy }] - s.gravY) > driftEpsilon))
+			{
+				return false;
+			}
+		}
+	}
+	if (!pushed && !aheat)
+	{
+		return true;
+	}
+
+	// a gradient drives air or heat into or out of the tile sooner or later, include the cells
+	// around it so that one at the edge of the tile is noticed too
+	auto minPv = sim.pv[cy0][cx0], maxPv = minPv;
+	auto minHv = sim.hv[cy0][cx0], maxHv = minHv;
+	for (auto cy = std::max(cy0 - 1, 0); cy < std::min(cy1 + 1, YCELLS); cy++)
+	{
+		for (auto cx = std::max(cx0 - 1, 0); cx < std::min(cx1 + 1, XCELLS); cx++)
+		{
+			minPv = std::min(minPv, sim.pv[cy][cx]);
+			maxPv = std::max(maxPv, sim.pv[cy][cx]);
+			minHv = std::min(minHv, sim.hv[cy][cx]);
+			maxHv = std::max(maxHv, sim.hv[cy][cx]);
+		}
+	}
+	if (pushed && maxPv - minPv > gradientEpsilon)
+	{
+		return false;
+	}
+	if (aheat && maxHv - minHv > gradientEpsilon)
+	{
+		return false;
+	}
+	return true;
+}
+
+void ActivityMap::Remember(int tile)
+{
+	int cx0, cy0, cx1, cy1;
+	TileCells(tile, cx0, cy0, cx1, cy1);
+	for (auto cy = cy0; cy < cy1; cy++)
+	{
+		for (auto cx = cx0; cx < cx1; cx++)
+		{
+			auto &s = surroundings[cy * XCELLS + cx];
+			s.pv = sim.pv[cy][cx];
+			s.vx = sim.vx[cy][cx];
+			s.vy = sim.vy[cy][cx];
+			s.hv = sim.hv[cy][cx];
+			s.gravX = sim.gravOut.forceX[{ cx, cy }];
+			s.gravY = sim.gravOut.forceY[{ cx, cy }];
+		}
+	}
+}
+
+void ActivityMap::EndFrame()
+{
+	std::array<bool, ACTIVITY_TILES> neighbourActive;
+	neighbourActive.fill(false);
+	for (auto ty = 0; ty < ACTIVITY_TILES_Y; ty++)
+	{
+		for (auto tx = 0; tx < ACTIVITY_TILES_X; tx++)
+		{
+			if (!active[ty * ACTIVITY_TILES_X + tx])
+			{
+				continue;
+			}
+			for (auto ny = std::max(ty - 1, 0); ny <= std::min(ty + 1, ACTIVITY_TILES_Y - 1); ny++)
+			{
+				for (auto nx = std::max(tx - 1, 0); nx <= std::min(tx + 1, ACTIVITY_TILES_X - 1); nx++)
+				{
+					neighbourActive[ny * ACTIVITY_TILES_X + nx] = true;
+				}
+			}
+		}
+	}
+
+	for (auto tile = 0; tile < ACTIVITY_TILES; tile++)
+	{
+		// sleeping tiles were checked by BeginFrame already
+		if (neighbourActive[tile] || busy[tile] || (!asleep[tile] && !Calm(tile)))
+		{
+			asleep[tile] = false;
+			quietFrames[tile] = 0;
+		}
+		else if (!asleep[tile] && ++quietFrames[tile] >= sleepAfterFrames)
+		{
+			asleep[tile] = true;
+		}
+		if (!asleep[tile])
+		{
+			Remember(tile);
+		}
+	}
+	active.fill(false);
+	busy.fill(false);
+}
+
+void ActivityMap::Wake(int x1, int y1, int x2, int y2)
+{
+	auto tx1 = std::clamp(std::min(x1, x2), 0, XRES - 1) / ACTIVITY_TILE_SIZE;
+	auto ty1 = std::clamp(std::min(y1, y2), 0, YRES - 1) / ACTIVITY_TILE_SIZE;
+	auto tx2 = std::clamp(std::max(x1, x2), 0, XRES - 1) / ACTIVITY_TILE_SIZE;
+	auto ty2 = std::clamp(std::max(y1, y2), 0, YRES - 1) / ACTIVITY_TILE_SIZE;
+	for (auto ty = ty1; ty <= ty2; ty++)
+	{
+		for (auto tx = tx1; tx <= tx2; tx++)
+		{
+			auto tile = ty * ACTIVITY_TILES_X + tx;
+			asleep[tile] = false;
+			active[tile] = true;
+			quietFrames[tile] = 0;
+		}
+	}
+}
+
+void ActivityMap::WakeAll()
+{
+	asleep.fill(false);
+	active.fill(true);
+	quietFrames.fill(0);
+}
+
+int ActivityMap::CountAsleep() const
+{
+	return int(std::count(asleep.begin(), asleep.end(), true));
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include "ElementDefs.h"
+#include "SimulationConfig.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+class Simulation;
+
+constexpr int ACTIVITY_TILE_SIZE  = 16;
+constexpr int ACTIVITY_TILE_CELLS = ACTIVITY_TILE_SIZE / CELL;
+constexpr int ACTIVITY_TILES_X    = (XRES + ACTIVITY_TILE_SIZE - 1) / ACTIVITY_TILE_SIZE;
+constexpr int ACTIVITY_TILES_Y    = (YRES + ACTIVITY_TILE_SIZE - 1) / ACTIVITY_TILE_SIZE;
+constexpr int ACTIVITY_TILES      = ACTIVITY_TILES_X * ACTIVITY_TILES_Y;
+static_assert(ACTIVITY_TILE_SIZE % CELL == 0);
+
+// Which parts of the simulation have settled, so that UpdateParticles can skip the particles
+// in them, see Simulation::sleepingTiles. A tile falls asleep once none of its particles have
+// changed for a while, none of its neighbours have seen any activity, its particles and those
+// of its neighbours are all at about the same temperature, the pressure and ambient heat over
+// it have stayed put, and all its particles are of elements that only do anything
+// through the parts of an update that depend on their surroundings, i.e. have no Update
+// function, no PROP_SERIAL and no HotAir. Air velocity and gravity only count for tiles with
+// particles that they push around. Particles in sleeping tiles still slow down the air like
+// they do when they are updated.
+//
+// Tiles wake up when a particle in them is created, killed, changes type or moves, when
+// something is drawn on them, when the air over them changes, or when one of their neighbours
+// wakes up. Anything else that writes particles directly has to call Simulation::WakeTiles.
+//
+// In check mode, sleeping tiles are updated anyway, and particles in them that change are
+// counted as misses; a miss means that skipping the tile would have given a different result.
+class ActivityMap
+{
+public:
+	ActivityMap(Simulation &newSim);
+
+	// -1 if out of bounds, such particles are always updated
+	static int TileAt(int x, int y)
+	{
+		if (x < 0 || y < 0 || x >= XRES || y >= YRES)
+		{
+			return -1;
+		}
+		return (y / ACTIVITY_TILE_SIZE) * ACTIVITY_TILES_X + x / ACTIVITY_TILE_SIZE;
+	}
+
+	bool Asleep(int tile) const
+	{
+		return tile >= 0 && asleep[tile];
+	}
+
+	void BeginFrame();
+	void Updated(int i, int tileBefore); // after UpdateParticle(i)
+	void EndFrame();
+
+	void Wake(int x1, int y1, int x2, int y2); // particle coordinates, inclusive
+	void WakeAll();
+
+	int CountAsleep() const;
+	uint64_t GetMisses() const
+	{
+		return misses;
+	}
+	void ResetMisses()
+	{
+		misses = 0;
+	}
+
+private:
+	Simulation &sim;
+	std::array<bool, ACTIVITY_TILES> asleep;
+	std::array<bool, ACTIVITY_TILES> active; // something changed this frame, wakes neighbours too
+	std::array<bool, ACTIVITY_TILES> busy; // has particles that must not sleep
+	std::array<bool, ACTIVITY_TILES> loose; // has particles that air or gravity push around
+	std::array<uint8_t, ACTIVITY_TILES> quietFrames;
+	std::array<bool, PT_NUM> sleepable;
+	std::array<bool, PT_NUM> pushable;
+	std::array<bool, PT_NUM> conductive;
+	// of the conductive particles in each tile, as of the last frame the tile was awake
+	std::array<float, ACTIVITY_TILES> minTemp;
+	std::array<float, ACTIVITY_TILES> maxTemp;
+	std::vector<uint32_t> hashes; // of each particle after its most recent update
+
+	// what the particles in a cell depend on besides other particles, as of the last frame
+	// the tile of the cell was awake
+	struct Surroundings
+	{
+		float pv, vx, vy, hv, gravX, gravY;
+	};
+	std::vector<Surroundings> surroundings;
+
+	// settings that change what any particle does
+	struct Settings
+	{
+		int gravityMode;
+		float customGravityX, customGravityY;
+		int legacyEnable, waterEqualTest, aheatEnable, edgeMode, airMode;
+		float ambientAirTemp;
+		bool newtonianGravity;
+
+		bool operator ==(const Settings &) const = default;
+	};
+	Settings settings;
+	Settings CurrentSettings() const;
+
+	uint64_t misses = 0;
+
+	bool Calm(int tile) const;
+	void Remember(int tile);
+};
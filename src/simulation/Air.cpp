@@ -2,8 +2,11 @@
 #include "Simulation.h"
 #include "ElementClasses.h"
 #include "common/tpt-rand.h"
-#include <cmath>
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <vector>
 
 void Air::make_kernel(void) //used for velocity
 {
@@ -40,11 +43,115 @@ void Air::ClearAirH()
 
 // Used when updating temp or velocity from far away
 const float advDistanceMult = 0.7f;
+// rows of cells the banded updates hand to a thread at a time
+constexpr int airBandRows = 8;
+
+// Where the cell at x, y takes velocity or heat from when it is carried far, stopping short of
+// the first cell on the way with any of the bits of blockMask set in blocks
+static void AdvectionSource(const unsigned char (&blocks)[YCELLS][XCELLS], unsigned char blockMask, int x, int y, float dx, float dy, float &tx, float &ty)
+{
+	tx = x - dx*advDistanceMult;
+	ty = y - dy*advDistanceMult;
+	if ((std::abs(dx*advDistanceMult)>1.0f || std::abs(dy*advDistanceMult)>1.0f) && (tx>=2 && tx<XCELLS-2 && ty>=2 && ty<YCELLS-2))
+	{
+		// Trying to take velocity from far away, check whether there is an intervening wall.
+		// Step from current position to desired source location, looking for walls, with either the x or y step size being 1 cell
+		float stepX, stepY;
+		int stepLimit;
+		if (std::abs(dx)>std::abs(dy))
+		{
+			stepX = (dx<0.0f) ? 1.f : -1.f;
+			stepY = -dy/fabsf(dx);
+			stepLimit = (int)(fabsf(dx*advDistanceMult));
+		}
+		else
+		{
+			stepY = (dy<0.0f) ? 1.f : -1.f;
+			stepX = -dx/fabsf(dy);
+			stepLimit = (int)(fabsf(dy*advDistanceMult));
+		}
+		tx = float(x);
+		ty = float(y);
+		auto step = 0;
+		for (; step<stepLimit; ++step)
+		{
+			tx += stepX;
+			ty += stepY;
+			if (blocks[(int)(ty+0.5f)][(int)(tx+0.5f)]&blockMask)
+			{
+				tx -= stepX;
+				ty -= stepY;
+				break;
+			}
+		}
+		if (step==stepLimit)
+		{
+			// No wall found
+			tx = x - dx*advDistanceMult;
+			ty = y - dy*advDistanceMult;
+		}
+	}
+}
+
+// Runs banded and then reference from the same state of fields, and tells whether they left
+// them in the same state; the one reference left them in is kept
+template<class Banded, class Reference>
+static bool SameAsReference(std::initializer_list<float (*)[XCELLS]> fields, Banded banded, Reference reference)
+{
+	std::vector<std::vector<float>> before, after;
+	for (auto *field : fields)
+	{
+		before.emplace_back(&field[0][0], &field[0][0] + NCELL);
+	}
+	banded();
+	auto k = 0;
+	for (auto *field : fields)
+	{
+		after.emplace_back(&field[0][0], &field[0][0] + NCELL);
+		std::copy(before[k].begin(), before[k].end(), &field[0][0]);
+		k += 1;
+	}
+	reference();
+	k = 0;
+	for (auto *field : fields)
+	{
+		if (std::memcmp(after[k].data(), &field[0][0], NCELL * sizeof(float)))
+		{
+			return false;
+		}
+		k += 1;
+	}
+	return true;
+}
+
+void Air::RunBands(const std::function<void(int, int)> &work)
+{
+	sim.RunOnWorkers((YCELLS + airBandRows - 1) / airBandRows, [&work](int band) {
+		auto y0 = band * airBandRows;
+		work(y0, std::min(y0 + airBandRows, YCELLS));
+	});
+}
 
 void Air::update_airh(void)
 {
-	auto &vx = sim.vx;
-	auto &vy = sim.vy;
+	if (checkReference)
+	{
+		auto same = SameAsReference({ sim.hv, sim.vx, sim.vy }, [this]() {
+			update_airh_banded();
+		}, [this]() {
+			update_airh_reference();
+		});
+		if (!same)
+		{
+			referenceMismatches += 1;
+		}
+		return;
+	}
+	update_airh_banded();
+}
+
+void Air::ResetAirHEdges()
+{
 	auto &hv = sim.hv;
 	for (auto i=0; i<YCELLS; i++) //sets air temp on the edges every frame
 	{
@@ -60,6 +167,14 @@ void Air::update_airh(void)
 		hv[YCELLS-2][i] = ambientAirTemp;
 		hv[YCELLS-1][i] = ambientAirTemp;
 	}
+}
+
+void Air::update_airh_reference()
+{
+	auto &vx = sim.vx;
+	auto &vy = sim.vy;
+	auto &hv = sim.hv;
+	ResetAirHEdges();
 	for (auto y=0; y<YCELLS; y++) //update air temp and velocity
 	{
 		for (auto x=0; x<XCELLS; x++)
@@ -88,313 +203,522 @@ void Air::update_airh(void)
 				}
 			}
 
-			// Trying to take air temp from far away.
-			// The code is almost identical to the "far away" velocity code from update_air
-			auto tx = x - dx*advDistanceMult;
-			auto ty = y - dy*advDistanceMult;
-			if ((std::abs(dx*advDistanceMult)>1.0f || std::abs(dy*advDistanceMult)>1.0f) && (tx>=2 && tx<XCELLS-2 && ty>=2 && ty<YCELLS-2))
+			AdvectAirH(x, y, dh, dx, dy);
+
+			if (x>=2 && x<XCELLS-2 && y>=2 && y<YCELLS-2)
 			{
-				float stepX, stepY;
-				int stepLimit;
-				if (std::abs(dx)>std::abs(dy))
-				{
-					stepX = (dx<0.0f) ? 1.f : -1.f;
-					stepY = -dy/fabsf(dx);
-					stepLimit = (int)(fabsf(dx*advDistanceMult));
-				}
-				else
-				{
-					stepY = (dy<0.0f) ? 1.f : -1.f;
-					stepX = -dx/fabsf(dy);
-					stepLimit = (int)(fabsf(dy*advDistanceMult));
-				}
-				tx = float(x);
-				ty = float(y);
-				auto step = 0;
-				for (; step<stepLimit; ++step)
-				{
-					tx += stepX;
-					ty += stepY;
-					if (bmap_blockairh[(int)(ty+0.5f)][(int)(tx+0.5f)]&0x8)
-					{
-						tx -= stepX;
-						ty -= stepY;
-						break;
-					}
-				}
-				if (step==stepLimit)
+				Convect(x, y, vx[y][x], vy[y][x]);
+			}
+		}
+	}
+	memcpy(hv, ohv, sizeof(hv));
+}
+
+// The reference update above moves velocity along with the heat while it goes, so the kernel
+// of a cell sees the velocity of the rows above it and of the cell to its left already moved.
+// Here the moved velocity goes to ovx and ovy first, and the kernel takes from there instead.
+void Air::update_airh_banded()
+{
+	auto &vx = sim.vx;
+	auto &vy = sim.vy;
+	auto &hv = sim.hv;
+	ResetAirHEdges();
+	RunBands([this, &vx, &vy](int y0, int y1) {
+		for (auto y=y0; y<y1; y++)
+		{
+			for (auto x=0; x<XCELLS; x++)
+			{
+				openAirH[y][x] = y>0 && y<YCELLS-2 && x>0 && x<XCELLS-2 && !(bmap_blockairh[y][x]&0x8);
+				ovx[y][x] = vx[y][x];
+				ovy[y][x] = vy[y][x];
+				if (x>=2 && x<XCELLS-2 && y>=2 && y<YCELLS-2)
 				{
-					// No wall found
-					tx = x - dx*advDistanceMult;
-					ty = y - dy*advDistanceMult;
+					Convect(x, y, ovx[y][x], ovy[y][x]);
 				}
 			}
-			auto i = (int)tx;
-			auto j = (int)ty;
-			tx -= i;
-			ty -= j;
-			if (!(bmap_blockairh[y][x]&0x8) && i>=2 && i<XCELLS-3 && j>=2 && j<YCELLS-3)
+		}
+	});
+	RunBands([this](int y0, int y1) {
+		for (auto y=y0; y<y1; y++)
+		{
+			UpdateAirHRow(y);
+		}
+	});
+	memcpy(hv, ohv, sizeof(hv));
+	memcpy(vx, ovx, sizeof(vx));
+	memcpy(vy, ovy, sizeof(vy));
+}
+
+// What the kernel of update_airh_banded comes to at any one cell, checking bounds
+void Air::AirHKernelAt(int x, int y, float &dh, float &dx, float &dy) const
+{
+	auto &hv = sim.hv;
+	dh = 0.0f;
+	dx = 0.0f;
+	dy = 0.0f;
+	for (auto j=-1; j<2; j++)
+	{
+		for (auto i=-1; i<2; i++)
+		{
+			auto f = kernel[i+1+(j+1)*3];
+			auto &fromX = (j<0 || (j==0 && i<0)) ? ovx : sim.vx;
+			auto &fromY = (j<0 || (j==0 && i<0)) ? ovy : sim.vy;
+			if (y+j>=0 && y+j<YCELLS && x+i>=0 && x+i<XCELLS && openAirH[y+j][x+i])
+			{
+				dh += hv[y+j][x+i]*f;
+				dx += fromX[y+j][x+i]*f;
+				dy += fromY[y+j][x+i]*f;
+			}
+			else
 			{
-				auto odh = dh;
-				dh *= 1.0f - AIR_VADV;
-				dh += AIR_VADV*(1.0f-tx)*(1.0f-ty)*((bmap_blockairh[j][i]&0x8) ? odh : hv[j][i]);
-				dh += AIR_VADV*tx*(1.0f-ty)*((bmap_blockairh[j][i+1]&0x8) ? odh : hv[j][i+1]);
-				dh += AIR_VADV*(1.0f-tx)*ty*((bmap_blockairh[j+1][i]&0x8) ? odh : hv[j+1][i]);
-				dh += AIR_VADV*tx*ty*((bmap_blockairh[j+1][i+1]&0x8) ? odh : hv[j+1][i+1]);
+				dh += hv[y][x]*f;
+				dx += sim.vx[y][x]*f;
+				dy += sim.vy[y][x]*f;
 			}
+		}
+	}
+}
 
-			// Temp caps
-			if (dh > MAX_TEMP) dh = MAX_TEMP;
-			if (dh < MIN_TEMP) dh = MIN_TEMP;
+void Air::UpdateAirHRow(int y)
+{
+	auto &vx = sim.vx;
+	auto &vy = sim.vy;
+	auto &hv = sim.hv;
+	std::array<float, XCELLS> dhs, dxs, dys;
+	if (y>0 && y<YCELLS-1)
+	{
+		// all neighbours of the inner cells are in bounds; no branches, so this vectorizes
+		for (auto x=1; x<XCELLS-1; x++)
+		{
+			auto dh = 0.0f;
+			auto dx = 0.0f;
+			auto dy = 0.0f;
+			auto ch = hv[y][x], cx = vx[y][x], cy = vy[y][x];
+			// spelled out, the compiler only vectorizes innermost loops
+			auto tap = [this, &hv, x, y, ch, cx, cy, &dh, &dx, &dy](int j, int i, const auto &fromX, const auto &fromY) {
+				auto f = kernel[i+1+(j+1)*3];
+				auto open = openAirH[y+j][x+i];
+				auto nh = hv[y+j][x+i], nx = fromX[y+j][x+i], ny = fromY[y+j][x+i];
+				dh += (open ? nh : ch)*f;
+				dx += (open ? nx : cx)*f;
+				dy += (open ? ny : cy)*f;
+			};
+			tap(-1, -1, ovx, ovy);
+			tap(-1,  0, ovx, ovy);
+			tap(-1,  1, ovx, ovy);
+			tap( 0, -1, ovx, ovy);
+			tap( 0,  0, vx, vy);
+			tap( 0,  1, vx, vy);
+			tap( 1, -1, vx, vy);
+			tap( 1,  0, vx, vy);
+			tap( 1,  1, vx, vy);
+			dhs[x] = dh;
+			dxs[x] = dx;
+			dys[x] = dy;
+		}
+		AirHKernelAt(0, y, dhs[0], dxs[0], dys[0]);
+		AirHKernelAt(XCELLS-1, y, dhs[XCELLS-1], dxs[XCELLS-1], dys[XCELLS-1]);
+	}
+	else
+	{
+		for (auto x=0; x<XCELLS; x++)
+		{
+			AirHKernelAt(x, y, dhs[x], dxs[x], dys[x]);
+		}
+	}
+	for (auto x=0; x<XCELLS; x++)
+	{
+		AdvectAirH(x, y, dhs[x], dxs[x], dys[x]);
+	}
+}
 
-			ohv[y][x] = dh;
+void Air::AdvectAirH(int x, int y, float dh, float dx, float dy)
+{
+	auto &hv = sim.hv;
 
-			// Air convection.
-			// We use the Boussinesq approximation, i.e. we assume density to be nonconstant only
-			// near the gravity term of the fluid equation, and we suppose that it depends linearly on the
-			// difference between the current temperature (hv[y][x]) and some "stationary" temperature (ambientAirTemp).
-			if (x>=2 && x<XCELLS-2 && y>=2 && y<YCELLS-2)
-			{
-				float convGravX, convGravY;
-				sim.GetGravityField(x*CELL, y*CELL, -1.0f, -1.0f, convGravX, convGravY);
-				auto weight = (hv[y][x] - ambientAirTemp) / 10000.0f;
+	// Trying to take air temp from far away.
+	// The code is almost identical to the "far away" velocity code from update_air
+	float tx, ty;
+	AdvectionSource(bmap_blockairh, 0x8, x, y, dx, dy, tx, ty);
+	auto i = (int)tx;
+	auto j = (int)ty;
+	tx -= i;
+	ty -= j;
+	if (!(bmap_blockairh[y][x]&0x8) && i>=2 && i<XCELLS-3 && j>=2 && j<YCELLS-3)
+	{
+		auto odh = dh;
+		dh *= 1.0f - AIR_VADV;
+		dh += AIR_VADV*(1.0f-tx)*(1.0f-ty)*((bmap_blockairh[j][i]&0x8) ? odh : hv[j][i]);
+		dh += AIR_VADV*tx*(1.0f-ty)*((bmap_blockairh[j][i+1]&0x8) ? odh : hv[j][i+1]);
+		dh += AIR_VADV*(1.0f-tx)*ty*((bmap_blockairh[j+1][i]&0x8) ? odh : hv[j+1][i]);
+		dh += AIR_VADV*tx*ty*((bmap_blockairh[j+1][i+1]&0x8) ? odh : hv[j+1][i+1]);
+	}
+
+	// Temp caps
+	if (dh > MAX_TEMP) dh = MAX_TEMP;
+	if (dh < MIN_TEMP) dh = MIN_TEMP;
+
+	ohv[y][x] = dh;
+}
+
+// Air convection.
+// We use the Boussinesq approximation, i.e. we assume density to be nonconstant only
+// near the gravity term of the fluid equation, and we suppose that it depends linearly on the
+// difference between the current temperature (hv[y][x]) and some "stationary" temperature (ambientAirTemp).
+void Air::Convect(int x, int y, float &cvx, float &cvy) const
+{
+	float convGravX, convGravY;
+	sim.GetGravityField(x*CELL, y*CELL, -1.0f, -1.0f, convGravX, convGravY);
+	auto weight = (sim.hv[y][x] - ambientAirTemp) / 10000.0f;
 
-				// Our approximation works best when the temperature difference is small, so we cap it from above.
-				if (weight > 0.01f) weight = 0.01f;
+	// Our approximation works best when the temperature difference is small, so we cap it from above.
+	if (weight > 0.01f) weight = 0.01f;
 
-				vx[y][x] += weight * convGravX;
-				vy[y][x] += weight * convGravY;
+	cvx += weight * convGravX;
+	cvy += weight * convGravY;
+}
+
+void Air::update_air(void)
+{
+	if (airMode == AIR_NOUPDATE) //airMode 4 is no air/pressure update
+	{
+		return;
+	}
+	if (checkReference)
+	{
+		auto same = SameAsReference({ sim.vx, sim.vy, sim.pv }, [this]() {
+			update_air_banded();
+		}, [this]() {
+			update_air_reference();
+		});
+		if (!same)
+		{
+			referenceMismatches += 1;
+		}
+		return;
+	}
+	update_air_banded();
+}
+
+void Air::DampAir()
+{
+	auto &vx = sim.vx;
+	auto &vy = sim.vy;
+	auto &pv = sim.pv;
+	for (auto i=0; i<YCELLS; i++) //reduces pressure/velocity on the edges every frame
+	{
+		pv[i][0] = pv[i][0]*0.8f;
+		pv[i][1] = pv[i][1]*0.8f;
+		pv[i][XCELLS-2] = pv[i][XCELLS-2]*0.8f;
+		pv[i][XCELLS-1] = pv[i][XCELLS-1]*0.8f;
+		vx[i][0] = vx[i][0]*0.9f;
+		vx[i][1] = vx[i][1]*0.9f;
+		vx[i][XCELLS-2] = vx[i][XCELLS-2]*0.9f;
+		vx[i][XCELLS-1] = vx[i][XCELLS-1]*0.9f;
+		vy[i][0] = vy[i][0]*0.9f;
+		vy[i][1] = vy[i][1]*0.9f;
+		vy[i][XCELLS-2] = vy[i][XCELLS-2]*0.9f;
+		vy[i][XCELLS-1] = vy[i][XCELLS-1]*0.9f;
+	}
+	for (auto i=0; i<XCELLS; i++) //reduces pressure/velocity on the edges every frame
+	{
+		pv[0][i] = pv[0][i]*0.8f;
+		pv[1][i] = pv[1][i]*0.8f;
+		pv[YCELLS-2][i] = pv[YCELLS-2][i]*0.8f;
+		pv[YCELLS-1][i] = pv[YCELLS-1][i]*0.8f;
+		vx[0][i] = vx[0][i]*0.9f;
+		vx[1][i] = vx[1][i]*0.9f;
+		vx[YCELLS-2][i] = vx[YCELLS-2][i]*0.9f;
+		vx[YCELLS-1][i] = vx[YCELLS-1][i]*0.9f;
+		vy[0][i] = vy[0][i]*0.9f;
+		vy[1][i] = vy[1][i]*0.9f;
+		vy[YCELLS-2][i] = vy[YCELLS-2][i]*0.9f;
+		vy[YCELLS-1][i] = vy[YCELLS-1][i]*0.9f;
+	}
+
+	for (auto j=1; j<YCELLS-1; j++) //clear some velocities near walls
+	{
+		for (auto i=1; i<XCELLS-1; i++)
+		{
+			if (bmap_blockair[j][i])
+			{
+				vx[j][i] = 0.0f;
+				vx[j][i-1] = 0.0f;
+				vx[j][i+1] = 0.0f;
+				vy[j][i] = 0.0f;
+				vy[j-1][i] = 0.0f;
+				vy[j+1][i] = 0.0f;
 			}
 		}
 	}
-	memcpy(hv, ohv, sizeof(hv));
 }
 
-void Air::update_air(void)
+void Air::update_air_reference()
 {
 	auto &vx = sim.vx;
 	auto &vy = sim.vy;
 	auto &pv = sim.pv;
-	auto &fvx = sim.fvx;
-	auto &fvy = sim.fvy;
-	auto &bmap = sim.bmap;
-	if (airMode != AIR_NOUPDATE) //airMode 4 is no air/pressure update
+	DampAir();
+
+	for (auto y=1; y<YCELLS-1; y++) //pressure adjustments from velocity
 	{
-		for (auto i=0; i<YCELLS; i++) //reduces pressure/velocity on the edges every frame
+		for (auto x=1; x<XCELLS-1; x++)
 		{
-			pv[i][0] = pv[i][0]*0.8f;
-			pv[i][1] = pv[i][1]*0.8f;
-			pv[i][XCELLS-2] = pv[i][XCELLS-2]*0.8f;
-			pv[i][XCELLS-1] = pv[i][XCELLS-1]*0.8f;
-			vx[i][0] = vx[i][0]*0.9f;
-			vx[i][1] = vx[i][1]*0.9f;
-			vx[i][XCELLS-2] = vx[i][XCELLS-2]*0.9f;
-			vx[i][XCELLS-1] = vx[i][XCELLS-1]*0.9f;
-			vy[i][0] = vy[i][0]*0.9f;
-			vy[i][1] = vy[i][1]*0.9f;
-			vy[i][XCELLS-2] = vy[i][XCELLS-2]*0.9f;
-			vy[i][XCELLS-1] = vy[i][XCELLS-1]*0.9f;
+			auto dp = 0.0f;
+			dp += vx[y][x-1] - vx[y][x+1];
+			dp += vy[y-1][x] - vy[y+1][x];
+			pv[y][x] *= AIR_PLOSS;
+			pv[y][x] += dp*AIR_TSTEPP * 0.5f;;
 		}
-		for (auto i=0; i<XCELLS; i++) //reduces pressure/velocity on the edges every frame
+	}
+
+	for (auto y=1; y<YCELLS-1; y++) //velocity adjustments from pressure
+	{
+		for (auto x=1; x<XCELLS-1; x++)
 		{
-			pv[0][i] = pv[0][i]*0.8f;
-			pv[1][i] = pv[1][i]*0.8f;
-			pv[YCELLS-2][i] = pv[YCELLS-2][i]*0.8f;
-			pv[YCELLS-1][i] = pv[YCELLS-1][i]*0.8f;
-			vx[0][i] = vx[0][i]*0.9f;
-			vx[1][i] = vx[1][i]*0.9f;
-			vx[YCELLS-2][i] = vx[YCELLS-2][i]*0.9f;
-			vx[YCELLS-1][i] = vx[YCELLS-1][i]*0.9f;
-			vy[0][i] = vy[0][i]*0.9f;
-			vy[1][i] = vy[1][i]*0.9f;
-			vy[YCELLS-2][i] = vy[YCELLS-2][i]*0.9f;
-			vy[YCELLS-1][i] = vy[YCELLS-1][i]*0.9f;
+			auto dx = 0.0f;
+			auto dy = 0.0f;
+			dx += pv[y][x-1] - pv[y][x+1];
+			dy += pv[y-1][x] - pv[y+1][x];
+			vx[y][x] *= AIR_VLOSS;
+			vy[y][x] *= AIR_VLOSS;
+			vx[y][x] += dx*AIR_TSTEPV * 0.5f;
+			vy[y][x] += dy*AIR_TSTEPV * 0.5f;
+			if (bmap_blockair[y][x-1] || bmap_blockair[y][x] || bmap_blockair[y][x+1])
+				vx[y][x] = 0;
+			if (bmap_blockair[y-1][x] || bmap_blockair[y][x] || bmap_blockair[y+1][x])
+				vy[y][x] = 0;
 		}
+	}
 
-		for (auto j=1; j<YCELLS-1; j++) //clear some velocities near walls
+	for (auto y=0; y<YCELLS; y++) //update velocity and pressure
+	{
+		for (auto x=0; x<XCELLS; x++)
 		{
-			for (auto i=1; i<XCELLS-1; i++)
-			{
-				if (bmap_blockair[j][i])
-				{
-					vx[j][i] = 0.0f;
-					vx[j][i-1] = 0.0f;
-					vx[j][i+1] = 0.0f;
-					vy[j][i] = 0.0f;
-					vy[j-1][i] = 0.0f;
-					vy[j+1][i] = 0.0f;
-				}
-			}
+			float dx, dy, dp;
+			AirKernelAt(x, y, dx, dy, dp);
+			AdvectAir(x, y, dx, dy, dp);
 		}
+	}
+	memcpy(vx, ovx, sizeof(vx));
+	memcpy(vy, ovy, sizeof(vy));
+	memcpy(pv, opv, sizeof(pv));
+}
 
-		for (auto y=1; y<YCELLS-1; y++) //pressure adjustments from velocity
+// Same as the reference update, only the passes over the cells are done in bands of rows, and
+// without branches where the compiler can vectorize them.
+void Air::update_air_banded()
+{
+	auto &vx = sim.vx;
+	auto &vy = sim.vy;
+	auto &pv = sim.pv;
+	DampAir();
+
+	RunBands([this, &vx, &vy, &pv](int y0, int y1) {
+		for (auto y=y0; y<y1; y++)
 		{
-			for (auto x=1; x<XCELLS-1; x++)
+			for (auto x=0; x<XCELLS; x++)
+			{
+				openAir[y][x] = y>0 && y<YCELLS-1 && x>0 && x<XCELLS-1 && !bmap_blockair[y][x];
+			}
+			if (y<1 || y>=YCELLS-1)
+			{
+				continue;
+			}
+			for (auto x=1; x<XCELLS-1; x++) //pressure adjustments from velocity
 			{
 				auto dp = 0.0f;
 				dp += vx[y][x-1] - vx[y][x+1];
 				dp += vy[y-1][x] - vy[y+1][x];
 				pv[y][x] *= AIR_PLOSS;
-				pv[y][x] += dp*AIR_TSTEPP * 0.5f;;
+				pv[y][x] += dp*AIR_TSTEPP * 0.5f;
 			}
 		}
+	});
 
-		for (auto y=1; y<YCELLS-1; y++) //velocity adjustments from pressure
+	RunBands([this, &vx, &vy, &pv](int y0, int y1) {
+		for (auto y=std::max(y0, 1); y<std::min(y1, YCELLS-1); y++)
 		{
-			for (auto x=1; x<XCELLS-1; x++)
+			for (auto x=1; x<XCELLS-1; x++) //velocity adjustments from pressure
 			{
 				auto dx = 0.0f;
 				auto dy = 0.0f;
 				dx += pv[y][x-1] - pv[y][x+1];
 				dy += pv[y-1][x] - pv[y+1][x];
-				vx[y][x] *= AIR_VLOSS;
-				vy[y][x] *= AIR_VLOSS;
-				vx[y][x] += dx*AIR_TSTEPV * 0.5f;
-				vy[y][x] += dy*AIR_TSTEPV * 0.5f;
-				if (bmap_blockair[y][x-1] || bmap_blockair[y][x] || bmap_blockair[y][x+1])
-					vx[y][x] = 0;
-				if (bmap_blockair[y-1][x] || bmap_blockair[y][x] || bmap_blockair[y+1][x])
-					vy[y][x] = 0;
+				auto nvx = vx[y][x]*AIR_VLOSS + dx*AIR_TSTEPV * 0.5f;
+				auto nvy = vy[y][x]*AIR_VLOSS + dy*AIR_TSTEPV * 0.5f;
+				vx[y][x] = (bmap_blockair[y][x-1] | bmap_blockair[y][x] | bmap_blockair[y][x+1]) ? 0.0f : nvx;
+				vy[y][x] = (bmap_blockair[y-1][x] | bmap_blockair[y][x] | bmap_blockair[y+1][x]) ? 0.0f : nvy;
 			}
 		}
+	});
 
-		for (auto y=0; y<YCELLS; y++) //update velocity and pressure
+	RunBands([this](int y0, int y1) {
+		for (auto y=y0; y<y1; y++)
 		{
-			for (auto x=0; x<XCELLS; x++)
+			UpdateAirRow(y);
+		}
+	});
+	memcpy(vx, ovx, sizeof(vx));
+	memcpy(vy, ovy, sizeof(vy));
+	memcpy(pv, opv, sizeof(pv));
+}
+
+void Air::AirKernelAt(int x, int y, float &dx, float &dy, float &dp) const
+{
+	auto &vx = sim.vx;
+	auto &vy = sim.vy;
+	auto &pv = sim.pv;
+	dx = 0.0f;
+	dy = 0.0f;
+	dp = 0.0f;
+	for (auto j=-1; j<2; j++)
+	{
+		for (auto i=-1; i<2; i++)
+		{
+			if (y+j>0 && y+j<YCELLS-1 &&
+			        x+i>0 && x+i<XCELLS-1 &&
+			        !bmap_blockair[y+j][x+i])
 			{
-				auto dx = 0.0f;
-				auto dy = 0.0f;
-				auto dp = 0.0f;
-				for (auto j=-1; j<2; j++)
-				{
-					for (auto i=-1; i<2; i++)
-					{
-						if (y+j>0 && y+j<YCELLS-1 &&
-						        x+i>0 && x+i<XCELLS-1 &&
-						        !bmap_blockair[y+j][x+i])
-						{
-							auto f = kernel[i+1+(j+1)*3];
-							dx += vx[y+j][x+i]*f;
-							dy += vy[y+j][x+i]*f;
-							dp += pv[y+j][x+i]*f;
-						}
-						else
-						{
-							auto f = kernel[i+1+(j+1)*3];
-							dx += vx[y][x]*f;
-							dy += vy[y][x]*f;
-							dp += pv[y][x]*f;
-						}
-					}
-				}
+				auto f = kernel[i+1+(j+1)*3];
+				dx += vx[y+j][x+i]*f;
+				dy += vy[y+j][x+i]*f;
+				dp += pv[y+j][x+i]*f;
+			}
+			else
+			{
+				auto f = kernel[i+1+(j+1)*3];
+				dx += vx[y][x]*f;
+				dy += vy[y][x]*f;
+				dp += pv[y][x]*f;
+			}
+		}
+	}
+}
 
-				auto tx = x - dx*advDistanceMult;
-				auto ty = y - dy*advDistanceMult;
-				if ((std::abs(dx*advDistanceMult)>1.0f || std::abs(dy*advDistanceMult)>1.0f) && (tx>=2 && tx<XCELLS-2 && ty>=2 && ty<YCELLS-2))
-				{
-					// Trying to take velocity from far away, check whether there is an intervening wall.
-					// Step from current position to desired source location, looking for walls, with either the x or y step size being 1 cell
-					float stepX, stepY;
-					int stepLimit;
-					if (std::abs(dx)>std::abs(dy))
-					{
-						stepX = (dx<0.0f) ? 1.f : -1.f;
-						stepY = -dy/fabsf(dx);
-						stepLimit = (int)(fabsf(dx*advDistanceMult));
-					}
-					else
-					{
-						stepY = (dy<0.0f) ? 1.f : -1.f;
-						stepX = -dx/fabsf(dy);
-						stepLimit = (int)(fabsf(dy*advDistanceMult));
-					}
-					tx = float(x);
-					ty = float(y);
-					auto step = 0;
-					for (; step<stepLimit; ++step)
-					{
-						tx += stepX;
-						ty += stepY;
-						if (bmap_blockair[(int)(ty+0.5f)][(int)(tx+0.5f)])
-						{
-							tx -= stepX;
-							ty -= stepY;
-							break;
-						}
-					}
-					if (step==stepLimit)
-					{
-						// No wall found
-						tx = x - dx*advDistanceMult;
-						ty = y - dy*advDistanceMult;
-					}
-				}
-				auto i = (int)tx;
-				auto j = (int)ty;
-				tx -= i;
-				ty -= j;
-				if (!bmap_blockair[y][x] && i>=2 && i<XCELLS-3 && j>=2 && j<YCELLS-3)
-				{
-					dx *= 1.0f - AIR_VADV;
-					dy *= 1.0f - AIR_VADV;
+void Air::UpdateAirRow(int y)
+{
+	auto &vx = sim.vx;
+	auto &vy = sim.vy;
+	auto &pv = sim.pv;
+	std::array<float, XCELLS> dxs, dys, dps;
+	if (y>0 && y<YCELLS-1)
+	{
+		// all neighbours of the inner cells are in bounds; no branches, so this vectorizes
+		for (auto x=1; x<XCELLS-1; x++)
+		{
+			auto dx = 0.0f;
+			auto dy = 0.0f;
+			auto dp = 0.0f;
+			auto cx = vx[y][x], cy = vy[y][x], cp = pv[y][x];
+			// spelled out, the compiler only vectorizes innermost loops
+			auto tap = [this, &vx, &vy, &pv, x, y, cx, cy, cp, &dx, &dy, &dp](int j, int i) {
+				auto f = kernel[i+1+(j+1)*3];
+				auto open = openAir[y+j][x+i];
+				auto nx = vx[y+j][x+i], ny = vy[y+j][x+i], np = pv[y+j][x+i];
+				dx += (open ? nx : cx)*f;
+				dy += (open ? ny : cy)*f;
+				dp += (open ? np : cp)*f;
+			};
+			tap(-1, -1);
+			tap(-1,  0);
+			tap(-1,  1);
+			tap( 0, -1);
+			tap( 0,  0);
+			tap( 0,  1);
+			tap( 1, -1);
+			tap( 1,  0);
+			tap( 1,  1);
+			dxs[x] = dx;
+			dys[x] = dy;
+			dps[x] = dp;
+		}
+		AirKernelAt(0, y, dxs[0], dys[0], dps[0]);
+		AirKernelAt(XCELLS-1, y, dxs[XCELLS-1], dys[XCELLS-1], dps[XCELLS-1]);
+	}
+	else
+	{
+		for (auto x=0; x<XCELLS; x++)
+		{
+			AirKernelAt(x, y, dxs[x], dys[x], dps[x]);
+		}
+	}
+	for (auto x=0; x<XCELLS; x++)
+	{
+		AdvectAir(x, y, dxs[x], dys[x], dps[x]);
+	}
+}
+
+void Air::AdvectAir(int x, int y, float dx, float dy, float dp)
+{
+	auto &vx = sim.vx;
+	auto &vy = sim.vy;
+	auto &fvx = sim.fvx;
+	auto &fvy = sim.fvy;
+	auto &bmap = sim.bmap;
 
-					dx += AIR_VADV*(1.0f-tx)*(1.0f-ty)*vx[j][i];
-					dy += AIR_VADV*(1.0f-tx)*(1.0f-ty)*vy[j][i];
+	float tx, ty;
+	AdvectionSource(bmap_blockair, 0xFF, x, y, dx, dy, tx, ty);
+	auto i = (int)tx;
+	auto j = (int)ty;
+	tx -= i;
+	ty -= j;
+	if (!bmap_blockair[y][x] && i>=2 && i<XCELLS-3 && j>=2 && j<YCELLS-3)
+	{
+		dx *= 1.0f - AIR_VADV;
+		dy *= 1.0f - AIR_VADV;
 
-					dx += AIR_VADV*tx*(1.0f-ty)*vx[j][i+1];
-					dy += AIR_VADV*tx*(1.0f-ty)*vy[j][i+1];
+		dx += AIR_VADV*(1.0f-tx)*(1.0f-ty)*vx[j][i];
+		dy += AIR_VADV*(1.0f-tx)*(1.0f-ty)*vy[j][i];
 
-					dx += AIR_VADV*(1.0f-tx)*ty*vx[j+1][i];
-					dy += AIR_VADV*(1.0f-tx)*ty*vy[j+1][i];
+		dx += AIR_VADV*tx*(1.0f-ty)*vx[j][i+1];
+		dy += AIR_VADV*tx*(1.0f-ty)*vy[j][i+1];
 
-					dx += AIR_VADV*tx*ty*vx[j+1][i+1];
-					dy += AIR_VADV*tx*ty*vy[j+1][i+1];
-				}
+		dx += AIR_VADV*(1.0f-tx)*ty*vx[j+1][i];
+		dy += AIR_VADV*(1.0f-tx)*ty*vy[j+1][i];
 
-				if (bmap[y][x] == WL_FAN)
-				{
-					dx += fvx[y][x];
-					dy += fvy[y][x];
-				}
-				// pressure/velocity caps
-				if (dp > MAX_PRESSURE) dp = MAX_PRESSURE;
-				if (dp < MIN_PRESSURE) dp = MIN_PRESSURE;
-				if (dx > MAX_PRESSURE) dx = MAX_PRESSURE;
-				if (dx < MIN_PRESSURE) dx = MIN_PRESSURE;
-				if (dy > MAX_PRESSURE) dy = MAX_PRESSURE;
-				if (dy < MIN_PRESSURE) dy = MIN_PRESSURE;
+		dx += AIR_VADV*tx*ty*vx[j+1][i+1];
+		dy += AIR_VADV*tx*ty*vy[j+1][i+1];
+	}
 
+	if (bmap[y][x] == WL_FAN)
+	{
+		dx += fvx[y][x];
+		dy += fvy[y][x];
+	}
+	// pressure/velocity caps
+	if (dp > MAX_PRESSURE) dp = MAX_PRESSURE;
+	if (dp < MIN_PRESSURE) dp = MIN_PRESSURE;
+	if (dx > MAX_PRESSURE) dx = MAX_PRESSURE;
+	if (dx < MIN_PRESSURE) dx = MIN_PRESSURE;
+	if (dy > MAX_PRESSURE) dy = MAX_PRESSURE;
+	if (dy < MIN_PRESSURE) dy = MIN_PRESSURE;
 
-				switch (airMode)
-				{
-				default:
-				case AIR_ON:  //Default
-					break;
-				case AIR_PRESSUREOFF:  //0 Pressure
-					dp = 0.0f;
-					break;
-				case AIR_VELOCITYOFF:  //0 Velocity
-					dx = 0.0f;
-					dy = 0.0f;
-					break;
-				case AIR_OFF: //0 Air
-					dx = 0.0f;
-					dy = 0.0f;
-					dp = 0.0f;
-					break;
-				case AIR_NOUPDATE: //No Update
-					break;
-				}
 
-				ovx[y][x] = dx;
-				ovy[y][x] = dy;
-				opv[y][x] = dp;
-			}
-		}
-		memcpy(vx, ovx, sizeof(vx));
-		memcpy(vy, ovy, sizeof(vy));
-		memcpy(pv, opv, sizeof(pv));
+	switch (airMode)
+	{
+	default:
+	case AIR_ON:  //Default
+		break;
+	case AIR_PRESSUREOFF:  //0 Pressure
+		dp = 0.0f;
+		break;
+	case AIR_VELOCITYOFF:  //0 Velocity
+		dx = 0.0f;
+		dy = 0.0f;
+		break;
+	case AIR_OFF: //0 Air
+		dx = 0.0f;
+		dy = 0.0f;
+		dp = 0.0f;
+		break;
+	case AIR_NOUPDATE: //No Update
+		break;
 	}
+
+	ovx[y][x] = dx;
+	ovy[y][x] = dy;
+	opv[y][x] = dp;
 }
 
 void Air::Invert()
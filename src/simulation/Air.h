@@ -1,5 +1,7 @@
 #pragma once
 #include "SimulationConfig.h"
+#include <cstdint>
+#include <functional>
 
 class Simulation;
 
@@ -16,6 +18,11 @@ public:
 	unsigned char bmap_blockair[YCELLS][XCELLS];
 	unsigned char bmap_blockairh[YCELLS][XCELLS];
 	float kernel[9];
+	// runs the plain scalar update after the banded one each frame, from the same state, and counts
+	// the frames where the two differ in any bit; what the scalar one came up with is kept. Builds
+	// with the fast_math option on are free to round the two differently
+	bool checkReference = false;
+	uint64_t referenceMismatches = 0;
 	void make_kernel(void);
 	void update_airh(void);
 	void update_air(void);
@@ -24,4 +31,25 @@ public:
 	void Invert();
 	void ApproximateBlockAirMaps();
 	Air(Simulation & sim);
+
+private:
+	// 1 where the kernel of update_air or update_airh takes from the cell, rather than from the
+	// cell it is centred on, filled in at the start of each update
+	unsigned char openAir[YCELLS][XCELLS];
+	unsigned char openAirH[YCELLS][XCELLS];
+
+	void update_air_banded();
+	void update_airh_banded();
+	void update_air_reference();
+	void update_airh_reference();
+	void DampAir();
+	void ResetAirHEdges();
+	void AirKernelAt(int x, int y, float &dx, float &dy, float &dp) const;
+	void AirHKernelAt(int x, int y, float &dh, float &dx, float &dy) const;
+	void AdvectAir(int x, int y, float dx, float dy, float dp);
+	void AdvectAirH(int x, int y, float dh, float dx, float dy);
+	void Convect(int x, int y, float &cvx, float &cvy) const;
+	void UpdateAirRow(int y);
+	void UpdateAirHRow(int y);
+	void RunBands(const std::function<void(int, int)> &work);
 };
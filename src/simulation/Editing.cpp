@@ -82,6 +82,7 @@ void Simulation::Restore(const Snapshot &snap)
 	rng.state(snap.RngState);
 	parts.lastActiveIndex = NPART - 1;
 	RecalcFreeParticles(false);
+	WakeAllTiles();
 }
 
 void Simulation::clear_area(int area_x, int area_y, int area_w, int area_h)
@@ -181,6 +182,7 @@ int Simulation::CreateWalls(int x, int y, int rx, int ry, int wall, Brush const
 	y = y/CELL;
 	x -= rx;
 	y -= ry;
+	WakeTiles(x*CELL, y*CELL, (x+rx+rx+1)*CELL-1, (y+ry+ry+1)*CELL-1);
 	for (int wallX = x; wallX <= x+rx+rx; wallX++)
 	{
 		for (int wallY = y; wallY <= y+ry+ry; wallY++)
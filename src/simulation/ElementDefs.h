@@ -30,6 +30,7 @@ constexpr auto PROP_LIFE_KILL     = UINT32_C(0x00008000);  //2^15 Kill when life
 constexpr auto PROP_LIFE_KILL_DEC = UINT32_C(0x00010000);  //2^16 Kill when life value is decremented to <= zero
 constexpr auto PROP_SPARKSETTLE   = UINT32_C(0x00020000);  //2^17 Allow Sparks/Embers to settle
 constexpr auto PROP_NOAMBHEAT     = UINT32_C(0x00040000);  //2^18 Don't transfer or receive heat from ambient heat.
+constexpr auto PROP_SERIAL        = UINT32_C(0x00080000);  //2^19 Has effects beyond the reach of a tiled particle update, see TiledUpdate
 constexpr auto PROP_NOCTYPEDRAW   = UINT32_C(0x00100000); // 2^20 When this element is drawn upon with, do not set ctype (like BCLN for CLNE)
 
 constexpr auto FLAG_STAGNANT      = UINT32_C(0x00000001);
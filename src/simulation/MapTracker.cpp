@@ -0,0 +1,37 @@
+#include "MapTracker.h"
+#include "Simulation.h"
+
+MapTracker::MapTracker() :
+	mapped(NPART, Mapped{ -1, 0 }),
+	dirty(XCELLS * YCELLS),
+	live((NPART + 63) / 64)
+{
+}
+
+void MapTracker::Reset(const Parts &parts)
+{
+	for (auto &word : live)
+	{
+		word.store(0, std::memory_order_relaxed);
+	}
+	for (auto &block : dirty)
+	{
+		block.store(0, std::memory_order_relaxed);
+	}
+	for (int i = 0; i < NPART; i++)
+	{
+		mapped[i] = { -1, 0 };
+		if (parts[i].type)
+		{
+			auto x = int(parts[i].x + 0.5f);
+			auto y = int(parts[i].y + 0.5f);
+			if (x >= 0 && y >= 0 && x < XRES && y < YRES)
+			{
+				mapped[i].cell = y * XRES + x;
+			}
+			mapped[i].type = parts[i].type;
+			SetLive(i, true);
+		}
+	}
+	valid = true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "SimulationConfig.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct Parts;
+
+// What RecalcFreeParticles needs to bring pmap, photons and pmap_count up to date without
+// clearing and refilling all of them, see Simulation::incrementalMaps.
+//
+// The maps are rebuilt in blocks of CELL x CELL, and only in blocks marked dirty since the last
+// rebuild. A block is marked dirty when anything writes to the maps in it, see
+// Simulation::MarkMapped, and when a rebuild finds that a particle has left it, entered it or
+// changed type in it, or that one in it was killed. The rest hold what the last rebuild left
+// there, which is what a full rebuild would enter again. Which slots hold particles is kept in a
+// bitmap, so the rebuild never looks at free slots either.
+struct MapTracker
+{
+	struct Mapped
+	{
+		int cell; // y * XRES + x, -1 if out of bounds
+		int type;
+	};
+
+	bool valid = false; // false until the next full rebuild
+	std::vector<Mapped> mapped; // each particle as of the last rebuild
+	std::vector<std::atomic<unsigned char>> dirty; // per CELL x CELL block
+	std::vector<std::atomic<uint64_t>> live;
+	std::vector<int> dying; // killed once the maps are rebuilt
+	uint64_t drifts = 0; // rebuilds that did not match a full one, see Simulation::validateMaps
+
+	struct Maps
+	{
+		int pmap[YRES][XRES];
+		int photons[YRES][XRES];
+		unsigned int pmap_count[YRES][XRES];
+	};
+	std::unique_ptr<Maps> reference; // only while validating
+
+	MapTracker();
+
+	// these three may be called from workers of a tiled update
+	void MarkDirty(int x, int y)
+	{
+		if (x >= 0 && y >= 0 && x < XRES && y < YRES)
+		{
+			dirty[(y / CELL) * XCELLS + x / CELL].store(1, std::memory_order_relaxed);
+		}
+	}
+
+	// where particle i was as of the last rebuild, for when it leaves or is killed
+	void MarkDirtyParticle(int i)
+	{
+		auto cell = mapped[i].cell;
+		if (cell >= 0)
+		{
+			MarkDirty(cell % XRES, cell / XRES);
+		}
+	}
+
+	void SetLive(int i, bool newLive)
+	{
+		auto bit = UINT64_C(1) << (i % 64);
+		if (newLive)
+		{
+			live[i / 64].fetch_or(bit, std::memory_order_relaxed);
+		}
+		else
+		{
+			live[i / 64].fetch_and(~bit, std::memory_order_relaxed);
+		}
+	}
+
+	// after a full rebuild
+	void Reset(const Parts &parts);
+};
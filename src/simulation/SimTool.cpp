@@ -12,6 +12,7 @@ void SimTool::CallPerform(Simulation *sim, ui::Point position, ui::Point brushOf
 		cpart = &(sim->parts[ID(r)]);
 	if (Perform)
 	{
+		sim->WakeTiles(position.X, position.Y, position.X, position.Y);
 		// TODO: maybe do something with the result
 		Perform(this, sim, cpart, position.X, position.Y, brushOffset.X, brushOffset.Y, Strength);
 	}
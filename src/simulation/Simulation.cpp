@@ -1,10 +1,14 @@
 #include "Simulation.h"
+#include "AccessProperty.h"
 #include "Air.h"
 #include "ElementClasses.h"
 #include "TransitionConstants.h"
 #include "gravity/Gravity.h"
 #include "ToolClasses.h"
 #include "SimulationData.h"
+#include "TiledUpdate.h"
+#include "WorkerPool.h"
+#include "ActivityMap.h"
 #include "client/GameSave.h"
 #include "common/tpt-compat.h"
 #include "common/tpt-rand.h"
@@ -16,11 +20,10 @@
 #include "elements/FILT.h"
 #include "osc/osc.h"
 #include "elements/PRTI.h"
+#include <bit>
 #include <iostream>
 #include <set>
 
-static TPTOscClient* oscClient;
-
 static float remainder_p(float x, float y)
 {
 	return std::fmod(x, y) + (x>=0 ? 0 : y);
@@ -34,6 +37,7 @@ void Simulation::Load(const GameSave *save, bool includePressure, Vec2<int> bloc
 	auto &elements = sd.elements;
 
 	RecalcFreeParticles(false);
+	WakeAllTiles();
 
 	struct ExistingParticle
 	{
@@ -994,6 +998,7 @@ void Simulation::clear_sim(void)
 			kill_part(i);
 		}
 	}
+	WakeAllTiles();
 	ensureDeterminism = false;
 	frameCount = 0;
 	debug_nextToUpdate = 0;
@@ -1009,6 +1014,10 @@ void Simulation::clear_sim(void)
 	parts[NPART-1].life = -1;
 	pfree = 0;
 	NUM_PARTS = 0;
+	if (mapTracker)
+	{
+		mapTracker->valid = false;
+	}
 	memset(pmap, 0, sizeof(pmap));
 	memset(fvx, 0, sizeof(fvx));
 	memset(fvy, 0, sizeof(fvy));
@@ -1446,12 +1455,14 @@ int Simulation::try_move(int i, int x, int y, int nx, int ny)
 				pmap[ny][nx] = (s&~PMAPMASK)|parts[ID(s)].type;
 				parts[ID(s)].x = float(nx);
 				parts[ID(s)].y = float(ny);
+				MarkMapped(nx, ny);
 			}
 			else
 				pmap[ny][nx] = 0;
 			parts[ri].x = float(x);
 			parts[ri].y = float(y);
 			pmap[y][x] = PMAP(ri, parts[ri].type);
+			MarkMapped(x, y);
 			return 1;
 		}
 
@@ -1462,6 +1473,7 @@ int Simulation::try_move(int i, int x, int y, int nx, int ny)
 		int rx = int(parts[ri].x + 0.5f);
 		int ry = int(parts[ri].y + 0.5f);
 		pmap[ry][rx] = PMAP(ri, parts[ri].type);
+		MarkMapped(rx, ry);
 	}
 	return 1;
 }
@@ -1510,6 +1522,8 @@ bool Simulation::move(int i, int x, int y, float nxf, float nyf)
 	parts[i].y = nyf;
 	if (ny != y || nx != x)
 	{
+		WakeTiles(x, y, x, y);
+		WakeTiles(nx, ny, nx, ny);
 		if (pmap[y][x] && ID(pmap[y][x]) == i)
 			pmap[y][x] = 0;
 		if (photons[y][x] && ID(photons[y][x]) == i)
@@ -1524,6 +1538,7 @@ bool Simulation::move(int i, int x, int y, float nxf, float nyf)
 			photons[ny][nx] = PMAP(i, t);
 		else if (t)
 			pmap[ny][nx] = PMAP(i, t);
+		MarkMapped(nx, ny);
 	}
 
 	return true;
@@ -1728,6 +1743,18 @@ Simulation::GetNormalResult Simulation::get_normal_interp(Sim &sim, int pt, floa
 template
 Simulation::GetNormalResult Simulation::get_normal_interp<false, const Simulation>(const Simulation &sim, int pt, float x0, float y0, float dx, float dy);
 
+// Events of particles updated on a worker of a tiled update are replayed in tile order once the
+// phase is over, so that the event stream does not depend on which thread got to a tile first.
+static void recordOscEvent(TPTOscClient &oscClient, OscEventKind kind, int t, int x, int y, float temp)
+{
+	if (auto *tile = UpdateTile::Current())
+	{
+		tile->oscEvents.push_back({ kind, t, x, y, temp });
+		return;
+	}
+	oscClient.RecordEvent(kind, t, x, y, temp);
+}
+
 void Simulation::kill_part(int i)//kills particle number i ASDFGHJ
 {
 	if (i < 0 || i >= NPART)
@@ -1757,10 +1784,27 @@ void Simulation::kill_part(int i)//kills particle number i ASDFGHJ
 	// This shouldn't happen but ... you never know?
 	if (t == PT_NONE)
 		return;
+	WakeTiles(x, y, x, y);
 
-	elementCount[t]--;
+	if (oscClient && oscClient->WantsEvent(OscEventKill, t))
+	{
+		recordOscEvent(*oscClient, OscEventKill, t, x, y, parts[i].temp);
+	}
 
+	if (mapTracker)
+	{
+		mapTracker->MarkDirtyParticle(i);
+		mapTracker->SetLive(i, false);
+	}
 	parts[i].type = PT_NONE;
+	if (auto *tile = UpdateTile::Current())
+	{
+		tile->elementCount[t]--;
+		tile->numParts -= 1;
+		tile->released.push_back(i);
+		return;
+	}
+	elementCount[t]--;
 	parts[i].life = pfree;
 	pfree = i;
 	NUM_PARTS -= 1;
@@ -1772,6 +1816,7 @@ bool Simulation::part_change_type(int i, int x, int y, int t)
 {
 	if (x<0 || y<0 || x>=XRES || y>=YRES || i>=NPART || t<0 || t>=PT_NUM || !parts[i].type)
 		return false;
+	WakeTiles(x, y, x, y);
 
 	auto &sd = SimulationData::CRef();
 	auto &elements = sd.elements;
@@ -1786,8 +1831,16 @@ bool Simulation::part_change_type(int i, int x, int y, int t)
 			return false;
 	}
 
-	if (parts[i].type == PT_VINE || parts[i].type == PT_PLNT){
-		oscClient->KillPlant(y);
+	if (oscClient)
+	{
+		if (oscClient->WantsEvent(OscEventChangeFrom, parts[i].type))
+		{
+			recordOscEvent(*oscClient, OscEventChangeFrom, parts[i].type, x, y, parts[i].temp);
+		}
+		if (oscClient->WantsEvent(OscEventChangeTo, t))
+		{
+			recordOscEvent(*oscClient, OscEventChangeTo, t, x, y, parts[i].temp);
+		}
 	}
 
 	if (elements[parts[i].type].ChangeType)
@@ -1795,9 +1848,18 @@ bool Simulation::part_change_type(int i, int x, int y, int t)
 	if (elements[t].ChangeType)
 		(*(elements[t].ChangeType))(this, i, x, y, parts[i].type, t);
 
-	if (parts[i].type > 0 && parts[i].type < PT_NUM && elementCount[parts[i].type])
-		elementCount[parts[i].type]--;
-	elementCount[t]++;
+	if (auto *tile = UpdateTile::Current())
+	{
+		if (parts[i].type > 0 && parts[i].type < PT_NUM && elementCount[parts[i].type] + tile->elementCount[parts[i].type])
+			tile->elementCount[parts[i].type]--;
+		tile->elementCount[t]++;
+	}
+	else
+	{
+		if (parts[i].type > 0 && parts[i].type < PT_NUM && elementCount[parts[i].type])
+			elementCount[parts[i].type]--;
+		elementCount[t]++;
+	}
 
 	parts[i].type = t;
 	if (elements[t].Properties & TYPE_ENERGY)
@@ -1812,6 +1874,7 @@ bool Simulation::part_change_type(int i, int x, int y, int t)
 		if (photons[y][x] && ID(photons[y][x]) == i)
 			photons[y][x] = 0;
 	}
+	MarkMapped(x, y);
 	return false;
 }
 
@@ -1825,6 +1888,7 @@ int Simulation::create_part(int p, int x, int y, int t, int v)  //ASDFGHJ
 	auto &elements = sd.elements;
 	if (x<0 || y<0 || x>=XRES || y>=YRES || t<=0 || t>=PT_NUM || !elements[t].Enabled)
 		return -1;
+	WakeTiles(x, y, x, y);
 
 	if (t == PT_SPRK && p != -3 && !(p == -2 && elements[TYP(pmap[y][x])].CtypeDraw))
 	{
@@ -1887,11 +1951,20 @@ int Simulation::create_part(int p, int x, int y, int t, int v)  //ASDFGHJ
 				return -1;
 			}
 		}
-		if (pfree == -1)
-			return -1;
-		i = pfree;
-		pfree = parts[i].life;
-		NUM_PARTS += 1;
+		if (auto *tile = UpdateTile::Current())
+		{
+			i = tile->AllocateId();
+			if (i == -1)
+				return -1;
+		}
+		else
+		{
+			if (pfree == -1)
+				return -1;
+			i = pfree;
+			pfree = parts[i].life;
+			NUM_PARTS += 1;
+		}
 	}
 	else
 	{
@@ -1907,12 +1980,18 @@ int Simulation::create_part(int p, int x, int y, int t, int v)  //ASDFGHJ
 		if (elements[oldType].ChangeType)
 			(*(elements[oldType].ChangeType))(this, p, oldX, oldY, oldType, t);
 		if (oldType)
-			elementCount[oldType]--;
+		{
+			if (auto *tile = UpdateTile::Current())
+				tile->elementCount[oldType]--;
+			else
+				elementCount[oldType]--;
+		}
 
 		i = p;
 	}
 
-	if (i>parts.lastActiveIndex) parts.lastActiveIndex = i;
+	// tiles keep track of their own lastActiveIndex, see UpdateTile::AllocateId
+	if (!UpdateTile::Current() && i>parts.lastActiveIndex) parts.lastActiveIndex = i;
 
 	parts[i] = elements[t].DefaultProperties;
 	parts[i].type = t;
@@ -1924,6 +2003,11 @@ int Simulation::create_part(int p, int x, int y, int t, int v)  //ASDFGHJ
 		photons[y][x] = PMAP(i, t);
 	else if (t!=PT_STKM && t!=PT_STKM2 && t!=PT_FIGH)
 		pmap[y][x] = PMAP(i, t);
+	MarkMapped(x, y);
+	if (mapTracker)
+	{
+		mapTracker->SetLive(i, true);
+	}
 
 	//Fancy dust effects for powder types
 	if((elements[t].Properties & TYPE_PART) && pretty_powder)
@@ -1947,10 +2031,14 @@ int Simulation::create_part(int p, int x, int y, int t, int v)  //ASDFGHJ
 	if (elements[t].ChangeType)
 		(*(elements[t].ChangeType))(this, i, x, y, oldType, t);
 
-	elementCount[t]++;
+	if (auto *tile = UpdateTile::Current())
+		tile->elementCount[t]++;
+	else
+		elementCount[t]++;
 	
-	if (t == PT_VINE || t == PT_PLNT){
-		oscClient->NewPlant(y);
+	if (oscClient && oscClient->WantsEvent(OscEventCreate, t))
+	{
+		recordOscEvent(*oscClient, OscEventCreate, t, x, y, parts[i].temp);
 	}
 	return i;
 }
@@ -2216,1065 +2304,1176 @@ bool Simulation::IsHeatInsulator(Particle p) const
 	return SimulationData::CRef().elements[p.type].HeatConduct == 0 || (p.type == PT_HSWC && p.life != 10) || ((p.type == PT_PIPE || p.type == PT_PPIP) && (p.tmp & PFLAG_CAN_CONDUCT) == 0);
 }
 
-void Simulation::UpdateParticles(int start, int end)
+void Simulation::UpdateParticle(int i)
+{
+	ParticleStep step;
+	if (PrepareParticle(i, step) && CallParticleUpdate(i, step))
+	{
+		MoveParticle(i, step);
+	}
+}
+
+void Simulation::DragAir(int i, int t, int x, int y)
+{
+	auto &elements = SimulationData::CRef().elements;
+	//adding to velocity from the particle's velocity
+	vx[y/CELL][x/CELL] = vx[y/CELL][x/CELL]*elements[t].AirLoss + elements[t].AirDrag*parts[i].vx;
+	vy[y/CELL][x/CELL] = vy[y/CELL][x/CELL]*elements[t].AirLoss + elements[t].AirDrag*parts[i].vy;
+}
+
+// Walls, air, gravity, heat and state transitions, everything before the element's own update
+// function. Returns false if the particle needs nothing more this frame.
+bool Simulation::PrepareParticle(int i, ParticleStep &step)
 {
-	//the main particle loop function, goes over all particles.
 	auto &sd = SimulationData::CRef();
 	auto &elements = sd.elements;
-	for (auto i = start; i < end && i <= parts.lastActiveIndex; i++)
+	auto t = parts[i].type;
+	auto x = (int)(parts[i].x+0.5f);
+	auto y = (int)(parts[i].y+0.5f);
+
+	// Kill a particle off screen
+	if (x<CELL || y<CELL || x>=XRES-CELL || y>=YRES-CELL)
 	{
-		if (parts[i].type)
-		{
-			
+		kill_part(i);
+		return false;
+	}
+
+	// Kill a particle in a wall where it isn't supposed to go
+	if (bmap[y/CELL][x/CELL] &&
+	   (bmap[y/CELL][x/CELL]==WL_WALL ||
+	    bmap[y/CELL][x/CELL]==WL_WALLELEC ||
+	    bmap[y/CELL][x/CELL]==WL_ALLOWAIR ||
+	    (bmap[y/CELL][x/CELL]==WL_DESTROYALL) ||
+	    (bmap[y/CELL][x/CELL]==WL_ALLOWLIQUID && !(elements[t].Properties&TYPE_LIQUID)) ||
+	    (bmap[y/CELL][x/CELL]==WL_ALLOWPOWDER && !(elements[t].Properties&TYPE_PART)) ||
+	    (bmap[y/CELL][x/CELL]==WL_ALLOWGAS && !(elements[t].Properties&TYPE_GAS)) || //&& elements[t].Falldown!=0 && parts[i].type!=PT_FIRE && parts[i].type!=PT_SMKE && parts[i].type!=PT_CFLM) ||
+	            (bmap[y/CELL][x/CELL]==WL_ALLOWENERGY && !(elements[t].Properties&TYPE_ENERGY)) ||
+	    (bmap[y/CELL][x/CELL]==WL_EWALL && !emap[y/CELL][x/CELL])) && (t!=PT_STKM) && (t!=PT_STKM2) && (t!=PT_FIGH))
+	{
+		kill_part(i);
+		return false;
+	}
 
+	// Make sure that STASIS'd particles don't tick.
+	if (bmap[y/CELL][x/CELL] == WL_STASIS && emap[y/CELL][x/CELL]<8) {
+		return false;
+	}
 
-			debug_mostRecentlyUpdated = i;
-			auto t = parts[i].type;
+	if (bmap[y/CELL][x/CELL]==WL_DETECT && emap[y/CELL][x/CELL]<8)
+		set_emap(x/CELL, y/CELL);
 
-			auto x = (int)(parts[i].x+0.5f);
-			auto y = (int)(parts[i].y+0.5f);
+	DragAir(i, t, x, y);
 
-			// Kill a particle off screen
-			if (x<CELL || y<CELL || x>=XRES-CELL || y>=YRES-CELL)
+	if (elements[t].HotAir)
+	{
+		if (t==PT_GAS||t==PT_NBLE)
+		{
+			if (pv[y/CELL][x/CELL]<3.5f)
+				pv[y/CELL][x/CELL] += elements[t].HotAir*(3.5f-pv[y/CELL][x/CELL]);
+			if (y+CELL<YRES && pv[y/CELL+1][x/CELL]<3.5f)
+				pv[y/CELL+1][x/CELL] += elements[t].HotAir*(3.5f-pv[y/CELL+1][x/CELL]);
+			if (x+CELL<XRES)
 			{
-				kill_part(i);
-				continue;
+				if (pv[y/CELL][x/CELL+1]<3.5f)
+					pv[y/CELL][x/CELL+1] += elements[t].HotAir*(3.5f-pv[y/CELL][x/CELL+1]);
+				if (y+CELL<YRES && pv[y/CELL+1][x/CELL+1]<3.5f)
+					pv[y/CELL+1][x/CELL+1] += elements[t].HotAir*(3.5f-pv[y/CELL+1][x/CELL+1]);
 			}
-
-			// Kill a particle in a wall where it isn't supposed to go
-			if (bmap[y/CELL][x/CELL] &&
-			   (bmap[y/CELL][x/CELL]==WL_WALL ||
-			    bmap[y/CELL][x/CELL]==WL_WALLELEC ||
-			    bmap[y/CELL][x/CELL]==WL_ALLOWAIR ||
-			    (bmap[y/CELL][x/CELL]==WL_DESTROYALL) ||
-			    (bmap[y/CELL][x/CELL]==WL_ALLOWLIQUID && !(elements[t].Properties&TYPE_LIQUID)) ||
-			    (bmap[y/CELL][x/CELL]==WL_ALLOWPOWDER && !(elements[t].Properties&TYPE_PART)) ||
-			    (bmap[y/CELL][x/CELL]==WL_ALLOWGAS && !(elements[t].Properties&TYPE_GAS)) || //&& elements[t].Falldown!=0 && parts[i].type!=PT_FIRE && parts[i].type!=PT_SMKE && parts[i].type!=PT_CFLM) ||
-			            (bmap[y/CELL][x/CELL]==WL_ALLOWENERGY && !(elements[t].Properties&TYPE_ENERGY)) ||
-			    (bmap[y/CELL][x/CELL]==WL_EWALL && !emap[y/CELL][x/CELL])) && (t!=PT_STKM) && (t!=PT_STKM2) && (t!=PT_FIGH))
+		}
+		else//add the hotair variable to the pressure map, like black hole, or white hole.
+		{
+			pv[y/CELL][x/CELL] += elements[t].HotAir;
+			if (y+CELL<YRES)
+				pv[y/CELL+1][x/CELL] += elements[t].HotAir;
+			if (x+CELL<XRES)
 			{
-				kill_part(i);
-				continue;
+				pv[y/CELL][x/CELL+1] += elements[t].HotAir;
+				if (y+CELL<YRES)
+					pv[y/CELL+1][x/CELL+1] += elements[t].HotAir;
 			}
+		}
+	}
+
+	float pGravX = 0, pGravY = 0;
+	if (!(elements[t].Properties & TYPE_SOLID) && (elements[t].Gravity || elements[t].NewtonianGravity))
+	{
+		GetGravityField(x, y, elements[t].Gravity, elements[t].NewtonianGravity, pGravX, pGravY);
+	}
+
+	//velocity updates for the particle
+	if (t != PT_SPNG || !(parts[i].flags&FLAG_MOVABLE))
+	{
+		parts[i].vx *= elements[t].Loss;
+		parts[i].vy *= elements[t].Loss;
+	}
+	//particle gets velocity from the vx and vy maps
+	parts[i].vx += elements[t].Advection*vx[y/CELL][x/CELL] + pGravX;
+	parts[i].vy += elements[t].Advection*vy[y/CELL][x/CELL] + pGravY;
 
-			// Make sure that STASIS'd particles don't tick.
-			if (bmap[y/CELL][x/CELL] == WL_STASIS && emap[y/CELL][x/CELL]<8) {
-				continue;
-			}
 
-			if (bmap[y/CELL][x/CELL]==WL_DETECT && emap[y/CELL][x/CELL]<8)
-				set_emap(x/CELL, y/CELL);
+	if (elements[t].Diffusion)//the random diffusion that gasses have
+	{
+		parts[i].vx += elements[t].Diffusion*(2.0f*rng.uniform01()-1.0f);
+		parts[i].vy += elements[t].Diffusion*(2.0f*rng.uniform01()-1.0f);
+	}
 
-			//adding to velocity from the particle's velocity
-			vx[y/CELL][x/CELL] = vx[y/CELL][x/CELL]*elements[t].AirLoss + elements[t].AirDrag*parts[i].vx;
-			vy[y/CELL][x/CELL] = vy[y/CELL][x/CELL]*elements[t].AirLoss + elements[t].AirDrag*parts[i].vy;
+	auto transitionOccurred = false;
 
-			if (elements[t].HotAir)
+	int surround[8];
+	auto surround_space = 0;
+	auto nt = 0; //if nt is greater than 1 after this, then there is a particle around the current particle, that is NOT the current particle's type, for water movement.
+	{
+		auto j = 0;
+		for (auto nx=-1; nx<2; nx++)
+		{
+			for (auto ny=-1; ny<2; ny++)
 			{
-				if (t==PT_GAS||t==PT_NBLE)
+				if (nx||ny)
 				{
-					if (pv[y/CELL][x/CELL]<3.5f)
-						pv[y/CELL][x/CELL] += elements[t].HotAir*(3.5f-pv[y/CELL][x/CELL]);
-					if (y+CELL<YRES && pv[y/CELL+1][x/CELL]<3.5f)
-						pv[y/CELL+1][x/CELL] += elements[t].HotAir*(3.5f-pv[y/CELL+1][x/CELL]);
-					if (x+CELL<XRES)
-					{
-						if (pv[y/CELL][x/CELL+1]<3.5f)
-							pv[y/CELL][x/CELL+1] += elements[t].HotAir*(3.5f-pv[y/CELL][x/CELL+1]);
-						if (y+CELL<YRES && pv[y/CELL+1][x/CELL+1]<3.5f)
-							pv[y/CELL+1][x/CELL+1] += elements[t].HotAir*(3.5f-pv[y/CELL+1][x/CELL+1]);
-					}
+					auto r = pmap[y+ny][x+nx];
+					surround[j] = r;
+					j++;
+					surround_space += (!TYP(r)); // count empty space
+					nt += (TYP(r)!=t); // count empty space and particles of different type
 				}
-				else//add the hotair variable to the pressure map, like black hole, or white hole.
+			}
+		}
+	}
+
+	float gel_scale = 1.0f;
+	if (t==PT_GEL)
+		gel_scale = parts[i].tmp*2.55f;
+
+	if (!legacy_enable)
+	{
+		if ((elements[t].Properties&TYPE_LIQUID) && (t!=PT_GEL || gel_scale > (1 + rng.between(0, 254))))
+		{
+			float convGravX, convGravY;
+			GetGravityField(x, y, -2.0f, -2.0f, convGravX, convGravY);
+			auto offsetX = std::clamp(int(std::round(convGravX + x)), x-1, x+1);
+			auto offsetY = std::clamp(int(std::round(convGravY + y)), y-1, y+1);
+			// Some heat convection for liquids
+			if (offsetX != x || offsetY != y)
+			{
+				auto r = pmap[offsetY][offsetX];
+				if (r && parts[i].type == TYP(r))
 				{
-					pv[y/CELL][x/CELL] += elements[t].HotAir;
-					if (y+CELL<YRES)
-						pv[y/CELL+1][x/CELL] += elements[t].HotAir;
-					if (x+CELL<XRES)
+					if (parts[i].temp>parts[ID(r)].temp)
 					{
-						pv[y/CELL][x/CELL+1] += elements[t].HotAir;
-						if (y+CELL<YRES)
-							pv[y/CELL+1][x/CELL+1] += elements[t].HotAir;
+						auto swappage = parts[i].temp;
+						parts[i].temp = parts[ID(r)].temp;
+						parts[ID(r)].temp = swappage;
 					}
 				}
 			}
+		}
 
-			float pGravX = 0, pGravY = 0;
-			if (!(elements[t].Properties & TYPE_SOLID) && (elements[t].Gravity || elements[t].NewtonianGravity))
-			{
-				GetGravityField(x, y, elements[t].Gravity, elements[t].NewtonianGravity, pGravX, pGravY);
-			}
+		//heat transfer code
+		auto h_count = 0;
+		bool cond;
+		cond = t && !IsHeatInsulator(parts[i]) && rng.chance(int(elements[t].HeatConduct*gel_scale), 250);
 
-			//velocity updates for the particle
-			if (t != PT_SPNG || !(parts[i].flags&FLAG_MOVABLE))
+		if (cond)
+		{
+			if (aheat_enable && !(elements[t].Properties&PROP_NOAMBHEAT))
 			{
-				parts[i].vx *= elements[t].Loss;
-				parts[i].vy *= elements[t].Loss;
+				auto c_heat = (hv[y/CELL][x/CELL]-parts[i].temp)*0.04;
+				c_heat = restrict_flt(c_heat, -MAX_TEMP+MIN_TEMP, MAX_TEMP-MIN_TEMP);
+				parts[i].temp += c_heat;
+				hv[y/CELL][x/CELL] -= c_heat;
 			}
-			//particle gets velocity from the vx and vy maps
-			parts[i].vx += elements[t].Advection*vx[y/CELL][x/CELL] + pGravX;
-			parts[i].vy += elements[t].Advection*vy[y/CELL][x/CELL] + pGravY;
+			auto c_heat = 0.0f;
+			int surround_hconduct[8];
+			for (auto j=0; j<8; j++)
+			{
+				surround_hconduct[j] = i;
+				auto r = surround[j];
 
+				if (!r)
+					continue;
 
-			if (elements[t].Diffusion)//the random diffusion that gasses have
-			{
-				parts[i].vx += elements[t].Diffusion*(2.0f*rng.uniform01()-1.0f);
-				parts[i].vy += elements[t].Diffusion*(2.0f*rng.uniform01()-1.0f);
-			}
+				auto rt = TYP(r);
 
-			auto transitionOccurred = false;
+				if (!rt || IsHeatInsulator(parts[ID(r)])
+				        || (t == PT_FILT && (rt == PT_BRAY || rt == PT_BIZR || rt == PT_BIZRG))
+				        || (rt == PT_FILT && (t == PT_BRAY || t == PT_PHOT || t == PT_BIZR || t == PT_BIZRG))
+				        || (t == PT_ELEC && rt == PT_DEUT)
+				        || (t == PT_DEUT && rt == PT_ELEC)
+				        || (t == PT_HSWC && rt == PT_FILT && parts[i].tmp == 1)
+				        || (t == PT_FILT && rt == PT_HSWC && parts[ID(r)].tmp == 1))
+					continue;
 
-			int surround[8];
-			auto surround_space = 0;
-			auto nt = 0; //if nt is greater than 1 after this, then there is a particle around the current particle, that is NOT the current particle's type, for water movement.
-			{
-				auto j = 0;
-				for (auto nx=-1; nx<2; nx++)
+				surround_hconduct[j] = ID(r);
+				c_heat += parts[ID(r)].temp;
+
+				if ((rt == PT_PIPE || rt == PT_PPIP) && parts[ID(r)].ctype != 0)
 				{
-					for (auto ny=-1; ny<2; ny++)
-					{
-						if (nx||ny)
-						{
-							auto r = pmap[y+ny][x+nx];
-							surround[j] = r;
-							j++;
-							surround_space += (!TYP(r)); // count empty space
-							nt += (TYP(r)!=t); // count empty space and particles of different type
-						}
-					}
+					c_heat += parts[ID(r)].temp; // double count the particle to account for the heat capacity of both the PIPE/PPIP and its contents
 				}
-			}
 
-			float gel_scale = 1.0f;
-			if (t==PT_GEL)
-				gel_scale = parts[i].tmp*2.55f;
+				h_count++;
 
-			if (!legacy_enable)
-			{
-				if ((elements[t].Properties&TYPE_LIQUID) && (t!=PT_GEL || gel_scale > (1 + rng.between(0, 254))))
+				if ((rt == PT_PIPE || rt == PT_PPIP) && parts[ID(r)].ctype != 0)
 				{
-					float convGravX, convGravY;
-					GetGravityField(x, y, -2.0f, -2.0f, convGravX, convGravY);
-					auto offsetX = std::clamp(int(std::round(convGravX + x)), x-1, x+1);
-					auto offsetY = std::clamp(int(std::round(convGravY + y)), y-1, y+1);
-					// Some heat convection for liquids
-					if (offsetX != x || offsetY != y)
-					{
-						auto r = pmap[offsetY][offsetX];
-						if (r && parts[i].type == TYP(r))
-						{
-							if (parts[i].temp>parts[ID(r)].temp)
-							{
-								auto swappage = parts[i].temp;
-								parts[i].temp = parts[ID(r)].temp;
-								parts[ID(r)].temp = swappage;
-							}
-						}
-					}
+					h_count++; // double count the particle to account for the heat capacity of both the PIPE/PPIP and its contents
 				}
+			}
+			float pt = R_TEMP;
+
+			if ((t == PT_PIPE || t == PT_PPIP) && parts[i].ctype != 0)
+				pt = (c_heat+parts[i].temp*2.0f)/(h_count+2); // double count the particle to account for the heat capacity of both the PIPE/PPIP and its contents
+			else
+				pt = (c_heat+parts[i].temp)/(h_count+1);
 
-				//heat transfer code
-				auto h_count = 0;
-				bool cond;
-				cond = t && !IsHeatInsulator(parts[i]) && rng.chance(int(elements[t].HeatConduct*gel_scale), 250);
+			pt = parts[i].temp = restrict_flt(pt, MIN_TEMP, MAX_TEMP);
+			for (auto j=0; j<8; j++)
+			{
+				parts[surround_hconduct[j]].temp = pt;
+			}
 
-				if (cond)
+			auto ctemph = pt;
+			auto ctempl = pt;
+			// change boiling point with pressure
+			if (((elements[t].Properties&TYPE_LIQUID) && sd.IsElementOrNone(elements[t].HighTemperatureTransition) && (elements[elements[t].HighTemperatureTransition].Properties&TYPE_GAS))
+			        || t==PT_LNTG || t==PT_SLTW)
+				ctemph -= 2.0f*pv[y/CELL][x/CELL];
+			else if (((elements[t].Properties&TYPE_GAS) && sd.IsElementOrNone(elements[t].LowTemperatureTransition) && (elements[elements[t].LowTemperatureTransition].Properties&TYPE_LIQUID))
+			         || t==PT_WTRV)
+				ctempl -= 2.0f*pv[y/CELL][x/CELL];
+			auto s = 1;
+
+			//A fix for ice with ctype = 0
+			if ((t==PT_ICEI || t==PT_SNOW) && (!sd.IsElement(parts[i].ctype) || parts[i].ctype==PT_ICEI || parts[i].ctype==PT_SNOW))
+				parts[i].ctype = PT_WATR;
+
+			if (elements[t].HighTemperatureTransition != NT && ctemph>=elements[t].HighTemperature)
+			{
+				// particle type change due to high temperature
+				if (elements[t].HighTemperatureTransition != ST)
 				{
-					if (aheat_enable && !(elements[t].Properties&PROP_NOAMBHEAT))
-					{
-						auto c_heat = (hv[y/CELL][x/CELL]-parts[i].temp)*0.04;
-						c_heat = restrict_flt(c_heat, -MAX_TEMP+MIN_TEMP, MAX_TEMP-MIN_TEMP);
-						parts[i].temp += c_heat;
-						hv[y/CELL][x/CELL] -= c_heat;
-					}
-					auto c_heat = 0.0f;
-					int surround_hconduct[8];
-					for (auto j=0; j<8; j++)
+					t = elements[t].HighTemperatureTransition;
+				}
+				else if (t == PT_ICEI || t == PT_SNOW)
+				{
+					if (parts[i].ctype > 0 && parts[i].ctype < PT_NUM && parts[i].ctype != t)
 					{
-						surround_hconduct[j] = i;
-						auto r = surround[j];
-
-						if (!r)
-							continue;
-
-						auto rt = TYP(r);
-
-						if (!rt || IsHeatInsulator(parts[ID(r)])
-						        || (t == PT_FILT && (rt == PT_BRAY || rt == PT_BIZR || rt == PT_BIZRG))
-						        || (rt == PT_FILT && (t == PT_BRAY || t == PT_PHOT || t == PT_BIZR || t == PT_BIZRG))
-						        || (t == PT_ELEC && rt == PT_DEUT)
-						        || (t == PT_DEUT && rt == PT_ELEC)
-						        || (t == PT_HSWC && rt == PT_FILT && parts[i].tmp == 1)
-						        || (t == PT_FILT && rt == PT_HSWC && parts[ID(r)].tmp == 1))
-							continue;
-
-						surround_hconduct[j] = ID(r);
-						c_heat += parts[ID(r)].temp;
-
-						if ((rt == PT_PIPE || rt == PT_PPIP) && parts[ID(r)].ctype != 0)
+						if (elements[parts[i].ctype].LowTemperatureTransition==PT_ICEI || elements[parts[i].ctype].LowTemperatureTransition==PT_SNOW)
 						{
-							c_heat += parts[ID(r)].temp; // double count the particle to account for the heat capacity of both the PIPE/PPIP and its contents
+							if (pt<elements[parts[i].ctype].LowTemperature)
+								s = 0;
 						}
+						else if (pt<273.15f)
+							s = 0;
 
-						h_count++;
-
-						if ((rt == PT_PIPE || rt == PT_PPIP) && parts[ID(r)].ctype != 0)
+						if (s)
 						{
-							h_count++; // double count the particle to account for the heat capacity of both the PIPE/PPIP and its contents
+							t = parts[i].ctype;
+							parts[i].ctype = PT_NONE;
+							parts[i].life = 0;
 						}
 					}
-					float pt = R_TEMP;
-
-					if ((t == PT_PIPE || t == PT_PPIP) && parts[i].ctype != 0)
-						pt = (c_heat+parts[i].temp*2.0f)/(h_count+2); // double count the particle to account for the heat capacity of both the PIPE/PPIP and its contents
 					else
-						pt = (c_heat+parts[i].temp)/(h_count+1);
-
-					pt = parts[i].temp = restrict_flt(pt, MIN_TEMP, MAX_TEMP);
-					for (auto j=0; j<8; j++)
-					{
-						parts[surround_hconduct[j]].temp = pt;
-					}
-
-					auto ctemph = pt;
-					auto ctempl = pt;
-					// change boiling point with pressure
-					if (((elements[t].Properties&TYPE_LIQUID) && sd.IsElementOrNone(elements[t].HighTemperatureTransition) && (elements[elements[t].HighTemperatureTransition].Properties&TYPE_GAS))
-					        || t==PT_LNTG || t==PT_SLTW)
-						ctemph -= 2.0f*pv[y/CELL][x/CELL];
-					else if (((elements[t].Properties&TYPE_GAS) && sd.IsElementOrNone(elements[t].LowTemperatureTransition) && (elements[elements[t].LowTemperatureTransition].Properties&TYPE_LIQUID))
-					         || t==PT_WTRV)
-						ctempl -= 2.0f*pv[y/CELL][x/CELL];
-					auto s = 1;
-
-					//A fix for ice with ctype = 0
-					if ((t==PT_ICEI || t==PT_SNOW) && (!sd.IsElement(parts[i].ctype) || parts[i].ctype==PT_ICEI || parts[i].ctype==PT_SNOW))
-						parts[i].ctype = PT_WATR;
-
-					if (elements[t].HighTemperatureTransition != NT && ctemph>=elements[t].HighTemperature)
+						s = 0;
+				}
+				else if (t == PT_SLTW)
+				{
+					t = rng.chance(1, 4) ? PT_SALT : PT_WTRV;
+				}
+				else if (t == PT_BRMT)
+				{
+					if (parts[i].ctype == PT_TUNG)
 					{
-						// particle type change due to high temperature
-						if (elements[t].HighTemperatureTransition != ST)
-						{
-							t = elements[t].HighTemperatureTransition;
-						}
-						else if (t == PT_ICEI || t == PT_SNOW)
-						{
-							if (parts[i].ctype > 0 && parts[i].ctype < PT_NUM && parts[i].ctype != t)
-							{
-								if (elements[parts[i].ctype].LowTemperatureTransition==PT_ICEI || elements[parts[i].ctype].LowTemperatureTransition==PT_SNOW)
-								{
-									if (pt<elements[parts[i].ctype].LowTemperature)
-										s = 0;
-								}
-								else if (pt<273.15f)
-									s = 0;
-
-								if (s)
-								{
-									t = parts[i].ctype;
-									parts[i].ctype = PT_NONE;
-									parts[i].life = 0;
-								}
-							}
-							else
-								s = 0;
-						}
-						else if (t == PT_SLTW)
+						if (ctemph < elements[parts[i].ctype].HighTemperature)
+							s = 0;
+						else
 						{
-							t = rng.chance(1, 4) ? PT_SALT : PT_WTRV;
+							t = PT_LAVA;
+							parts[i].type = PT_TUNG;
 						}
-						else if (t == PT_BRMT)
+					}
+					else if (ctemph >= elements[t].HighTemperature)
+						t = PT_LAVA;
+					else
+						s = 0;
+				}
+				else if (t == PT_CRMC)
+				{
+					float pres = std::max((pv[y/CELL][x/CELL]+pv[(y-2)/CELL][x/CELL]+pv[(y+2)/CELL][x/CELL]+pv[y/CELL][(x-2)/CELL]+pv[y/CELL][(x+2)/CELL])*2.0f, 0.0f);
+					if (ctemph < pres+elements[PT_CRMC].HighTemperature)
+						s = 0;
+					else
+						t = PT_LAVA;
+				}
+				else
+					s = 0;
+			}
+			else if (elements[t].LowTemperatureTransition != NT && ctempl<elements[t].LowTemperature)
+			{
+				// particle type change due to low temperature
+				if (elements[t].LowTemperatureTransition != ST)
+				{
+					t = elements[t].LowTemperatureTransition;
+				}
+				else if (t == PT_WTRV)
+				{
+					t = (pt < 273.0f) ? PT_RIME : PT_DSTW;
+				}
+				else if (t == PT_LAVA)
+				{
+					if (parts[i].ctype > 0 && parts[i].ctype < PT_NUM && parts[i].ctype != PT_LAVA && elements[parts[i].ctype].Enabled)
+					{
+						if (parts[i].ctype == PT_THRM && pt >= elements[PT_BMTL].HighTemperature)
+							s = 0;
+						else if ((parts[i].ctype == PT_VIBR || parts[i].ctype == PT_BVBR) && pt >= 273.15f)
+							s = 0;
+						else if (parts[i].ctype == PT_TUNG)
 						{
-							if (parts[i].ctype == PT_TUNG)
-							{
-								if (ctemph < elements[parts[i].ctype].HighTemperature)
-									s = 0;
-								else
-								{
-									t = PT_LAVA;
-									parts[i].type = PT_TUNG;
-								}
-							}
-							else if (ctemph >= elements[t].HighTemperature)
-								t = PT_LAVA;
-							else
+							// TUNG does its own melting in its update function, so HighTemperatureTransition is not LAVA so it won't be handled by the code for HighTemperatureTransition==PT_LAVA below
+							// However, the threshold is stored in HighTemperature to allow it to be changed from Lua
+							if (pt >= elements[parts[i].ctype].HighTemperature)
 								s = 0;
 						}
-						else if (t == PT_CRMC)
+						else if (parts[i].ctype == PT_CRMC)
 						{
 							float pres = std::max((pv[y/CELL][x/CELL]+pv[(y-2)/CELL][x/CELL]+pv[(y+2)/CELL][x/CELL]+pv[y/CELL][(x-2)/CELL]+pv[y/CELL][(x+2)/CELL])*2.0f, 0.0f);
-							if (ctemph < pres+elements[PT_CRMC].HighTemperature)
+							if (ctemph >= pres+elements[PT_CRMC].HighTemperature)
 								s = 0;
-							else
-								t = PT_LAVA;
-						}
-						else
-							s = 0;
-					}
-					else if (elements[t].LowTemperatureTransition != NT && ctempl<elements[t].LowTemperature)
-					{
-						// particle type change due to low temperature
-						if (elements[t].LowTemperatureTransition != ST)
-						{
-							t = elements[t].LowTemperatureTransition;
 						}
-						else if (t == PT_WTRV)
+						else if (elements[parts[i].ctype].HighTemperatureTransition == PT_LAVA || parts[i].ctype == PT_HEAC)
 						{
-							t = (pt < 273.0f) ? PT_RIME : PT_DSTW;
+							if (pt >= elements[parts[i].ctype].HighTemperature)
+								s = 0;
 						}
-						else if (t == PT_LAVA)
+						else if (pt>=973.0f)
+							s = 0; // freezing point for lava with any other (not listed in ptransitions as turning into lava) ctype
+						if (s)
 						{
-							if (parts[i].ctype > 0 && parts[i].ctype < PT_NUM && parts[i].ctype != PT_LAVA && elements[parts[i].ctype].Enabled)
+							t = parts[i].ctype;
+							parts[i].ctype = PT_NONE;
+							if (t == PT_THRM)
 							{
-								if (parts[i].ctype == PT_THRM && pt >= elements[PT_BMTL].HighTemperature)
-									s = 0;
-								else if ((parts[i].ctype == PT_VIBR || parts[i].ctype == PT_BVBR) && pt >= 273.15f)
-									s = 0;
-								else if (parts[i].ctype == PT_TUNG)
-								{
-									// TUNG does its own melting in its update function, so HighTemperatureTransition is not LAVA so it won't be handled by the code for HighTemperatureTransition==PT_LAVA below
-									// However, the threshold is stored in HighTemperature to allow it to be changed from Lua
-									if (pt >= elements[parts[i].ctype].HighTemperature)
-										s = 0;
-								}
-								else if (parts[i].ctype == PT_CRMC)
-								{
-									float pres = std::max((pv[y/CELL][x/CELL]+pv[(y-2)/CELL][x/CELL]+pv[(y+2)/CELL][x/CELL]+pv[y/CELL][(x-2)/CELL]+pv[y/CELL][(x+2)/CELL])*2.0f, 0.0f);
-									if (ctemph >= pres+elements[PT_CRMC].HighTemperature)
-										s = 0;
-								}
-								else if (elements[parts[i].ctype].HighTemperatureTransition == PT_LAVA || parts[i].ctype == PT_HEAC)
-								{
-									if (pt >= elements[parts[i].ctype].HighTemperature)
-										s = 0;
-								}
-								else if (pt>=973.0f)
-									s = 0; // freezing point for lava with any other (not listed in ptransitions as turning into lava) ctype
-								if (s)
-								{
-									t = parts[i].ctype;
-									parts[i].ctype = PT_NONE;
-									if (t == PT_THRM)
-									{
-										parts[i].tmp = 0;
-										t = PT_BMTL;
-									}
-									if (t == PT_PLUT)
-									{
-										parts[i].tmp = 0;
-										t = PT_LAVA;
-									}
-								}
+								parts[i].tmp = 0;
+								t = PT_BMTL;
+							}
+							if (t == PT_PLUT)
+							{
+								parts[i].tmp = 0;
+								t = PT_LAVA;
 							}
-							else if (pt<973.0f)
-								t = PT_STNE;
-							else
-								s = 0;
 						}
-						else
-							s = 0;
 					}
+					else if (pt<973.0f)
+						t = PT_STNE;
 					else
 						s = 0;
+				}
+				else
+					s = 0;
+			}
+			else
+				s = 0;
 
-					if (s) // particle type change occurred
-					{
-						if (t==PT_ICEI || t==PT_LAVA || t==PT_SNOW)
-							parts[i].ctype = parts[i].type;
-						if (!(t==PT_ICEI && parts[i].ctype==PT_FRZW))
-							parts[i].life = 0;
-						if (t == PT_FIRE)
-						{
-							//hackish, if tmp isn't 0 the FIRE might turn into DSTW later
-							//idealy transitions should use create_part(i) but some elements rely on properties staying constant
-							//and I don't feel like checking each one right now
-							parts[i].tmp = 0;
-						}
-						if ((elements[t].Properties&TYPE_GAS) && !(elements[parts[i].type].Properties&TYPE_GAS))
-							pv[y/CELL][x/CELL] += 0.50f;
-
-						if (t == PT_NONE)
-						{
-							kill_part(i);
-							goto killed;
-						}
-						// part_change_type could refuse to change the type and kill the particle
-						// for example, changing type to STKM but one already exists
-						// we need to account for that to not cause simulation corruption issues
-						if (part_change_type(i,x,y,t))
-							goto killed;
-
-						if (t==PT_FIRE || t==PT_PLSM || t==PT_CFLM)
-							parts[i].life = rng.between(120, 169);
-						if (t == PT_LAVA)
-						{
-							if (parts[i].ctype == PT_BRMT) parts[i].ctype = PT_BMTL;
-							else if (parts[i].ctype == PT_SAND) parts[i].ctype = PT_GLAS;
-							else if (parts[i].ctype == PT_BGLA) parts[i].ctype = PT_GLAS;
-							else if (parts[i].ctype == PT_PQRT) parts[i].ctype = PT_QRTZ;
-							else if (parts[i].ctype == PT_LITH && parts[i].tmp2 > 3) parts[i].ctype = PT_GLAS;
-							parts[i].life = rng.between(240, 359);
-						}
-						transitionOccurred = true;
-					}
+			if (s) // particle type change occurred
+			{
+				if (t==PT_ICEI || t==PT_LAVA || t==PT_SNOW)
+					parts[i].ctype = parts[i].type;
+				if (!(t==PT_ICEI && parts[i].ctype==PT_FRZW))
+					parts[i].life = 0;
+				if (t == PT_FIRE)
+				{
+					//hackish, if tmp isn't 0 the FIRE might turn into DSTW later
+					//idealy transitions should use create_part(i) but some elements rely on properties staying constant
+					//and I don't feel like checking each one right now
+					parts[i].tmp = 0;
+				}
+				if ((elements[t].Properties&TYPE_GAS) && !(elements[parts[i].type].Properties&TYPE_GAS))
+					pv[y/CELL][x/CELL] += 0.50f;
 
-					pt = parts[i].temp = restrict_flt(parts[i].temp, MIN_TEMP, MAX_TEMP);
-					if (t == PT_LAVA)
-					{
-						parts[i].life = int(restrict_flt((parts[i].temp-700)/7, 0, 400));
-						if (parts[i].ctype==PT_THRM&&parts[i].tmp>0)
-						{
-							parts[i].tmp--;
-							parts[i].temp = 3500;
-						}
-						if (parts[i].ctype==PT_PLUT&&parts[i].tmp>0)
-						{
-							parts[i].tmp--;
-							parts[i].temp = MAX_TEMP;
-						}
-					}
+				if (t == PT_NONE)
+				{
+					kill_part(i);
+					return false;
 				}
-				else
+				// part_change_type could refuse to change the type and kill the particle
+				// for example, changing type to STKM but one already exists
+				// we need to account for that to not cause simulation corruption issues
+				if (part_change_type(i,x,y,t))
+					return false;
+
+				if (t==PT_FIRE || t==PT_PLSM || t==PT_CFLM)
+					parts[i].life = rng.between(120, 169);
+				if (t == PT_LAVA)
 				{
-					if (!(air->bmap_blockairh[y/CELL][x/CELL]&0x8))
-						air->bmap_blockairh[y/CELL][x/CELL]++;
-					parts[i].temp = restrict_flt(parts[i].temp, MIN_TEMP, MAX_TEMP);
+					if (parts[i].ctype == PT_BRMT) parts[i].ctype = PT_BMTL;
+					else if (parts[i].ctype == PT_SAND) parts[i].ctype = PT_GLAS;
+					else if (parts[i].ctype == PT_BGLA) parts[i].ctype = PT_GLAS;
+					else if (parts[i].ctype == PT_PQRT) parts[i].ctype = PT_QRTZ;
+					else if (parts[i].ctype == PT_LITH && parts[i].tmp2 > 3) parts[i].ctype = PT_GLAS;
+					parts[i].life = rng.between(240, 359);
 				}
+				transitionOccurred = true;
 			}
 
-			if (t==PT_LIFE)
-			{
-				parts[i].temp = restrict_flt(parts[i].temp-50.0f, MIN_TEMP, MAX_TEMP);
-			}
-			if (t==PT_WIRE)
+			pt = parts[i].temp = restrict_flt(parts[i].temp, MIN_TEMP, MAX_TEMP);
+			if (t == PT_LAVA)
 			{
-				//wire_placed = 1;
-			}
-			//spark updates from walls
-			if ((elements[t].Properties&PROP_CONDUCTS) || t==PT_SPRK)
-			{
-				auto nx = x % CELL;
-				if (nx == 0)
-					nx = x/CELL - 1;
-				else if (nx == CELL-1)
-					nx = x/CELL + 1;
-				else
-					nx = x/CELL;
-				auto ny = y % CELL;
-				if (ny == 0)
-					ny = y/CELL - 1;
-				else if (ny == CELL-1)
-					ny = y/CELL + 1;
-				else
-					ny = y/CELL;
-				if (nx>=0 && ny>=0 && nx<XCELLS && ny<YCELLS)
+				parts[i].life = int(restrict_flt((parts[i].temp-700)/7, 0, 400));
+				if (parts[i].ctype==PT_THRM&&parts[i].tmp>0)
 				{
-					if (t!=PT_SPRK)
-					{
-						if (emap[ny][nx]==12 && !parts[i].life && bmap[ny][nx] != WL_STASIS)
-						{
-							part_change_type(i,x,y,PT_SPRK);
-							parts[i].life = 4;
-							parts[i].ctype = t;
-							t = PT_SPRK;
-						}
-					}
-					else if (bmap[ny][nx]==WL_DETECT || bmap[ny][nx]==WL_EWALL || bmap[ny][nx]==WL_ALLOWLIQUID || bmap[ny][nx]==WL_WALLELEC || bmap[ny][nx]==WL_ALLOWALLELEC || bmap[ny][nx]==WL_EHOLE)
-						set_emap(nx, ny);
+					parts[i].tmp--;
+					parts[i].temp = 3500;
+				}
+				if (parts[i].ctype==PT_PLUT&&parts[i].tmp>0)
+				{
+					parts[i].tmp--;
+					parts[i].temp = MAX_TEMP;
 				}
 			}
+		}
+		else
+		{
+			if (!(air->bmap_blockairh[y/CELL][x/CELL]&0x8))
+				air->bmap_blockairh[y/CELL][x/CELL]++;
+			parts[i].temp = restrict_flt(parts[i].temp, MIN_TEMP, MAX_TEMP);
+		}
+	}
 
-			//the basic explosion, from the .explosive variable
-			if ((elements[t].Explosive&2) && pv[y/CELL][x/CELL]>2.5f)
+	if (t==PT_LIFE)
+	{
+		parts[i].temp = restrict_flt(parts[i].temp-50.0f, MIN_TEMP, MAX_TEMP);
+	}
+	if (t==PT_WIRE)
+	{
+		//wire_placed = 1;
+	}
+	//spark updates from walls
+	if ((elements[t].Properties&PROP_CONDUCTS) || t==PT_SPRK)
+	{
+		auto nx = x % CELL;
+		if (nx == 0)
+			nx = x/CELL - 1;
+		else if (nx == CELL-1)
+			nx = x/CELL + 1;
+		else
+			nx = x/CELL;
+		auto ny = y % CELL;
+		if (ny == 0)
+			ny = y/CELL - 1;
+		else if (ny == CELL-1)
+			ny = y/CELL + 1;
+		else
+			ny = y/CELL;
+		if (nx>=0 && ny>=0 && nx<XCELLS && ny<YCELLS)
+		{
+			if (t!=PT_SPRK)
 			{
-				parts[i].life = rng.between(180, 259);
-				parts[i].temp = restrict_flt(elements[PT_FIRE].DefaultProperties.temp + (elements[t].Flammable/2), MIN_TEMP, MAX_TEMP);
-				t = PT_FIRE;
-				part_change_type(i,x,y,t);
-				pv[y/CELL][x/CELL] += 0.25f * CFDS;
+				if (emap[ny][nx]==12 && !parts[i].life && bmap[ny][nx] != WL_STASIS)
+				{
+					part_change_type(i,x,y,PT_SPRK);
+					parts[i].life = 4;
+					parts[i].ctype = t;
+					t = PT_SPRK;
+				}
 			}
+			else if (bmap[ny][nx]==WL_DETECT || bmap[ny][nx]==WL_EWALL || bmap[ny][nx]==WL_ALLOWLIQUID || bmap[ny][nx]==WL_WALLELEC || bmap[ny][nx]==WL_ALLOWALLELEC || bmap[ny][nx]==WL_EHOLE)
+				set_emap(nx, ny);
+		}
+	}
 
-			{
-				auto s = 1;
-				auto gravtot = std::abs(gravOut.forceX[Vec2{ x, y } / CELL]) +
-				               std::abs(gravOut.forceY[Vec2{ x, y } / CELL]);
-				if (elements[t].HighPressureTransition != NT && pv[y/CELL][x/CELL]>elements[t].HighPressure) {
-					// particle type change due to high pressure
-					if (elements[t].HighPressureTransition != ST)
-						t = elements[t].HighPressureTransition;
-					else if (t==PT_BMTL) {
-						if (pv[y/CELL][x/CELL]>2.5f)
-							t = PT_BRMT;
-						else if (pv[y/CELL][x/CELL]>1.0f && parts[i].tmp==1)
-							t = PT_BRMT;
-						else s = 0;
-					}
-					else s = 0;
-				} else if (elements[t].LowPressureTransition != NT && pv[y/CELL][x/CELL]<elements[t].LowPressure && gravtot<=(elements[t].LowPressure/4.0f)) {
-					// particle type change due to low pressure
-					if (elements[t].LowPressureTransition != ST)
-						t = elements[t].LowPressureTransition;
-					else s = 0;
-				} else if (elements[t].HighPressureTransition != NT && gravtot>(elements[t].HighPressure/4.0f)) {
-					// particle type change due to high gravity
-					if (elements[t].HighPressureTransition != ST)
-						t = elements[t].HighPressureTransition;
-					else if (t==PT_BMTL) {
-						if (gravtot>0.625f)
-							t = PT_BRMT;
-						else if (gravtot>0.25f && parts[i].tmp==1)
-							t = PT_BRMT;
-						else s = 0;
-					}
-					else s = 0;
-				} else s = 0;
+	//the basic explosion, from the .explosive variable
+	if ((elements[t].Explosive&2) && pv[y/CELL][x/CELL]>2.5f)
+	{
+		parts[i].life = rng.between(180, 259);
+		parts[i].temp = restrict_flt(elements[PT_FIRE].DefaultProperties.temp + (elements[t].Flammable/2), MIN_TEMP, MAX_TEMP);
+		t = PT_FIRE;
+		part_change_type(i,x,y,t);
+		pv[y/CELL][x/CELL] += 0.25f * CFDS;
+	}
 
-				// particle type change occurred
-				if (s)
-				{
-					if (t == PT_NONE)
-					{
-						kill_part(i);
-						goto killed;
-					}
-					parts[i].life = 0;
-					// part_change_type could refuse to change the type and kill the particle
-					// for example, changing type to STKM but one already exists
-					// we need to account for that to not cause simulation corruption issues
-					if (part_change_type(i,x,y,t))
-						goto killed;
-					if (t == PT_FIRE)
-						parts[i].life = rng.between(120, 169);
-					transitionOccurred = true;
-				}
+	{
+		auto s = 1;
+		auto gravtot = std::abs(gravOut.forceX[Vec2{ x, y } / CELL]) +
+		               std::abs(gravOut.forceY[Vec2{ x, y } / CELL]);
+		if (elements[t].HighPressureTransition != NT && pv[y/CELL][x/CELL]>elements[t].HighPressure) {
+			// particle type change due to high pressure
+			if (elements[t].HighPressureTransition != ST)
+				t = elements[t].HighPressureTransition;
+			else if (t==PT_BMTL) {
+				if (pv[y/CELL][x/CELL]>2.5f)
+					t = PT_BRMT;
+				else if (pv[y/CELL][x/CELL]>1.0f && parts[i].tmp==1)
+					t = PT_BRMT;
+				else s = 0;
+			}
+			else s = 0;
+		} else if (elements[t].LowPressureTransition != NT && pv[y/CELL][x/CELL]<elements[t].LowPressure && gravtot<=(elements[t].LowPressure/4.0f)) {
+			// particle type change due to low pressure
+			if (elements[t].LowPressureTransition != ST)
+				t = elements[t].LowPressureTransition;
+			else s = 0;
+		} else if (elements[t].HighPressureTransition != NT && gravtot>(elements[t].HighPressure/4.0f)) {
+			// particle type change due to high gravity
+			if (elements[t].HighPressureTransition != ST)
+				t = elements[t].HighPressureTransition;
+			else if (t==PT_BMTL) {
+				if (gravtot>0.625f)
+					t = PT_BRMT;
+				else if (gravtot>0.25f && parts[i].tmp==1)
+					t = PT_BRMT;
+				else s = 0;
 			}
+			else s = 0;
+		} else s = 0;
 
-			//call the particle update function, if there is one
-			if (elements[t].Update)
+		// particle type change occurred
+		if (s)
+		{
+			if (t == PT_NONE)
 			{
-				if ((*(elements[t].Update))(this, i, x, y, surround_space, nt, parts, pmap))
-					continue;
-				x = (int)(parts[i].x+0.5f);
-				y = (int)(parts[i].y+0.5f);
+				kill_part(i);
+				return false;
 			}
-			
-			
+			parts[i].life = 0;
+			// part_change_type could refuse to change the type and kill the particle
+			// for example, changing type to STKM but one already exists
+			// we need to account for that to not cause simulation corruption issues
+			if (part_change_type(i,x,y,t))
+				return false;
+			if (t == PT_FIRE)
+				parts[i].life = rng.between(120, 169);
+			transitionOccurred = true;
+		}
+	}
 
-			if(legacy_enable)//if heat sim is off
-				Element::legacyUpdate(this, i,x,y,surround_space,nt, parts, pmap);
+	step.x = x;
+	step.y = y;
+	step.t = t;
+	step.surround_space = surround_space;
+	step.nt = nt;
+	step.pGravX = pGravX;
+	step.pGravY = pGravY;
+	step.transitionOccurred = transitionOccurred;
+	return true;
+}
 
-killed:
-			if (parts[i].type == PT_NONE)//if its dead, skip to next particle
-				continue;
+// Calls the element's update function. Returns false if the particle does not move this frame.
+bool Simulation::CallParticleUpdate(int i, ParticleStep &step)
+{
+	auto &sd = SimulationData::CRef();
+	auto &elements = sd.elements;
+	auto x = step.x;
+	auto y = step.y;
+	auto t = step.t;
+	auto surround_space = step.surround_space;
+	auto nt = step.nt;
+
+	//call the particle update function, if there is one
+	if (elements[t].Update)
+	{
+		if ((*(elements[t].Update))(this, i, x, y, surround_space, nt, parts, pmap))
+			return false;
+		x = (int)(parts[i].x+0.5f);
+		y = (int)(parts[i].y+0.5f);
+	}
 
-			if (transitionOccurred)
-				continue;
 
-			if (!parts[i].vx&&!parts[i].vy)//if its not moving, skip to next particle, movement code it next
-				continue;
 
-			int fin_x, fin_y, clear_x, clear_y;
-			float fin_xf, fin_yf, clear_xf, clear_yf;
-			{
-				auto mr = PlanMove<true>(*this, i, x, y);
-				fin_x    = mr.fin_x;
-				fin_y    = mr.fin_y;
-				clear_x  = mr.clear_x;
-				clear_y  = mr.clear_y;
-				fin_xf   = mr.fin_xf;
-				fin_yf   = mr.fin_yf;
-				clear_xf = mr.clear_xf;
-				clear_yf = mr.clear_yf;
-				parts[i].vx = mr.vx;
-				parts[i].vy = mr.vy;
-			}
+	if(legacy_enable)//if heat sim is off
+		Element::legacyUpdate(this, i,x,y,surround_space,nt, parts, pmap);
+
+	if (parts[i].type == PT_NONE)//if its dead, skip to next particle
+		return false;
+
+	if (step.transitionOccurred)
+		return false;
+
+	if (!parts[i].vx&&!parts[i].vy)//if its not moving, skip to next particle, movement code it next
+		return false;
+
+	step.x = x;
+	step.y = y;
+	return true;
+}
+
+void Simulation::MoveParticle(int i, const ParticleStep &step)
+{
+	auto &sd = SimulationData::CRef();
+	auto &elements = sd.elements;
+	auto x = step.x;
+	auto y = step.y;
+	auto t = step.t;
+	auto surround_space = step.surround_space;
+	auto nt = step.nt;
+	auto pGravX = step.pGravX;
+	auto pGravY = step.pGravY;
+
+	int fin_x, fin_y, clear_x, clear_y;
+	float fin_xf, fin_yf, clear_xf, clear_yf;
+	{
+		auto mr = PlanMove<true>(*this, i, x, y);
+		fin_x    = mr.fin_x;
+		fin_y    = mr.fin_y;
+		clear_x  = mr.clear_x;
+		clear_y  = mr.clear_y;
+		fin_xf   = mr.fin_xf;
+		fin_yf   = mr.fin_yf;
+		clear_xf = mr.clear_xf;
+		clear_yf = mr.clear_yf;
+		parts[i].vx = mr.vx;
+		parts[i].vy = mr.vy;
+	}
 
-			auto stagnant = parts[i].flags & FLAG_STAGNANT;
-			parts[i].flags &= ~FLAG_STAGNANT;
+	auto stagnant = parts[i].flags & FLAG_STAGNANT;
+	parts[i].flags &= ~FLAG_STAGNANT;
 
-			if (t==PT_STKM || t==PT_STKM2 || t==PT_FIGH)
+	if (t==PT_STKM || t==PT_STKM2 || t==PT_FIGH)
+	{
+		//head movement, let head pass through anything
+		parts[i].x += parts[i].vx;
+		parts[i].y += parts[i].vy;
+		int nx = (int)((float)parts[i].x+0.5f);
+		int ny = (int)((float)parts[i].y+0.5f);
+		if (edgeMode == EDGE_LOOP)
+		{
+			bool x_ok = (nx >= CELL && nx < XRES-CELL);
+			bool y_ok = (ny >= CELL && ny < YRES-CELL);
+			int oldnx = nx, oldny = ny;
+			if (!x_ok)
 			{
-				//head movement, let head pass through anything
-				parts[i].x += parts[i].vx;
-				parts[i].y += parts[i].vy;
-				int nx = (int)((float)parts[i].x+0.5f);
-				int ny = (int)((float)parts[i].y+0.5f);
-				if (edgeMode == EDGE_LOOP)
-				{
-					bool x_ok = (nx >= CELL && nx < XRES-CELL);
-					bool y_ok = (ny >= CELL && ny < YRES-CELL);
-					int oldnx = nx, oldny = ny;
-					if (!x_ok)
-					{
-						parts[i].x = remainder_p(parts[i].x-CELL+.5f, XRES-CELL*2.0f)+CELL-.5f;
-						nx = (int)((float)parts[i].x+0.5f);
-					}
-					if (!y_ok)
-					{
-						parts[i].y = remainder_p(parts[i].y-CELL+.5f, YRES-CELL*2.0f)+CELL-.5f;
-						ny = (int)((float)parts[i].y+0.5f);
-					}
+				parts[i].x = remainder_p(parts[i].x-CELL+.5f, XRES-CELL*2.0f)+CELL-.5f;
+				nx = (int)((float)parts[i].x+0.5f);
+			}
+			if (!y_ok)
+			{
+				parts[i].y = remainder_p(parts[i].y-CELL+.5f, YRES-CELL*2.0f)+CELL-.5f;
+				ny = (int)((float)parts[i].y+0.5f);
+			}
 
-					if (!x_ok || !y_ok) //when moving from left to right stickmen might be able to fall through solid things, fix with "eval_move(t, nx+diffx, ny+diffy, NULL)" but then they die instead
-					{
-						//adjust stickmen legs
-						playerst* stickman = nullptr;
-						int t = parts[i].type;
-						if (t == PT_STKM)
-							stickman = &player;
-						else if (t == PT_STKM2)
-							stickman = &player2;
-						else if (t == PT_FIGH && parts[i].tmp >= 0 && parts[i].tmp < MAX_FIGHTERS)
-							stickman = &fighters[parts[i].tmp];
-
-						if (stickman)
-							for (int i = 0; i < 16; i+=2)
-							{
-								stickman->legs[i] += (nx-oldnx);
-								stickman->legs[i+1] += (ny-oldny);
-								stickman->accs[i/2] *= .95f;
-							}
-						parts[i].vy *= .95f;
-						parts[i].vx *= .95f;
-					}
-				}
-				if (ny!=y || nx!=x)
-				{
-					if (pmap[y][x] && ID(pmap[y][x]) == i)
-						pmap[y][x] = 0;
-					else if (photons[y][x] && ID(photons[y][x]) == i)
-						photons[y][x] = 0;
-					if (nx<CELL || nx>=XRES-CELL || ny<CELL || ny>=YRES-CELL)
+			if (!x_ok || !y_ok) //when moving from left to right stickmen might be able to fall through solid things, fix with "eval_move(t, nx+diffx, ny+diffy, NULL)" but then they die instead
+			{
+				//adjust stickmen legs
+				playerst* stickman = nullptr;
+				int t = parts[i].type;
+				if (t == PT_STKM)
+					stickman = &player;
+				else if (t == PT_STKM2)
+					stickman = &player2;
+				else if (t == PT_FIGH && parts[i].tmp >= 0 && parts[i].tmp < MAX_FIGHTERS)
+					stickman = &fighters[parts[i].tmp];
+
+				if (stickman)
+					for (int i = 0; i < 16; i+=2)
 					{
-						kill_part(i);
-						continue;
+						stickman->legs[i] += (nx-oldnx);
+						stickman->legs[i+1] += (ny-oldny);
+						stickman->accs[i/2] *= .95f;
 					}
-					if (elements[t].Properties & TYPE_ENERGY)
-						photons[ny][nx] = PMAP(i, t);
-					else if (t)
-						pmap[ny][nx] = PMAP(i, t);
-				}
+				parts[i].vy *= .95f;
+				parts[i].vx *= .95f;
 			}
-			else if (elements[t].Properties & TYPE_ENERGY)
+		}
+		if (ny!=y || nx!=x)
+		{
+			if (pmap[y][x] && ID(pmap[y][x]) == i)
+				pmap[y][x] = 0;
+			else if (photons[y][x] && ID(photons[y][x]) == i)
+				photons[y][x] = 0;
+			if (nx<CELL || nx>=XRES-CELL || ny<CELL || ny>=YRES-CELL)
 			{
-				if (t == PT_PHOT)
-				{
-					if (parts[i].flags&FLAG_SKIPMOVE)
-					{
-						parts[i].flags &= ~FLAG_SKIPMOVE;
-						continue;
-					}
+				kill_part(i);
+				return;
+			}
+			if (elements[t].Properties & TYPE_ENERGY)
+				photons[ny][nx] = PMAP(i, t);
+			else if (t)
+				pmap[ny][nx] = PMAP(i, t);
+			MarkMapped(nx, ny);
+		}
+	}
+	else if (elements[t].Properties & TYPE_ENERGY)
+	{
+		if (t == PT_PHOT)
+		{
+			if (parts[i].flags&FLAG_SKIPMOVE)
+			{
+				parts[i].flags &= ~FLAG_SKIPMOVE;
+				return;
+			}
 
-					if (eval_move(PT_PHOT, fin_x, fin_y, nullptr))
-					{
-						int rt = TYP(pmap[fin_y][fin_x]);
-						int lt = TYP(pmap[y][x]);
-						int rt_glas = (rt == PT_GLAS) || (rt == PT_BGLA);
-						int lt_glas = (lt == PT_GLAS) || (lt == PT_BGLA);
-						if ((rt_glas && !lt_glas) || (lt_glas && !rt_glas))
-						{
-							auto gn = get_normal_interp<true>(*this, REFRACT|t, parts[i].x, parts[i].y, parts[i].vx, parts[i].vy);
-							if (!gn.success) {
-								kill_part(i);
-								continue;
-							}
-							auto nrx = gn.nx;
-							auto nry = gn.ny;
-							auto r = get_wavelength_bin(&parts[i].ctype);
-							if (r == -1 || !(parts[i].ctype&0x3FFFFFFF))
-							{
-								kill_part(i);
-								continue;
-							}
-							auto nn = GLASS_IOR - GLASS_DISP*(r-30)/30.0f;
-							nn *= nn;
-
-							auto enter = rt_glas && !lt_glas;
-							nrx = enter ? -nrx : nrx;
-							nry = enter ? -nry : nry;
-							nn = enter ? 1.0f/nn : nn;
-							auto ct1 = parts[i].vx*nrx + parts[i].vy*nry;
-							auto ct2 = 1.0f - (nn*nn)*(1.0f-(ct1*ct1));
-							if (ct2 < 0.0f) {
-								// total internal reflection
-								parts[i].vx -= 2.0f*ct1*nrx;
-								parts[i].vy -= 2.0f*ct1*nry;
-								fin_xf = parts[i].x;
-								fin_yf = parts[i].y;
-								fin_x = x;
-								fin_y = y;
-							} else {
-								// refraction
-								ct2 = sqrtf(ct2);
-								ct2 = ct2 - nn*ct1;
-								parts[i].vx = nn*parts[i].vx + ct2*nrx;
-								parts[i].vy = nn*parts[i].vy + ct2*nry;
-							}
-						}
-					}
-				}
-				if (stagnant)//FLAG_STAGNANT set, was reflected on previous frame
+			if (eval_move(PT_PHOT, fin_x, fin_y, nullptr))
+			{
+				int rt = TYP(pmap[fin_y][fin_x]);
+				int lt = TYP(pmap[y][x]);
+				int rt_glas = (rt == PT_GLAS) || (rt == PT_BGLA);
+				int lt_glas = (lt == PT_GLAS) || (lt == PT_BGLA);
+				if ((rt_glas && !lt_glas) || (lt_glas && !rt_glas))
 				{
-					// cast coords as int then back to float for compatibility with existing saves
-					if (!do_move(i, x, y, (float)fin_x, (float)fin_y) && parts[i].type) {
+					auto gn = get_normal_interp<true>(*this, REFRACT|t, parts[i].x, parts[i].y, parts[i].vx, parts[i].vy);
+					if (!gn.success) {
 						kill_part(i);
-						continue;
+						return;
 					}
-				}
-				else if (!do_move(i, x, y, fin_xf, fin_yf))
-				{
-					if (parts[i].type == PT_NONE)
-						continue;
-					// reflection
-					parts[i].flags |= FLAG_STAGNANT;
-					if (t==PT_NEUT && rng.chance(1, 10))
+					auto nrx = gn.nx;
+					auto nry = gn.ny;
+					auto r = get_wavelength_bin(&parts[i].ctype);
+					if (r == -1 || !(parts[i].ctype&0x3FFFFFFF))
 					{
 						kill_part(i);
-						continue;
+						return;
 					}
-					auto r = pmap[fin_y][fin_x];
-
-					if ((TYP(r)==PT_PIPE || TYP(r) == PT_PPIP) && !TYP(parts[ID(r)].ctype))
-					{
-						parts[ID(r)].ctype =  parts[i].type;
-						parts[ID(r)].temp = parts[i].temp;
-						parts[ID(r)].tmp2 = parts[i].life;
-						parts[ID(r)].tmp3 = parts[i].tmp;
-						parts[ID(r)].tmp4 = parts[i].ctype;
-						kill_part(i);
-						continue;
+					auto nn = GLASS_IOR - GLASS_DISP*(r-30)/30.0f;
+					nn *= nn;
+
+					auto enter = rt_glas && !lt_glas;
+					nrx = enter ? -nrx : nrx;
+					nry = enter ? -nry : nry;
+					nn = enter ? 1.0f/nn : nn;
+					auto ct1 = parts[i].vx*nrx + parts[i].vy*nry;
+					auto ct2 = 1.0f - (nn*nn)*(1.0f-(ct1*ct1));
+					if (ct2 < 0.0f) {
+						// total internal reflection
+						parts[i].vx -= 2.0f*ct1*nrx;
+						parts[i].vy -= 2.0f*ct1*nry;
+						fin_xf = parts[i].x;
+						fin_yf = parts[i].y;
+						fin_x = x;
+						fin_y = y;
+					} else {
+						// refraction
+						ct2 = sqrtf(ct2);
+						ct2 = ct2 - nn*ct1;
+						parts[i].vx = nn*parts[i].vx + ct2*nrx;
+						parts[i].vy = nn*parts[i].vy + ct2*nry;
 					}
+				}
+			}
+		}
+		if (stagnant)//FLAG_STAGNANT set, was reflected on previous frame
+		{
+			// cast coords as int then back to float for compatibility with existing saves
+			if (!do_move(i, x, y, (float)fin_x, (float)fin_y) && parts[i].type) {
+				kill_part(i);
+				return;
+			}
+		}
+		else if (!do_move(i, x, y, fin_xf, fin_yf))
+		{
+			if (parts[i].type == PT_NONE)
+				return;
+			// reflection
+			parts[i].flags |= FLAG_STAGNANT;
+			if (t==PT_NEUT && rng.chance(1, 10))
+			{
+				kill_part(i);
+				return;
+			}
+			auto r = pmap[fin_y][fin_x];
 
-					if (t == PT_PHOT)
-					{
-						auto mask = elements[TYP(r)].PhotonReflectWavelengths;
-						if (TYP(r) == PT_LITH)
-						{
-							int wl_bin = parts[ID(r)].ctype / 4;
-							if (wl_bin < 0) wl_bin = 0;
-							if (wl_bin > 25) wl_bin = 25;
-							mask = (0x1F << wl_bin);
-						}
-						parts[i].ctype &= mask;
-					}
+			if ((TYP(r)==PT_PIPE || TYP(r) == PT_PPIP) && !TYP(parts[ID(r)].ctype))
+			{
+				parts[ID(r)].ctype =  parts[i].type;
+				parts[ID(r)].temp = parts[i].temp;
+				parts[ID(r)].tmp2 = parts[i].life;
+				parts[ID(r)].tmp3 = parts[i].tmp;
+				parts[ID(r)].tmp4 = parts[i].ctype;
+				kill_part(i);
+				return;
+			}
 
-					auto gn = get_normal_interp<true>(*this, t, parts[i].x, parts[i].y, parts[i].vx, parts[i].vy);
-					if (gn.success)
-					{
-						auto nrx = gn.nx;
-						auto nry = gn.ny;
-						if (TYP(r) == PT_CRMC)
-						{
-							float r = rng.between(-50, 50) * 0.01f, rx, ry, anrx, anry;
-							r = r * r * r;
-							rx = cosf(r); ry = sinf(r);
-							anrx = rx * nrx + ry * nry;
-							anry = rx * nry - ry * nrx;
-							auto dp = anrx*parts[i].vx + anry*parts[i].vy;
-							parts[i].vx -= 2.0f*dp*anrx;
-							parts[i].vy -= 2.0f*dp*anry;
-						}
-						else
-						{
-							auto dp = nrx*parts[i].vx + nry*parts[i].vy;
-							parts[i].vx -= 2.0f*dp*nrx;
-							parts[i].vy -= 2.0f*dp*nry;
-						}
-						// leave the actual movement until next frame so that reflection of fast particles and refraction happen correctly
-					}
-					else
-					{
-						if (t!=PT_NEUT)
-							kill_part(i);
-						continue;
-					}
-					if (!(parts[i].ctype&0x3FFFFFFF) && t == PT_PHOT)
-					{
-						kill_part(i);
-						continue;
-					}
+			if (t == PT_PHOT)
+			{
+				auto mask = elements[TYP(r)].PhotonReflectWavelengths;
+				if (TYP(r) == PT_LITH)
+				{
+					int wl_bin = parts[ID(r)].ctype / 4;
+					if (wl_bin < 0) wl_bin = 0;
+					if (wl_bin > 25) wl_bin = 25;
+					mask = (0x1F << wl_bin);
 				}
+				parts[i].ctype &= mask;
 			}
-			else if (elements[t].Falldown==0)
+
+			auto gn = get_normal_interp<true>(*this, t, parts[i].x, parts[i].y, parts[i].vx, parts[i].vy);
+			if (gn.success)
 			{
-				// gasses and solids (but not powders)
-				if (!do_move(i, x, y, fin_xf, fin_yf))
+				auto nrx = gn.nx;
+				auto nry = gn.ny;
+				if (TYP(r) == PT_CRMC)
 				{
-					if (parts[i].type == PT_NONE)
-						continue;
-					// can't move there, so bounce off
-					// TODO
-					// TODO: Work out what previous TODO was for
-					if (fin_x>x+ISTP) fin_x=x+ISTP;
-					if (fin_x<x-ISTP) fin_x=x-ISTP;
-					if (fin_y>y+ISTP) fin_y=y+ISTP;
-					if (fin_y<y-ISTP) fin_y=y-ISTP;
-					if (do_move(i, x, y, 0.25f+(float)(2*x-fin_x), 0.25f+fin_y))
-					{
-						parts[i].vx *= elements[t].Collision;
-					}
-					else if (do_move(i, x, y, 0.25f+fin_x, 0.25f+(float)(2*y-fin_y)))
-					{
-						parts[i].vy *= elements[t].Collision;
-					}
-					else
-					{
-						parts[i].vx *= elements[t].Collision;
-						parts[i].vy *= elements[t].Collision;
-					}
+					float r = rng.between(-50, 50) * 0.01f, rx, ry, anrx, anry;
+					r = r * r * r;
+					rx = cosf(r); ry = sinf(r);
+					anrx = rx * nrx + ry * nry;
+					anry = rx * nry - ry * nrx;
+					auto dp = anrx*parts[i].vx + anry*parts[i].vy;
+					parts[i].vx -= 2.0f*dp*anrx;
+					parts[i].vy -= 2.0f*dp*anry;
+				}
+				else
+				{
+					auto dp = nrx*parts[i].vx + nry*parts[i].vy;
+					parts[i].vx -= 2.0f*dp*nrx;
+					parts[i].vy -= 2.0f*dp*nry;
 				}
+				// leave the actual movement until next frame so that reflection of fast particles and refraction happen correctly
 			}
 			else
 			{
-				// Checking stagnant is cool, but then it doesn't update when you change it later.
-				if (water_equal_test && elements[t].Falldown == 2 && rng.chance(1, 200))
-				{
-					if (flood_water(x, y, i))
-						goto movedone;
-				}
-				// liquids and powders
-				if (!do_move(i, x, y, fin_xf, fin_yf))
+				if (t!=PT_NEUT)
+					kill_part(i);
+				return;
+			}
+			if (!(parts[i].ctype&0x3FFFFFFF) && t == PT_PHOT)
+			{
+				kill_part(i);
+				return;
+			}
+		}
+	}
+	else if (elements[t].Falldown==0)
+	{
+		// gasses and solids (but not powders)
+		if (!do_move(i, x, y, fin_xf, fin_yf))
+		{
+			if (parts[i].type == PT_NONE)
+				return;
+			// can't move there, so bounce off
+			// TODO
+			// TODO: Work out what previous TODO was for
+			if (fin_x>x+ISTP) fin_x=x+ISTP;
+			if (fin_x<x-ISTP) fin_x=x-ISTP;
+			if (fin_y>y+ISTP) fin_y=y+ISTP;
+			if (fin_y<y-ISTP) fin_y=y-ISTP;
+			if (do_move(i, x, y, 0.25f+(float)(2*x-fin_x), 0.25f+fin_y))
+			{
+				parts[i].vx *= elements[t].Collision;
+			}
+			else if (do_move(i, x, y, 0.25f+fin_x, 0.25f+(float)(2*y-fin_y)))
+			{
+				parts[i].vy *= elements[t].Collision;
+			}
+			else
+			{
+				parts[i].vx *= elements[t].Collision;
+				parts[i].vy *= elements[t].Collision;
+			}
+		}
+	}
+	else
+	{
+		// Checking stagnant is cool, but then it doesn't update when you change it later.
+		if (water_equal_test && elements[t].Falldown == 2 && rng.chance(1, 200))
+		{
+			if (flood_water(x, y, i))
+				return;
+		}
+		// liquids and powders
+		if (!do_move(i, x, y, fin_xf, fin_yf))
+		{
+			if (parts[i].type == PT_NONE)
+				return;
+			if (fin_x!=x && do_move(i, x, y, fin_xf, clear_yf))
+			{
+				parts[i].vx *= elements[t].Collision;
+				parts[i].vy *= elements[t].Collision;
+			}
+			else if (fin_y!=y && do_move(i, x, y, clear_xf, fin_yf))
+			{
+				parts[i].vx *= elements[t].Collision;
+				parts[i].vy *= elements[t].Collision;
+			}
+			else
+			{
+				auto r = rng.between(0, 1) * 2 - 1;// position search direction (left/right first)
+				if ((clear_x!=x || clear_y!=y || nt || surround_space) &&
+					(fabsf(parts[i].vx)>0.01f || fabsf(parts[i].vy)>0.01f))
 				{
-					if (parts[i].type == PT_NONE)
-						continue;
-					if (fin_x!=x && do_move(i, x, y, fin_xf, clear_yf))
+					// allow diagonal movement if target position is blocked
+					// but no point trying this if particle is stuck in a block of identical particles
+					auto dx = parts[i].vx - parts[i].vy*r;
+					auto dy = parts[i].vy + parts[i].vx*r;
+
+					auto mv = std::max(fabsf(dx), fabsf(dy));
+					dx /= mv;
+					dy /= mv;
+					if (do_move(i, x, y, clear_xf+dx, clear_yf+dy))
 					{
 						parts[i].vx *= elements[t].Collision;
 						parts[i].vy *= elements[t].Collision;
+						return;
 					}
-					else if (fin_y!=y && do_move(i, x, y, clear_xf, fin_yf))
+					{
+						auto swappage = dx;
+						dx = dy*r;
+						dy = -swappage*r;
+					}
+					if (do_move(i, x, y, clear_xf+dx, clear_yf+dy))
 					{
 						parts[i].vx *= elements[t].Collision;
 						parts[i].vy *= elements[t].Collision;
+						return;
 					}
+				}
+				if (elements[t].Falldown>1 && !grav && gravityMode==GRAV_VERTICAL && parts[i].vy>fabsf(parts[i].vx))
+				{
+					auto s = 0;
+					// stagnant is true if FLAG_STAGNANT was set for this particle in previous frame
+					int rt;
+					if (!stagnant || nt) //nt is if there is an something else besides the current particle type, around the particle
+						rt = 30;//slight less water lag, although it changes how it moves a lot
 					else
+						rt = 10;
+
+					if (t==PT_GEL)
+						rt = int(parts[i].tmp*0.20f+5.0f);
+
+					auto nx = -1, ny = -1;
+					for (auto j=clear_x+r; j>=0 && j>=clear_x-rt && j<clear_x+rt && j<XRES; j+=r)
 					{
-						auto r = rng.between(0, 1) * 2 - 1;// position search direction (left/right first)
-						if ((clear_x!=x || clear_y!=y || nt || surround_space) &&
-							(fabsf(parts[i].vx)>0.01f || fabsf(parts[i].vy)>0.01f))
+						if ((TYP(pmap[fin_y][j])!=t || bmap[fin_y/CELL][j/CELL])
+							&& (s=do_move(i, x, y, (float)j, fin_yf)))
 						{
-							// allow diagonal movement if target position is blocked
-							// but no point trying this if particle is stuck in a block of identical particles
-							auto dx = parts[i].vx - parts[i].vy*r;
-							auto dy = parts[i].vy + parts[i].vx*r;
-
-							auto mv = std::max(fabsf(dx), fabsf(dy));
-							dx /= mv;
-							dy /= mv;
-							if (do_move(i, x, y, clear_xf+dx, clear_yf+dy))
-							{
-								parts[i].vx *= elements[t].Collision;
-								parts[i].vy *= elements[t].Collision;
-								goto movedone;
-							}
-							{
-								auto swappage = dx;
-								dx = dy*r;
-								dy = -swappage*r;
-							}
-							if (do_move(i, x, y, clear_xf+dx, clear_yf+dy))
-							{
-								parts[i].vx *= elements[t].Collision;
-								parts[i].vy *= elements[t].Collision;
-								goto movedone;
-							}
+							nx = (int)(parts[i].x+0.5f);
+							ny = (int)(parts[i].y+0.5f);
+							break;
 						}
-						if (elements[t].Falldown>1 && !grav && gravityMode==GRAV_VERTICAL && parts[i].vy>fabsf(parts[i].vx))
+						if (fin_y!=clear_y && (TYP(pmap[clear_y][j])!=t || bmap[clear_y/CELL][j/CELL])
+							&& (s=do_move(i, x, y, (float)j, clear_yf)))
 						{
-							auto s = 0;
-							// stagnant is true if FLAG_STAGNANT was set for this particle in previous frame
-							int rt;
-							if (!stagnant || nt) //nt is if there is an something else besides the current particle type, around the particle
-								rt = 30;//slight less water lag, although it changes how it moves a lot
-							else
-								rt = 10;
-
-							if (t==PT_GEL)
-								rt = int(parts[i].tmp*0.20f+5.0f);
-
-							auto nx = -1, ny = -1;
-							for (auto j=clear_x+r; j>=0 && j>=clear_x-rt && j<clear_x+rt && j<XRES; j+=r)
-							{
-								if ((TYP(pmap[fin_y][j])!=t || bmap[fin_y/CELL][j/CELL])
-									&& (s=do_move(i, x, y, (float)j, fin_yf)))
-								{
-									nx = (int)(parts[i].x+0.5f);
-									ny = (int)(parts[i].y+0.5f);
-									break;
-								}
-								if (fin_y!=clear_y && (TYP(pmap[clear_y][j])!=t || bmap[clear_y/CELL][j/CELL])
-									&& (s=do_move(i, x, y, (float)j, clear_yf)))
-								{
-									nx = (int)(parts[i].x+0.5f);
-									ny = (int)(parts[i].y+0.5f);
-									break;
-								}
-								if (TYP(pmap[clear_y][j])!=t || (bmap[clear_y/CELL][j/CELL] && bmap[clear_y/CELL][j/CELL]!=WL_STREAM))
-									break;
-							}
+							nx = (int)(parts[i].x+0.5f);
+							ny = (int)(parts[i].y+0.5f);
+							break;
+						}
+						if (TYP(pmap[clear_y][j])!=t || (bmap[clear_y/CELL][j/CELL] && bmap[clear_y/CELL][j/CELL]!=WL_STREAM))
+							break;
+					}
 
-							r = (parts[i].vy>0) ? 1 : -1;
+					r = (parts[i].vy>0) ? 1 : -1;
 
-							if (s==1)
-								for (auto j=ny+r; j>=0 && j<YRES && j>=ny-rt && j<ny+rt; j+=r)
-								{
-									if ((TYP(pmap[j][nx])!=t || bmap[j/CELL][nx/CELL]) && do_move(i, nx, ny, (float)nx, (float)j))
-										break;
-									if (TYP(pmap[j][nx])!=t || (bmap[j/CELL][nx/CELL] && bmap[j/CELL][nx/CELL]!=WL_STREAM))
-										break;
-								}
-							else if (s==-1) {} // particle is out of bounds
-							else if ((clear_x!=x||clear_y!=y) && do_move(i, x, y, clear_xf, clear_yf)) {}
-							else parts[i].flags |= FLAG_STAGNANT;
-							parts[i].vx *= elements[t].Collision;
-							parts[i].vy *= elements[t].Collision;
+					if (s==1)
+						for (auto j=ny+r; j>=0 && j<YRES && j>=ny-rt && j<ny+rt; j+=r)
+						{
+							if ((TYP(pmap[j][nx])!=t || bmap[j/CELL][nx/CELL]) && do_move(i, nx, ny, (float)nx, (float)j))
+								break;
+							if (TYP(pmap[j][nx])!=t || (bmap[j/CELL][nx/CELL] && bmap[j/CELL][nx/CELL]!=WL_STREAM))
+								break;
 						}
-						else if (elements[t].Falldown>1 && fabsf(pGravX*parts[i].vx+pGravY*parts[i].vy)>fabsf(pGravY*parts[i].vx-pGravX*parts[i].vy))
+					else if (s==-1) {} // particle is out of bounds
+					else if ((clear_x!=x||clear_y!=y) && do_move(i, x, y, clear_xf, clear_yf)) {}
+					else parts[i].flags |= FLAG_STAGNANT;
+					parts[i].vx *= elements[t].Collision;
+					parts[i].vy *= elements[t].Collision;
+				}
+				else if (elements[t].Falldown>1 && fabsf(pGravX*parts[i].vx+pGravY*parts[i].vy)>fabsf(pGravY*parts[i].vx-pGravX*parts[i].vy))
+				{
+					float nxf, nyf, prev_pGravX, prev_pGravY, ptGrav = elements[t].Gravity;
+					auto s = 0;
+					// stagnant is true if FLAG_STAGNANT was set for this particle in previous frame
+					// nt is if there is something else besides the current particle type around the particle
+					// 30 gives slightly less water lag, although it changes how it moves a lot
+					auto rt = (!stagnant || nt) ? 30 : 10;
+
+					// clear_xf, clear_yf is the last known position that the particle should almost certainly be able to move to
+					nxf = clear_xf;
+					nyf = clear_yf;
+					auto nx = clear_x;
+					auto ny = clear_y;
+					// Look for spaces to move horizontally (perpendicular to gravity direction), keep going until a space is found or the number of positions examined = rt
+					for (auto j=0;j<rt;j++)
+					{
+						// Calculate overall gravity direction
+						GetGravityField(nx, ny, ptGrav, 1.0f, pGravX, pGravY);
+						// Scale gravity vector so that the largest component is 1 pixel
+						auto mv = std::max(fabsf(pGravX), fabsf(pGravY));
+						if (mv<0.0001f) break;
+						pGravX /= mv;
+						pGravY /= mv;
+						// Move 1 pixel perpendicularly to gravity
+						// r is +1/-1, to try moving left or right at random
+						if (j)
 						{
-							float nxf, nyf, prev_pGravX, prev_pGravY, ptGrav = elements[t].Gravity;
-							auto s = 0;
-							// stagnant is true if FLAG_STAGNANT was set for this particle in previous frame
-							// nt is if there is something else besides the current particle type around the particle
-							// 30 gives slightly less water lag, although it changes how it moves a lot
-							auto rt = (!stagnant || nt) ? 30 : 10;
-
-							// clear_xf, clear_yf is the last known position that the particle should almost certainly be able to move to
-							nxf = clear_xf;
-							nyf = clear_yf;
-							auto nx = clear_x;
-							auto ny = clear_y;
-							// Look for spaces to move horizontally (perpendicular to gravity direction), keep going until a space is found or the number of positions examined = rt
-							for (auto j=0;j<rt;j++)
-							{
-								// Calculate overall gravity direction
-								GetGravityField(nx, ny, ptGrav, 1.0f, pGravX, pGravY);
-								// Scale gravity vector so that the largest component is 1 pixel
-								auto mv = std::max(fabsf(pGravX), fabsf(pGravY));
-								if (mv<0.0001f) break;
-								pGravX /= mv;
-								pGravY /= mv;
-								// Move 1 pixel perpendicularly to gravity
-								// r is +1/-1, to try moving left or right at random
-								if (j)
-								{
-									// Not quite the gravity direction
-									// Gravity direction + last change in gravity direction
-									// This makes liquid movement a bit less frothy, particularly for balls of liquid in radial gravity. With radial gravity, instead of just moving along a tangent, the attempted movement will follow the curvature a bit better.
-									nxf += r*(pGravY*2.0f-prev_pGravY);
-									nyf += -r*(pGravX*2.0f-prev_pGravX);
-								}
-								else
-								{
-									nxf += r*pGravY;
-									nyf += -r*pGravX;
-								}
-								prev_pGravX = pGravX;
-								prev_pGravY = pGravY;
-								// Check whether movement is allowed
-								nx = (int)(nxf+0.5f);
-								ny = (int)(nyf+0.5f);
-								if (nx<0 || ny<0 || nx>=XRES || ny >=YRES)
-									break;
-								if (TYP(pmap[ny][nx])!=t || bmap[ny/CELL][nx/CELL])
-								{
-									s = do_move(i, x, y, nxf, nyf);
-									if (s)
-									{
-										// Movement was successful
-										nx = (int)(parts[i].x+0.5f);
-										ny = (int)(parts[i].y+0.5f);
-										break;
-									}
-									// A particle of a different type, or a wall, was found. Stop trying to move any further horizontally unless the wall should be completely invisible to particles.
-									if (TYP(pmap[ny][nx])!=t || bmap[ny/CELL][nx/CELL]!=WL_STREAM)
-										break;
-								}
-							}
-							if (s==1)
+							// Not quite the gravity direction
+							// Gravity direction + last change in gravity direction
+							// This makes liquid movement a bit less frothy, particularly for balls of liquid in radial gravity. With radial gravity, instead of just moving along a tangent, the attempted movement will follow the curvature a bit better.
+							nxf += r*(pGravY*2.0f-prev_pGravY);
+							nyf += -r*(pGravX*2.0f-prev_pGravX);
+						}
+						else
+						{
+							nxf += r*pGravY;
+							nyf += -r*pGravX;
+						}
+						prev_pGravX = pGravX;
+						prev_pGravY = pGravY;
+						// Check whether movement is allowed
+						nx = (int)(nxf+0.5f);
+						ny = (int)(nyf+0.5f);
+						if (nx<0 || ny<0 || nx>=XRES || ny >=YRES)
+							break;
+						if (TYP(pmap[ny][nx])!=t || bmap[ny/CELL][nx/CELL])
+						{
+							s = do_move(i, x, y, nxf, nyf);
+							if (s)
 							{
-								// The particle managed to move horizontally, now try to move vertically (parallel to gravity direction)
-								// Keep going until the particle is blocked (by something that isn't the same element) or the number of positions examined = rt
-								clear_x = nx;
-								clear_y = ny;
-								for (auto j=0;j<rt;j++)
-								{
-									// Calculate overall gravity direction
-									GetGravityField(nx, ny, ptGrav, 1.0f, pGravX, pGravY);
-									// Scale gravity vector so that the largest component is 1 pixel
-									auto mv = std::max(fabsf(pGravX), fabsf(pGravY));
-									if (mv<0.0001f) break;
-									pGravX /= mv;
-									pGravY /= mv;
-									// Move 1 pixel in the direction of gravity
-									nxf += pGravX;
-									nyf += pGravY;
-									nx = (int)(nxf+0.5f);
-									ny = (int)(nyf+0.5f);
-									if (nx<0 || ny<0 || nx>=XRES || ny>=YRES)
-										break;
-									// If the space is anything except the same element (a wall, empty space, or occupied by a particle of a different element), try to move into it
-									if (TYP(pmap[ny][nx])!=t || bmap[ny/CELL][nx/CELL])
-									{
-										s = do_move(i, clear_x, clear_y, nxf, nyf);
-										if (s || TYP(pmap[ny][nx])!=t || bmap[ny/CELL][nx/CELL]!=WL_STREAM)
-											break; // found the edge of the liquid and movement into it succeeded, so stop moving down
-									}
-								}
+								// Movement was successful
+								nx = (int)(parts[i].x+0.5f);
+								ny = (int)(parts[i].y+0.5f);
+								break;
 							}
-							else if (s==-1) {} // particle is out of bounds
-							else if ((clear_x!=x||clear_y!=y) && do_move(i, x, y, clear_xf, clear_yf)) {} // try moving to the last clear position
-							else parts[i].flags |= FLAG_STAGNANT;
-							parts[i].vx *= elements[t].Collision;
-							parts[i].vy *= elements[t].Collision;
+							// A particle of a different type, or a wall, was found. Stop trying to move any further horizontally unless the wall should be completely invisible to particles.
+							if (TYP(pmap[ny][nx])!=t || bmap[ny/CELL][nx/CELL]!=WL_STREAM)
+								break;
 						}
-						else
+					}
+					if (s==1)
+					{
+						// The particle managed to move horizontally, now try to move vertically (parallel to gravity direction)
+						// Keep going until the particle is blocked (by something that isn't the same element) or the number of positions examined = rt
+						clear_x = nx;
+						clear_y = ny;
+						for (auto j=0;j<rt;j++)
 						{
-							// if interpolation was done, try moving to last clear position
-							if ((clear_x!=x||clear_y!=y) && do_move(i, x, y, clear_xf, clear_yf)) {}
-							else parts[i].flags |= FLAG_STAGNANT;
-							parts[i].vx *= elements[t].Collision;
-							parts[i].vy *= elements[t].Collision;
+							// Calculate overall gravity direction
+							GetGravityField(nx, ny, ptGrav, 1.0f, pGravX, pGravY);
+							// Scale gravity vector so that the largest component is 1 pixel
+							auto mv = std::max(fabsf(pGravX), fabsf(pGravY));
+							if (mv<0.0001f) break;
+							pGravX /= mv;
+							pGravY /= mv;
+							// Move 1 pixel in the direction of gravity
+							nxf += pGravX;
+							nyf += pGravY;
+							nx = (int)(nxf+0.5f);
+							ny = (int)(nyf+0.5f);
+							if (nx<0 || ny<0 || nx>=XRES || ny>=YRES)
+								break;
+							// If the space is anything except the same element (a wall, empty space, or occupied by a particle of a different element), try to move into it
+							if (TYP(pmap[ny][nx])!=t || bmap[ny/CELL][nx/CELL])
+							{
+								s = do_move(i, clear_x, clear_y, nxf, nyf);
+								if (s || TYP(pmap[ny][nx])!=t || bmap[ny/CELL][nx/CELL]!=WL_STREAM)
+									break; // found the edge of the liquid and movement into it succeeded, so stop moving down
+							}
 						}
 					}
+					else if (s==-1) {} // particle is out of bounds
+					else if ((clear_x!=x||clear_y!=y) && do_move(i, x, y, clear_xf, clear_yf)) {} // try moving to the last clear position
+					else parts[i].flags |= FLAG_STAGNANT;
+					parts[i].vx *= elements[t].Collision;
+					parts[i].vy *= elements[t].Collision;
+				}
+				else
+				{
+					// if interpolation was done, try moving to last clear position
+					if ((clear_x!=x||clear_y!=y) && do_move(i, x, y, clear_xf, clear_yf)) {}
+					else parts[i].flags |= FLAG_STAGNANT;
+					parts[i].vx *= elements[t].Collision;
+					parts[i].vy *= elements[t].Collision;
 				}
-				
 			}
-movedone:
-			continue;
 		}
-		
+
 	}
+}
 
-	
+void Simulation::UpdateParticles(int start, int end)
+{
+	// only whole frames are split into tiles, stepping through particles one by one with the
+	// debugger stays serial
+	auto tiled = false;
+	if (start == 0 && end >= NPART && (updateThreads > 1 || deterministicUpdate))
+	{
+		if (!tiledUpdate)
+		{
+			tiledUpdate = std::make_unique<TiledUpdate>(*this);
+		}
+		tiled = tiledUpdate->Run(deterministicUpdate);
+	}
 
-	for (auto i = start; i < end && i <= parts_lastActiveIndex; i++){
-		if (parts[i].type) {
-			if (parts[i].vx != 0 && parts[i].vy != 0){
-				oscClient->CountParticle(&(parts[i]));
-			}
+	// activity is only tracked over whole serial frames, anything else forgets what has settled
+	ActivityMap *sleep = nullptr;
+	if (sleepingTiles && !tiled && start == 0 && end >= NPART && !ensureDeterminism)
+	{
+		if (!activityMap)
+		{
+			activityMap = std::make_unique<ActivityMap>(*this);
 		}
+		sleep = activityMap.get();
+		sleep->BeginFrame();
 	}
-	oscClient->SortParticles();
+	else
+	{
+		activityMap.reset();
+	}
+
+	//the main particle loop function, goes over all particles.
+	for (auto i = start; !tiled && i < end && i <= parts.lastActiveIndex; i++)
+	{
+		if (parts[i].type)
+		{
+			// feed OSC analytics while the particle is still hot in cache; this sees the state
+			// the particle was left in at the end of the previous frame
+			if (oscClient)
+			{
+				oscClient->AccumulateParticle(parts[i]);
+			}
+
+			auto tile = -1;
+			if (sleep)
+			{
+				tile = ActivityMap::TileAt(int(parts[i].x + 0.5f), int(parts[i].y + 0.5f));
+				if (sleep->Asleep(tile) && !sleepCheck)
+				{
+					// a particle at rest still slows down the air around it
+					DragAir(i, parts[i].type, int(parts[i].x + 0.5f), int(parts[i].y + 0.5f));
+					continue;
+				}
+			}
 
-	for (auto i = start; i < end && i <= parts_lastActiveIndex; i++){
-		if (parts[i].type) {
-			if (parts[i].vx != 0 && parts[i].vy != 0){
-				oscClient->ProcessParticle(&(parts[i]));
+			debug_mostRecentlyUpdated = i;
+			UpdateParticle(i);
+			if (sleep)
+			{
+				sleep->Updated(i, tile);
 			}
 		}
 	}
+	if (sleep)
+	{
+		sleep->EndFrame();
+	}
 
 	//'f' was pressed (single frame)
 	if (framerender)
 	{
-		framerender--;
+		framerender--;
+	}
+}
+
+// Particles are sometimes allowed to go inside INVS and FILT
+// To make particles collide correctly when inside these elements, these elements must not overwrite an existing pmap entry from particles inside them
+static void mapParticle(int (&pmap)[YRES][XRES], int (&photons)[YRES][XRES], unsigned int (&pmap_count)[YRES][XRES], bool energy, int i, int t, int x, int y)
+{
+	if (energy)
+		photons[y][x] = PMAP(i, t);
+	else
+	{
+		if (!pmap[y][x] || (t!=PT_INVIS && t!= PT_FILT))
+			pmap[y][x] = PMAP(i, t);
+		// (there are a few exceptions, including energy particles - currently no limit on stacking those)
+		if (t!=PT_THDR && t!=PT_EMBR && t!=PT_FIGH && t!=PT_PLSM)
+			pmap_count[y][x]++;
 	}
-	oscClient->AnalyzeAndSend();
 }
 
 void Simulation::RecalcFreeParticles(bool do_life_dec)
 {
+	if (incrementalMaps && do_life_dec && mapTracker && mapTracker->valid)
+	{
+		RecalcMapsIncrementally();
+		return;
+	}
+
 	int x, y, t;
 	int lastPartUsed = 0;
 	int lastPartUnused = -1;
@@ -3297,18 +3496,7 @@ void Simulation::RecalcFreeParticles(bool do_life_dec)
 			bool inBounds = false;
 			if (x>=0 && y>=0 && x<XRES && y<YRES)
 			{
-				if (elements[t].Properties & TYPE_ENERGY)
-					photons[y][x] = PMAP(i, t);
-				else
-				{
-					// Particles are sometimes allowed to go inside INVS and FILT
-					// To make particles collide correctly when inside these elements, these elements must not overwrite an existing pmap entry from particles inside them
-					if (!pmap[y][x] || (t!=PT_INVIS && t!= PT_FILT))
-						pmap[y][x] = PMAP(i, t);
-					// (there are a few exceptions, including energy particles - currently no limit on stacking those)
-					if (t!=PT_THDR && t!=PT_EMBR && t!=PT_FIGH && t!=PT_PLSM)
-						pmap_count[y][x]++;
-				}
+				mapParticle(pmap, photons, pmap_count, elements[t].Properties & TYPE_ENERGY, i, t, x, y);
 				inBounds = true;
 			}
 			lastPartUsed = i;
@@ -3364,6 +3552,277 @@ void Simulation::RecalcFreeParticles(bool do_life_dec)
 	parts.lastActiveIndex = lastPartUsed;
 	if (elementRecount)
 		elementRecount = false;
+
+	if (incrementalMaps)
+	{
+		if (!mapTracker)
+		{
+			mapTracker = std::make_unique<MapTracker>();
+		}
+		mapTracker->Reset(parts);
+		// particles killed above are not on the free list, and nothing will put them there
+		// from now on; list every free slot, in id order, as clear_sim does
+		pfree = -1;
+		for (int i = NPART - 1; i >= 0; i--)
+		{
+			if (!parts[i].type)
+			{
+				parts[i].life = pfree;
+				pfree = i;
+			}
+		}
+	}
+	else
+	{
+		mapTracker.reset();
+	}
+}
+
+void Simulation::RecalcMapsIncrementally()
+{
+	auto &tracker = *mapTracker;
+	auto &elements = SimulationData::CRef().elements;
+	tracker.dying.clear();
+	int lastPartUsed = 0;
+	NUM_PARTS = 0;
+	auto lifeDec = !sys_pause || framerender;
+	// same as the loop in RecalcFreeParticles, except that it only visits slots that hold
+	// particles, and only finds out which blocks need to be mapped again
+	auto words = std::min(parts.lastActiveIndex / 64 + 1, int(tracker.live.size()));
+	for (int w = 0; w < words; w++)
+	{
+		auto bits = tracker.live[w].load(std::memory_order_relaxed);
+		while (bits)
+		{
+			auto i = w * 64 + std::countr_zero(bits);
+			bits &= bits - 1;
+			auto t = parts[i].type;
+			auto &mapped = tracker.mapped[i];
+			if (!t)
+			{
+				// emptied without kill_part, which would have put it on the free list
+				tracker.MarkDirtyParticle(i);
+				mapped = { -1, 0 };
+				tracker.SetLive(i, false);
+				parts[i].life = pfree;
+				pfree = i;
+				continue;
+			}
+			auto x = int(parts[i].x + 0.5f);
+			auto y = int(parts[i].y + 0.5f);
+			auto inBounds = x >= 0 && y >= 0 && x < XRES && y < YRES;
+			auto cell = inBounds ? y * XRES + x : -1;
+			if (mapped.cell != cell || mapped.type != t)
+			{
+				tracker.MarkDirtyParticle(i);
+				tracker.MarkDirty(x, y);
+				mapped = { cell, t };
+			}
+			lastPartUsed = i;
+			NUM_PARTS++;
+
+			if (elementRecount && t >= 0 && t < PT_NUM && elements[t].Enabled)
+				elementCount[t]++;
+
+			// killed once the maps are rebuilt, see below
+			if (lifeDec)
+			{
+				if (t<0 || t>=PT_NUM || !elements[t].Enabled)
+				{
+					tracker.dying.push_back(i);
+					continue;
+				}
+
+				unsigned int elem_properties = elements[t].Properties;
+				if (parts[i].life>0 && (elem_properties&PROP_LIFE_DEC) && !(inBounds && bmap[y/CELL][x/CELL] == WL_STASIS && emap[y/CELL][x/CELL]<8))
+				{
+					parts[i].life--;
+					if (parts[i].life<=0 && (elem_properties&(PROP_LIFE_KILL_DEC|PROP_LIFE_KILL)))
+					{
+						tracker.dying.push_back(i);
+						continue;
+					}
+				}
+				else if (parts[i].life<=0 && (elem_properties&PROP_LIFE_KILL) && !(inBounds && bmap[y/CELL][x/CELL] == WL_STASIS && emap[y/CELL][x/CELL]<8))
+				{
+					tracker.dying.push_back(i);
+					continue;
+				}
+			}
+		}
+	}
+	parts.lastActiveIndex = lastPartUsed;
+
+	// clear dirty blocks, in runs
+	for (int by = 0; by < YCELLS; by++)
+	{
+		auto *row = &tracker.dirty[by * XCELLS];
+		for (int bx = 0; bx < XCELLS; )
+		{
+			if (!row[bx].load(std::memory_order_relaxed))
+			{
+				bx++;
+				continue;
+			}
+			auto begin = bx;
+			while (bx < XCELLS && row[bx].load(std::memory_order_relaxed))
+			{
+				bx++;
+			}
+			auto width = (bx - begin) * CELL;
+			for (int y = by * CELL; y < (by + 1) * CELL; y++)
+			{
+				std::fill_n(&pmap[y][begin * CELL], width, 0);
+				std::fill_n(&photons[y][begin * CELL], width, 0);
+				std::fill_n(&pmap_count[y][begin * CELL], width, 0U);
+			}
+		}
+	}
+
+	// and map the particles in them again, in id order; the dying ones too, as they are still
+	// mapped before they are killed in a full rebuild
+	for (int w = 0; w < words; w++)
+	{
+		auto bits = tracker.live[w].load(std::memory_order_relaxed);
+		while (bits)
+		{
+			auto i = w * 64 + std::countr_zero(bits);
+			bits &= bits - 1;
+			auto t = parts[i].type;
+			auto x = int(parts[i].x + 0.5f);
+			auto y = int(parts[i].y + 0.5f);
+			if (x >= 0 && y >= 0 && x < XRES && y < YRES && tracker.dirty[(y / CELL) * XCELLS + x / CELL].load(std::memory_order_relaxed))
+			{
+				mapParticle(pmap, photons, pmap_count, elements[t].Properties & TYPE_ENERGY, i, t, x, y);
+			}
+		}
+	}
+	for (auto &block : tracker.dirty)
+	{
+		block.store(0, std::memory_order_relaxed);
+	}
+
+	if (validateMaps)
+	{
+		if (!tracker.reference)
+		{
+			tracker.reference = std::make_unique<MapTracker::Maps>();
+		}
+		auto &reference = *tracker.reference;
+		memset(&reference, 0, sizeof(reference));
+		for (int i = 0; i < NPART; i++)
+		{
+			auto t = parts[i].type;
+			if (t)
+			{
+				auto x = int(parts[i].x + 0.5f);
+				auto y = int(parts[i].y + 0.5f);
+				if (x >= 0 && y >= 0 && x < XRES && y < YRES)
+				{
+					mapParticle(reference.pmap, reference.photons, reference.pmap_count, elements[t].Properties & TYPE_ENERGY, i, t, x, y);
+				}
+			}
+		}
+		if (memcmp(reference.pmap, pmap, sizeof(pmap)) || memcmp(reference.photons, photons, sizeof(photons)) || memcmp(reference.pmap_count, pmap_count, sizeof(pmap_count)))
+		{
+			tracker.drifts += 1;
+			memcpy(pmap, reference.pmap, sizeof(pmap));
+			memcpy(photons, reference.photons, sizeof(photons));
+			memcpy(pmap_count, reference.pmap_count, sizeof(pmap_count));
+			// start over from a full rebuild next frame
+			tracker.valid = false;
+		}
+	}
+	else
+	{
+		tracker.reference.reset();
+	}
+
+	for (auto i : tracker.dying)
+	{
+		kill_part(i);
+	}
+	if (elementRecount)
+		elementRecount = false;
+}
+
+// Moves every particle into the lowest free slot below it, keeping them in the same order, and
+// fixes up what refers to them by id. Returns how many particles moved.
+int Simulation::CompactParticles()
+{
+	compactedIds.clear();
+	auto end = parts.lastActiveIndex + 1;
+	std::vector<int> newIds(end, -1);
+	int count = 0;
+	for (int i = 0; i < end; i++)
+	{
+		if (parts[i].type)
+		{
+			newIds[i] = count;
+			if (count != i)
+			{
+				parts[count] = parts[i];
+				compactedIds.push_back({ i, count });
+			}
+			count += 1;
+		}
+	}
+	if (compactedIds.empty())
+	{
+		return 0;
+	}
+	auto newId = [&newIds](int i) {
+		return (i >= 0 && i < int(newIds.size())) ? newIds[i] : -1;
+	};
+
+	for (int y = 0; y < YRES; y++)
+	{
+		for (int x = 0; x < XRES; x++)
+		{
+			if (auto r = pmap[y][x])
+			{
+				auto n = newId(ID(r));
+				pmap[y][x] = n >= 0 ? PMAP(n, TYP(r)) : 0;
+			}
+			if (auto r = photons[y][x])
+			{
+				auto n = newId(ID(r));
+				photons[y][x] = n >= 0 ? PMAP(n, TYP(r)) : 0;
+			}
+		}
+	}
+	// links to particles that are gone become invalid ones, which SOAP breaks up
+	for (int i = 0; i < count; i++)
+	{
+		if (parts[i].type == PT_SOAP)
+		{
+			if ((parts[i].ctype & 2) == 2)
+				parts[i].tmp = newId(parts[i].tmp);
+			if ((parts[i].ctype & 4) == 4)
+				parts[i].tmp2 = newId(parts[i].tmp2);
+		}
+	}
+	if (player.spawnID >= 0)
+		player.spawnID = newId(player.spawnID);
+	if (player2.spawnID >= 0)
+		player2.spawnID = newId(player2.spawnID);
+	// portalp holds copies of particles, not ids, so there is nothing to fix there
+
+	// the slots left behind join the free list where RecalcFreeParticles expects them to be,
+	// after lastActiveIndex, in id order
+	for (int i = count; i < end; i++)
+	{
+		parts[i] = Particle{};
+		parts[i].life = i + 1 < NPART ? i + 1 : -1;
+	}
+	pfree = count < NPART ? count : -1;
+	parts.lastActiveIndex = std::max(count - 1, 0);
+	if (mapTracker)
+	{
+		mapTracker->valid = false;
+	}
+	WakeAllTiles();
+	return int(compactedIds.size());
 }
 
 void Simulation::SimulateGoL()
@@ -3563,12 +4022,14 @@ void Simulation::CheckStacking()
 					if (pmap_count[y][x]>1500)
 					{
 						pmap_count[y][x] = pmap_count[y][x] + NPART;
+						MarkMapped(x, y);
 						excessive_stacking_found = 1;
 					}
 				}
 				else if (pmap_count[y][x]>1500 || (unsigned int)rng.between(0, 1599) <= (pmap_count[y][x]+100))
 				{
 					pmap_count[y][x] = pmap_count[y][x] + NPART;
+					MarkMapped(x, y);
 					excessive_stacking_found = true;
 				}
 			}
@@ -3594,6 +4055,7 @@ void Simulation::CheckStacking()
 							parts[i].tmp = pmap_count[y][x]-NPART;//strength of grav field
 							if (parts[i].tmp>51200) parts[i].tmp = 51200;
 							pmap_count[y][x] = NPART;
+							MarkMapped(x, y);
 						}
 						else
 						{
@@ -3648,17 +4110,164 @@ void Simulation::UpdateGravityMask()
 	}
 }
 
+// upper bound on control messages applied per frame so a flood of them can't stall the simulation;
+// whatever is left stays queued for the next frame
+constexpr int oscCommandBatch = 256;
+
+void Simulation::ApplyOscCommands()
+{
+	auto *control = oscClient->GetControl();
+	if (!control)
+	{
+		return;
+	}
+	auto &sd = SimulationData::CRef();
+	auto elementType = [&sd](const OscCommand &command) {
+		return command.valueKind == OscCommand::NameValue ? sd.GetParticleType(ByteString(command.name)) : command.intValue;
+	};
+	OscCommand command;
+	for (int applied = 0; applied < oscCommandBatch && control->Pop(command); applied++)
+	{
+		switch (command.kind)
+		{
+		case OscCommand::Create:
+			create_part(-2, command.x, command.y, elementType(command));
+			break;
+
+		case OscCommand::Brush:
+		{
+			auto type = elementType(command);
+			auto rx = std::clamp(command.rx, 0, BRUSH_RADIUS_MAX);
+			auto ry = std::clamp(command.ry, 0, BRUSH_RADIUS_MAX);
+			for (int j = -ry; j <= ry; j++)
+			{
+				for (int i = -rx; i <= rx; i++)
+				{
+					// same ellipse as the default circle brush
+					if (rx && ry && float(i * i) / (rx * rx) + float(j * j) / (ry * ry) > 1.0f)
+					{
+						continue;
+					}
+					create_part(-2, command.x + i, command.y + j, type);
+				}
+			}
+			break;
+		}
+
+		case OscCommand::Pause:
+		{
+			// toggles whatever an earlier command of this batch asked for
+			auto paused = oscPauseRequest.value_or(sys_pause != 0);
+			oscPauseRequest = command.valueKind == OscCommand::NoValue ? !paused : command.intValue != 0;
+			break;
+		}
+
+		case OscCommand::AirMode:
+			if (command.intValue >= 0 && command.intValue < NUM_AIRMODES)
+			{
+				air->airMode = command.intValue;
+			}
+			break;
+
+		case OscCommand::SetProp:
+		{
+			if (command.id < 0 || command.id >= NPART || !parts[command.id].type)
+			{
+				break;
+			}
+			ByteString name(command.property);
+			for (auto &alias : Particle::GetPropertyAliases())
+			{
+				if (name == alias.from)
+				{
+					name = alias.to;
+				}
+			}
+			auto &properties = Particle::GetProperties();
+			auto prop = std::find_if(properties.begin(), properties.end(), [&name](const StructProperty &p) {
+				return p.Name == name;
+			});
+			if (prop == properties.end())
+			{
+				break;
+			}
+			if (command.valueKind == OscCommand::NameValue && prop->Type != StructProperty::ParticleType)
+			{
+				break;
+			}
+			AccessProperty access;
+			access.propertyIndex = int(prop - properties.begin());
+			switch (prop->Type)
+			{
+			case StructProperty::ParticleType:
+				access.propertyValue = command.valueKind == OscCommand::FloatValue ? int(command.floatValue) : elementType(command);
+				break;
+
+			case StructProperty::Integer:
+				access.propertyValue = command.valueKind == OscCommand::FloatValue ? int(command.floatValue) : command.intValue;
+				break;
+
+			case StructProperty::UInteger:
+				access.propertyValue = command.valueKind == OscCommand::FloatValue ? (unsigned int)(command.floatValue) : (unsigned int)(command.intValue);
+				break;
+
+			case StructProperty::Float:
+				access.propertyValue = command.valueKind == OscCommand::FloatValue ? command.floatValue : float(command.intValue);
+				break;
+
+			default:
+				break;
+			}
+			if (access.propertyIndex == FIELD_TYPE)
+			{
+				auto type = std::get<int>(access.propertyValue);
+				if (type <= 0 || type >= PT_NUM || !sd.elements[type].Enabled)
+				{
+					break;
+				}
+			}
+			access.Set(this, command.id);
+			break;
+		}
+		}
+	}
+}
+
+// CompactParticles runs once fewer than this share of the slots up to lastActiveIndex hold
+// particles, if there are enough of those slots for it to be worth it
+constexpr int compactBelowPercent = 25;
+constexpr int compactMinIndex = 8192;
+
 //updates pmap, gol, and some other simulation stuff (but not particles)
 void Simulation::BeforeSim()
 {
+	// runs while paused too, so /tpt/pause can resume the simulation
+	if (oscClient)
+	{
+		ApplyOscCommands();
+	}
+
 	if (!sys_pause||framerender)
 	{
-		air->update_air();
+		{
+			OscPerfScope perfScope(OscPerfAir);
+			air->update_air();
+		}
+		if (oscClient)
+		{
+			oscClient->DetectOnsets(pv);
+		}
 
 		if(aheat_enable)
+		{
+			OscPerfScope perfScope(OscPerfAir);
 			air->update_airh();
+		}
 
-		DispatchNewtonianGravity();
+		{
+			OscPerfScope perfScope(OscPerfGravity);
+			DispatchNewtonianGravity();
+		}
 		// gravIn::mass is now potentially garbage, which is ok, we were going to clear it for the frame anyway
 		for (auto p : gravIn.mass.Size().OriginRect())
 		{
@@ -3689,7 +4298,14 @@ void Simulation::BeforeSim()
 	}
 
 	if (debug_nextToUpdate == 0)
+	{
+		if (compactParticles && (!sys_pause || framerender) && parts.lastActiveIndex >= compactMinIndex &&
+		    NUM_PARTS * 100 < (parts.lastActiveIndex + 1) * compactBelowPercent)
+		{
+			CompactParticles();
+		}
 		RecalcFreeParticles(true);
+	}
 
 	if (!sys_pause || framerender)
 	{
@@ -3850,18 +4466,24 @@ void Simulation::AfterSim()
 		emp_trigger_count = 0;
 	}
 
+	OscPerfCounters::SimFrame();
+	if (oscClient)
+	{
+		oscClient->UpdatePerf(NUM_PARTS, parts.lastActiveIndex);
+		// handlers were fed according to the previous frame's ranking, so send them before re-ranking
+		oscClient->AnalyzeAndSend(pv);
+		// the sample is seeded from the RNG without drawing from it, which would change the simulation
+		auto rngState = rng.state();
+		oscClient->SortParticles(rngState[0] ^ rngState[1] ^ uint64_t(frameCount));
+	}
+
 	frameCount += 1;
 }
 
-Simulation::~Simulation() {
-	delete oscClient;
-}
+Simulation::~Simulation() = default;
 
 Simulation::Simulation()
 {
-	if (oscClient == NULL)
-		oscClient = new TPTOscClient();
-
 	currentTick = 0;
 	std::fill(elementCount, elementCount+PT_NUM, 0);
 	elementRecount = true;
@@ -3918,5 +4540,55 @@ void Simulation::EnableNewtonianGravity(bool enable)
 	}
 }
 
+void Simulation::WakeTiles(int x1, int y1, int x2, int y2)
+{
+	// workers only get to touch particles near their own tile, and those are awake anyway
+	if (activityMap && !UpdateTile::Current())
+	{
+		activityMap->Wake(x1, y1, x2, y2);
+	}
+}
+
+void Simulation::WakeAllTiles()
+{
+	if (activityMap)
+	{
+		activityMap->WakeAll();
+	}
+}
+
+int Simulation::CountSleepingTiles() const
+{
+	return activityMap ? activityMap->CountAsleep() : 0;
+}
+
+uint64_t Simulation::GetSleepCheckMisses() const
+{
+	return activityMap ? activityMap->GetMisses() : 0;
+}
+
+uint64_t Simulation::GetMapDrifts() const
+{
+	return mapTracker ? mapTracker->drifts : 0;
+}
+
+void Simulation::RunOnWorkers(int count, const std::function<void(int)> &work)
+{
+	if (!workerPool)
+	{
+		workerPool = std::make_unique<WorkerPool>();
+	}
+	workerPool->Run(updateThreads, count, work);
+}
+
+bool Simulation::MaxPartsReached() const
+{
+	if (auto *tile = UpdateTile::Current())
+	{
+		return tile->Full();
+	}
+	return pfree == -1;
+}
+
 // we want XRES * YRES <= (1 << (31 - PMAPBITS)), but we do a division because multiplication could silently overflow
 static_assert(uint32_t(XRES) <= (UINT32_C(1) << (31 - PMAPBITS)) / uint32_t(YRES), "not enough space in pmap");
@@ -8,14 +8,16 @@
 #include "MenuSection.h"
 #include "AccessProperty.h"
 #include "CoordStack.h"
-#include "common/tpt-rand.h"
 #include "gravity/Gravity.h"
 #include "graphics/RendererFrame.h"
 #include "Element.h"
 #include "SimulationConfig.h"
 #include "SimulationSettings.h"
+#include "SimulationRNG.h"
+#include "MapTracker.h"
 #include <cstring>
 #include <cstddef>
+#include <functional>
 #include <vector>
 #include <array>
 #include <memory>
@@ -35,6 +37,10 @@ class Simulation;
 class Renderer;
 class Air;
 class GameSave;
+class TPTOscClient;
+class TiledUpdate;
+class WorkerPool;
+class ActivityMap;
 
 struct Parts
 {
@@ -106,7 +112,12 @@ public:
 	GravityPtr grav;
 	std::unique_ptr<Air> air;
 
-	RNG rng;
+	SimulationRNG rng;
+
+	// only set for simulations that stream analytics over OSC, see GameModel
+	std::unique_ptr<TPTOscClient> oscClient;
+	// pause state asked for by /tpt/pause, until whoever runs the simulation applies it
+	std::optional<bool> oscPauseRequest;
 
 	int replaceModeSelected = 0;
 	int replaceModeFlags = 0;
@@ -144,6 +155,27 @@ public:
 	int pretty_powder = 0;
 	int sandcolour_frame = 0;
 	int deco_space = DECOSPACE_SRGB;
+	// threads to spread UpdateParticles and the air update over, see RunOnWorkers
+	int updateThreads = 1;
+	// makes the outcome of a frame depend only on the state of the simulation, not on updateThreads
+	bool deterministicUpdate = false;
+	// skips particles in parts of the simulation that have settled, see ActivityMap; only
+	// serial whole frames do this, and not while ensureDeterminism is set
+	bool sleepingTiles = false;
+	// updates sleeping tiles anyway and counts the particles in them that changed
+	bool sleepCheck = false;
+	// keeps pmap, photons and pmap_count from one frame to the next and only fixes up what
+	// changed, see MapTracker; the free list is then left as kill_part and create_part leave it,
+	// rather than rebuilt in id order, so new particles get different ids
+	bool incrementalMaps = false;
+	// checks each incremental rebuild against a full one, and falls back to the full one if
+	// they differ
+	bool validateMaps = false;
+	// moves particles down into free slots once few of those up to lastActiveIndex are in use,
+	// see CompactParticles
+	bool compactParticles = false;
+	// old id, new id of each particle the last CompactParticles moved, until someone takes them
+	std::vector<std::pair<int, int>> compactedIds;
 
 	// initialized in clear_sim
 	bool elementRecount;
@@ -203,9 +235,25 @@ public:
 	int parts_avg(int ci, int ni, int t);
 	bool IsHeatInsulator(Particle) const;
 	void UpdateParticles(int start, int end); // Dispatches an update to the range [start, end).
+
+	// what UpdateParticle passes from one stage of updating a particle to the next
+	struct ParticleStep
+	{
+		int x, y, t;
+		int surround_space, nt;
+		float pGravX, pGravY;
+		bool transitionOccurred;
+	};
+	void UpdateParticle(int i);
+	bool PrepareParticle(int i, ParticleStep &step);
+	bool CallParticleUpdate(int i, ParticleStep &step);
+	void MoveParticle(int i, const ParticleStep &step);
+	void DragAir(int i, int t, int x, int y);
 	void SimulateGoL();
 	void RecalcFreeParticles(bool do_life_dec);
+	int CompactParticles();
 	void CheckStacking();
+	void ApplyOscCommands();
 	void BeforeSim();
 	void AfterSim();
 	void clear_area(int area_x, int area_y, int area_w, int area_h);
@@ -254,10 +302,28 @@ public:
 
 	void EnableNewtonianGravity(bool enable);
 
-	bool MaxPartsReached() const
+	bool MaxPartsReached() const;
+
+	// for anything that changes particles outside of create_part, kill_part, part_change_type
+	// and move; particle coordinates, inclusive
+	void WakeTiles(int x1, int y1, int x2, int y2);
+	void WakeAllTiles();
+	int CountSleepingTiles() const;
+	uint64_t GetSleepCheckMisses() const;
+
+	// for anything that enters a particle into pmap or photons, or changes pmap_count, other than
+	// RecalcFreeParticles
+	void MarkMapped(int x, int y)
 	{
-		return pfree == -1;
+		if (mapTracker)
+		{
+			mapTracker->MarkDirty(x, y);
+		}
 	}
+	uint64_t GetMapDrifts() const;
+
+	// calls work(k) for each k in [0, count) on updateThreads threads, see WorkerPool
+	void RunOnWorkers(int count, const std::function<void(int)> &work);
 
 private:
 	CoordStack& getCoordStackSingleton();
@@ -267,4 +333,12 @@ private:
 	void UpdateGravityMask();
 
 	int pfree;
+
+	std::unique_ptr<WorkerPool> workerPool;
+	std::unique_ptr<TiledUpdate> tiledUpdate;
+	std::unique_ptr<ActivityMap> activityMap; // only while sleepingTiles is in effect
+	std::unique_ptr<MapTracker> mapTracker; // only while incrementalMaps is set
+
+	void RecalcMapsIncrementally();
+	friend class TiledUpdate;
 };
@@ -0,0 +1,54 @@
+#pragma once
+#include "common/tpt-rand.h"
+
+// Simulation::rng. While a worker of a tiled particle update (see TiledUpdate) is updating a
+// tile, draws come from the RNG of that tile instead, so that what a tile does depends only on
+// the seed it was given and not on which thread got to it first. Everywhere else this is just
+// the RNG it derives from.
+class SimulationRNG : public RNG
+{
+	static inline constinit thread_local RNG *tileRng = nullptr;
+
+	RNG &Current()
+	{
+		return tileRng ? *tileRng : *static_cast<RNG *>(this);
+	}
+
+public:
+	SimulationRNG &operator =(const RNG &other)
+	{
+		RNG::operator =(other);
+		return *this;
+	}
+
+	unsigned int operator()()
+	{
+		return Current()();
+	}
+
+	unsigned int gen()
+	{
+		return Current().gen();
+	}
+
+	int between(int lower, int upper)
+	{
+		return Current().between(lower, upper);
+	}
+
+	bool chance(int numerator, unsigned int denominator)
+	{
+		return Current().chance(numerator, denominator);
+	}
+
+	float uniform01()
+	{
+		return Current().uniform01();
+	}
+
+	// for the calling thread, nullptr to go back to the shared state
+	static void SetTileRng(RNG *newTileRng)
+	{
+		tileRng = newTileRng;
+	}
+};
@@ -0,0 +1,407 @@
+#include "TiledUpdate.h"
+#include "ElementClasses.h"
+#include "SimulationData.h"
+#include "osc/osc.h"
+#include <algorithm>
+#include <cmath>
+
+// free ids a tile may use in deterministic mode, on top of one per eight particles in it
+constexpr int reserveBase = 64;
+
+static uint64_t splitMix64(uint64_t &x)
+{
+	auto z = (x += UINT64_C(0x9E3779B97F4A7C15));
+	z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+	z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+	return z ^ (z >> 31);
+}
+
+int UpdateTile::AllocateId()
+{
+	int i;
+	if (owner->deterministic)
+	{
+		if (reservedUsed == reserved.size())
+		{
+			return -1;
+		}
+		i = reserved[reservedUsed++];
+	}
+	else
+	{
+		i = owner->PopFree();
+		if (i == -1)
+		{
+			return -1;
+		}
+	}
+	numParts += 1;
+	if (i > lastActiveIndex)
+	{
+		lastActiveIndex = i;
+	}
+	return i;
+}
+
+bool UpdateTile::Full() const
+{
+	if (owner->deterministic)
+	{
+		return reservedUsed == reserved.size();
+	}
+	return owner->FreeListEmpty();
+}
+
+TiledUpdate::TiledUpdate(Simulation &newSim) : sim(newSim)
+{
+	for (int ty = 0; ty < UPDATE_TILES_Y; ++ty)
+	{
+		for (int tx = 0; tx < UPDATE_TILES_X; ++tx)
+		{
+			auto index = ty * UPDATE_TILES_X + tx;
+			auto &tile = tiles[index];
+			tile.owner = this;
+			tile.x0 = tx * UPDATE_TILE_SIZE;
+			tile.y0 = ty * UPDATE_TILE_SIZE;
+			tile.x1 = std::min(tile.x0 + UPDATE_TILE_SIZE, XRES);
+			tile.y1 = std::min(tile.y0 + UPDATE_TILE_SIZE, YRES);
+		}
+	}
+}
+
+// Whole frames stay serial if something could reach anywhere in the simulation from anywhere,
+// like Lua callbacks, or elements that keep global state in their ChangeType and CreateAllowed
+// functions, which any particle that kills one or turns into one calls.
+bool TiledUpdate::CanUpdateTiled() const
+{
+	if (sim.ensureDeterminism || sim.edgeMode == EDGE_LOOP)
+	{
+		return false;
+	}
+	auto &elements = SimulationData::CRef().elements;
+	auto &builtinElements = GetElements();
+	for (int t = 0; t < PT_NUM; ++t)
+	{
+		if (elements[t].Update        != builtinElements[t].Update ||
+		    elements[t].Create        != builtinElements[t].Create ||
+		    elements[t].CreateAllowed != builtinElements[t].CreateAllowed ||
+		    elements[t].ChangeType    != builtinElements[t].ChangeType)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool TiledUpdate::Scan()
+{
+	auto &sd = SimulationData::CRef();
+	auto &elements = sd.elements;
+	std::array<bool, PT_NUM> global;
+	for (int t = 0; t < PT_NUM; ++t)
+	{
+		global[t] = elements[t].Enabled && (elements[t].Properties & PROP_SERIAL) && (elements[t].ChangeType || elements[t].CreateAllowed);
+	}
+	// particles moving into PRTI fill portalp in try_move
+	global[PT_PRTI] = true;
+
+	for (auto &tile : tiles)
+	{
+		tile.ids.clear();
+		// detector walls flood emap along connected wires whenever a particle touches them
+		tile.serial = false;
+		auto cx0 = std::max(tile.x0 - UPDATE_TILE_HALO, 0) / CELL;
+		auto cy0 = std::max(tile.y0 - UPDATE_TILE_HALO, 0) / CELL;
+		auto cx1 = std::min(tile.x1 + UPDATE_TILE_HALO, XRES) / CELL;
+		auto cy1 = std::min(tile.y1 + UPDATE_TILE_HALO, YRES) / CELL;
+		for (auto cy = cy0; cy < cy1 && !tile.serial; ++cy)
+		{
+			for (auto cx = cx0; cx < cx1; ++cx)
+			{
+				if (sim.bmap[cy][cx] == WL_DETECT)
+				{
+					tile.serial = true;
+					break;
+				}
+			}
+		}
+	}
+	tail.clear();
+	auto &parts = sim.parts;
+	for (int i = 0; i <= parts.lastActiveIndex; ++i)
+	{
+		auto t = parts[i].type;
+		if (!t)
+		{
+			continue;
+		}
+		auto ctype = parts[i].ctype;
+		if (global[t] || (sd.IsElement(ctype) && global[ctype]))
+		{
+			return false;
+		}
+		auto x = int(parts[i].x + 0.5f);
+		auto y = int(parts[i].y + 0.5f);
+		if (!(elements[t].Properties & PROP_SERIAL) && x >= 0 && y >= 0 && x < XRES && y < YRES)
+		{
+			auto &tile = tiles[(y / UPDATE_TILE_SIZE) * UPDATE_TILES_X + x / UPDATE_TILE_SIZE];
+			if (!tile.serial)
+			{
+				tile.ids.push_back(i);
+				continue;
+			}
+		}
+		tail.push_back({ i, UpdateTile::DeferWhole, t });
+	}
+	return true;
+}
+
+bool TiledUpdate::Run(bool newDeterministic)
+{
+	if (!CanUpdateTiled() || !Scan())
+	{
+		return false;
+	}
+	deterministic = newDeterministic;
+
+	// in two statements, the order operands of | are evaluated in is up to the compiler
+	uint64_t seed = uint64_t(sim.rng()) << 32;
+	seed |= sim.rng();
+	for (auto &phaseTileList : phaseTiles)
+	{
+		phaseTileList.clear();
+	}
+	for (int index = 0; index < UPDATE_TILES; ++index)
+	{
+		auto &tile = tiles[index];
+		auto tileSeed = seed + uint64_t(index) * UINT64_C(0x632BE59BD9B4E019);
+		tile.rng.state({ splitMix64(tileSeed), splitMix64(tileSeed) });
+		tile.deferred.clear();
+		tile.released.clear();
+		tile.oscEvents.clear();
+		tile.elementCount.fill(0);
+		tile.numParts = 0;
+		tile.lastActiveIndex = sim.parts.lastActiveIndex;
+		if (!tile.ids.empty())
+		{
+			auto tx = index % UPDATE_TILES_X;
+			auto ty = index / UPDATE_TILES_X;
+			phaseTiles[(ty % 2) * 2 + tx % 2].push_back(index);
+		}
+	}
+
+	for (auto &phaseTileList : phaseTiles)
+	{
+		if (deterministic)
+		{
+			for (auto index : phaseTileList)
+			{
+				ReserveIds(tiles[index]);
+			}
+		}
+		RunPhase(phaseTileList);
+		// in reverse, so the free list ends up as it was, minus the ids that were used
+		for (auto it = phaseTileList.rbegin(); it != phaseTileList.rend(); ++it)
+		{
+			auto &tile = tiles[*it];
+			for (auto k = tile.reserved.size(); k > tile.reservedUsed; --k)
+			{
+				auto i = tile.reserved[k - 1];
+				sim.parts[i].life = sim.pfree;
+				sim.pfree = i;
+			}
+			tile.reserved.clear();
+			tile.reservedUsed = 0;
+		}
+		for (auto index : phaseTileList)
+		{
+			MergeTile(tiles[index]);
+		}
+	}
+
+	for (auto &tile : tiles)
+	{
+		for (auto i : tile.released)
+		{
+			sim.parts[i].life = sim.pfree;
+			sim.pfree = i;
+		}
+		tail.insert(tail.end(), tile.deferred.begin(), tile.deferred.end());
+	}
+	RunTail();
+	return true;
+}
+
+void TiledUpdate::ReserveIds(UpdateTile &tile)
+{
+	auto want = reserveBase + tile.ids.size() / 8;
+	tile.reserved.clear();
+	tile.reservedUsed = 0;
+	while (tile.reserved.size() < want && sim.pfree != -1)
+	{
+		tile.reserved.push_back(sim.pfree);
+		sim.pfree = sim.parts[sim.pfree].life;
+	}
+}
+
+int TiledUpdate::PopFree()
+{
+	std::unique_lock lk(freeMx);
+	auto i = sim.pfree;
+	if (i != -1)
+	{
+		sim.pfree = sim.parts[i].life;
+	}
+	return i;
+}
+
+bool TiledUpdate::FreeListEmpty()
+{
+	std::unique_lock lk(freeMx);
+	return sim.pfree == -1;
+}
+
+void TiledUpdate::MergeTile(UpdateTile &tile)
+{
+	for (int t = 0; t < PT_NUM; ++t)
+	{
+		sim.elementCount[t] += tile.elementCount[t];
+	}
+	tile.elementCount.fill(0);
+	sim.NUM_PARTS += tile.numParts;
+	tile.numParts = 0;
+	if (tile.lastActiveIndex > sim.parts.lastActiveIndex)
+	{
+		sim.parts.lastActiveIndex = tile.lastActiveIndex;
+	}
+	if (sim.oscClient)
+	{
+		sim.oscClient->MergeTile(tile.oscAccumulator);
+		for (auto &event : tile.oscEvents)
+		{
+			sim.oscClient->RecordEvent(event.kind, event.type, event.x, event.y, event.temp);
+		}
+	}
+	tile.oscEvents.clear();
+}
+
+// Whether everything MoveParticle may touch is within reach of the tile. That is the path
+// to where the particle is headed, the surface get_normal traces around if it bounces off
+// something, and for liquids, the sideways search for a way down. flood_water may go anywhere.
+bool TiledUpdate::CanMove(const UpdateTile &tile, int i, const Simulation::ParticleStep &step) const
+{
+	auto &elements = SimulationData::CRef().elements;
+	auto &element = elements[step.t];
+	auto &part = sim.parts[i];
+	if (element.Falldown > 1 && (sim.grav || sim.gravityMode != GRAV_VERTICAL))
+	{
+		return false;
+	}
+	if (element.Falldown == 2 && sim.water_equal_test)
+	{
+		return false;
+	}
+	auto v = std::max(std::abs(part.vx), std::abs(part.vy));
+	auto reach = v * (1.0f + float(NORMAL_INTERP) / NORMAL_FRAC) + SURF_RANGE + 3 + (element.Falldown > 1 ? 31 : 0);
+	// written so that a NaN velocity counts as out of reach
+	return step.x - reach >= tile.x0 - UPDATE_TILE_HALO && step.x + reach < tile.x1 + UPDATE_TILE_HALO &&
+	       step.y - reach >= tile.y0 - UPDATE_TILE_HALO && step.y + reach < tile.y1 + UPDATE_TILE_HALO;
+}
+
+void TiledUpdate::UpdateTileParticles(UpdateTile &tile)
+{
+	auto &elements = SimulationData::CRef().elements;
+	auto &parts = sim.parts;
+	UpdateTile::current = &tile;
+	SimulationRNG::SetTileRng(&tile.rng);
+	for (auto i : tile.ids)
+	{
+		auto t = parts[i].type;
+		if (!t)
+		{
+			continue;
+		}
+		// pushed out of the tile by a particle of a neighbouring tile, or changed into
+		// something that has to be updated serially since the frame started
+		auto x = int(parts[i].x + 0.5f);
+		auto y = int(parts[i].y + 0.5f);
+		if (!tile.Contains(x, y) || (elements[t].Properties & PROP_SERIAL))
+		{
+			tile.deferred.push_back({ i, UpdateTile::DeferWhole, t });
+			continue;
+		}
+		// like the serial loop, feeds OSC analytics before the particle is updated, but into
+		// the tile's own accumulator
+		if (sim.oscClient)
+		{
+			sim.oscClient->AccumulateParticle(parts[i], tile.oscAccumulator);
+		}
+		Simulation::ParticleStep step;
+		if (!sim.PrepareParticle(i, step))
+		{
+			continue;
+		}
+		if (elements[step.t].Properties & PROP_SERIAL)
+		{
+			tile.deferred.push_back({ i, UpdateTile::DeferUpdate, parts[i].type, step });
+			continue;
+		}
+		if (!sim.CallParticleUpdate(i, step))
+		{
+			continue;
+		}
+		if (!CanMove(tile, i, step))
+		{
+			tile.deferred.push_back({ i, UpdateTile::DeferMove, parts[i].type, step });
+			continue;
+		}
+		sim.MoveParticle(i, step);
+	}
+	SimulationRNG::SetTileRng(nullptr);
+	UpdateTile::current = nullptr;
+}
+
+void TiledUpdate::RunTail()
+{
+	std::sort(tail.begin(), tail.end(), [](auto &lhs, auto &rhs) {
+		return lhs.id < rhs.id;
+	});
+	auto &parts = sim.parts;
+	for (auto &deferred : tail)
+	{
+		auto i = deferred.id;
+		if (!parts[i].type)
+		{
+			continue;
+		}
+		sim.debug_mostRecentlyUpdated = i;
+		if (deferred.stage == UpdateTile::DeferWhole)
+		{
+			if (sim.oscClient)
+			{
+				sim.oscClient->AccumulateParticle(parts[i]);
+			}
+			sim.UpdateParticle(i);
+			continue;
+		}
+		// skip particles that were killed, replaced or moved since they were deferred, as their
+		// step no longer describes them
+		auto &step = deferred.step;
+		if (parts[i].type != deferred.type || int(parts[i].x + 0.5f) != step.x || int(parts[i].y + 0.5f) != step.y)
+		{
+			continue;
+		}
+		if (deferred.stage == UpdateTile::DeferUpdate && !sim.CallParticleUpdate(i, step))
+		{
+			continue;
+		}
+		sim.MoveParticle(i, step);
+	}
+}
+
+void TiledUpdate::RunPhase(const std::vector<int> &phase)
+{
+	sim.RunOnWorkers(int(phase.size()), [this, &phase](int k) {
+		UpdateTileParticles(tiles[phase[k]]);
+	});
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include "Simulation.h"
+#include "common/tpt-rand.h"
+#include "osc/accumulator.h"
+#include "osc/events.h"
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Tiles are updated in four phases of a 2x2 checkerboard, so tiles updated at the same time are
+// a whole tile apart. A particle updated on a worker may reach up to UPDATE_TILE_HALO outside
+// its tile, anything that would reach further is left for the serial tail of the frame.
+constexpr int UPDATE_TILE_SIZE = 80;
+constexpr int UPDATE_TILE_HALO = UPDATE_TILE_SIZE / 2;
+constexpr int UPDATE_TILES_X   = (XRES + UPDATE_TILE_SIZE - 1) / UPDATE_TILE_SIZE;
+constexpr int UPDATE_TILES_Y   = (YRES + UPDATE_TILE_SIZE - 1) / UPDATE_TILE_SIZE;
+constexpr int UPDATE_TILES     = UPDATE_TILES_X * UPDATE_TILES_Y;
+constexpr int UPDATE_PHASES    = 4;
+
+class TiledUpdate;
+
+// What happens to the shared counters of the simulation while a tile is being updated. The
+// serial code changes them directly, see Simulation::kill_part and friends; on a worker the
+// changes are collected here and merged in tile order once the phase is over.
+struct UpdateTile
+{
+	enum DeferredStage
+	{
+		DeferWhole,  // not started
+		DeferUpdate, // PrepareParticle done
+		DeferMove,   // CallParticleUpdate done
+	};
+	struct Deferred
+	{
+		int id;
+		DeferredStage stage;
+		int type; // at the time it was deferred
+		Simulation::ParticleStep step;
+	};
+	struct OscEvent
+	{
+		OscEventKind kind;
+		int type, x, y;
+		float temp;
+	};
+
+	TiledUpdate *owner = nullptr;
+	int x0 = 0, y0 = 0, x1 = 0, y1 = 0; // [x0, x1) x [y0, y1)
+	bool serial = false; // has detector walls within reach, which may flood emap anywhere
+	RNG rng;
+
+	std::vector<int> ids; // particles that started the frame in the tile, in update order
+	std::vector<Deferred> deferred;
+	std::vector<int> released; // killed, go back to the free list after the last phase
+	std::vector<int> reserved; // deterministic mode: free ids this tile may use
+	size_t reservedUsed = 0;
+	std::array<int, PT_NUM> elementCount;
+	int numParts = 0;
+	int lastActiveIndex = 0;
+	std::vector<OscEvent> oscEvents;
+	OscTileAccumulator oscAccumulator;
+
+	bool Contains(int x, int y) const
+	{
+		return x >= x0 && x < x1 && y >= y0 && y < y1;
+	}
+
+	int AllocateId(); // -1 if there are no free ids left for this tile
+	bool Full() const;
+
+	// the tile being updated on the calling thread, if any
+	static UpdateTile *Current()
+	{
+		return current;
+	}
+
+private:
+	static inline constinit thread_local UpdateTile *current = nullptr;
+	friend class TiledUpdate;
+};
+
+// Runs Simulation::UpdateParticles(0, NPART) on several threads. Each phase hands its tiles to
+// Simulation::RunOnWorkers, then whatever had to wait is updated serially in id order.
+// Particles of elements with PROP_SERIAL, particles near detector walls, and moves that would
+// leave the reach of their tile are among those.
+//
+// Tiles draw from their own RNG, seeded from Simulation::rng at the start of the frame. In
+// deterministic mode they also allocate from chunks of the free list reserved in tile order,
+// so the outcome of a frame does not depend on the number of threads, or on which thread got
+// to a tile first; otherwise they share the free list.
+class TiledUpdate
+{
+public:
+	TiledUpdate(Simulation &newSim);
+
+	// returns false without having changed anything if the frame has to be updated serially
+	bool Run(bool newDeterministic);
+
+private:
+	Simulation &sim;
+	std::array<UpdateTile, UPDATE_TILES> tiles;
+	std::array<std::vector<int>, UPDATE_PHASES> phaseTiles;
+	std::vector<UpdateTile::Deferred> tail;
+	bool deterministic = false;
+	std::mutex freeMx; // guards the free list during phases unless deterministic
+
+	bool CanUpdateTiled() const;
+	bool Scan();
+	bool CanMove(const UpdateTile &tile, int i, const Simulation::ParticleStep &step) const;
+	void UpdateTileParticles(UpdateTile &tile);
+	void RunPhase(const std::vector<int> &phase);
+	void ReserveIds(UpdateTile &tile);
+	void MergeTile(UpdateTile &tile);
+	void RunTail();
+
+	int PopFree();
+	bool FreeListEmpty();
+	friend struct UpdateTile;
+};
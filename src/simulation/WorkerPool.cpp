@@ -0,0 +1,105 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+WorkerPool::~WorkerPool()
+{
+	StopWorkers();
+}
+
+void WorkerPool::Run(int threads, int count, const Work &newWork)
+{
+	SetThreads(threads);
+	{
+		std::unique_lock lk(poolMx);
+		work = &newWork;
+		workCount = count;
+		nextWork.store(0, std::memory_order_relaxed);
+		busyWorkers = int(workers.size());
+		generation += 1;
+	}
+	workCv.notify_all();
+	TakeWork();
+	std::unique_lock lk(poolMx);
+	doneCv.wait(lk, [this]() {
+		return busyWorkers == 0;
+	});
+}
+
+void WorkerPool::TakeWork()
+{
+	while (true)
+	{
+		auto k = nextWork.fetch_add(1, std::memory_order_relaxed);
+		if (k >= workCount)
+		{
+			break;
+		}
+		(*work)(k);
+	}
+}
+
+// starts from the generation that was current when the worker was spawned, so that it waits for
+// the next run rather than joining the last one
+void WorkerPool::WorkLoop(uint64_t seenGeneration)
+{
+	while (true)
+	{
+		{
+			std::unique_lock lk(poolMx);
+			workCv.wait(lk, [this, seenGeneration]() {
+				return shouldStop || generation != seenGeneration;
+			});
+			if (shouldStop)
+			{
+				break;
+			}
+			seenGeneration = generation;
+		}
+		TakeWork();
+		{
+			std::unique_lock lk(poolMx);
+			busyWorkers -= 1;
+			if (busyWorkers)
+			{
+				continue;
+			}
+		}
+		doneCv.notify_one();
+	}
+}
+
+void WorkerPool::SetThreads(int threads)
+{
+	auto wantWorkers = std::max(threads, 1) - 1;
+	if (int(workers.size()) == wantWorkers)
+	{
+		return;
+	}
+	StopWorkers();
+	uint64_t startGeneration;
+	{
+		std::unique_lock lk(poolMx);
+		shouldStop = false;
+		startGeneration = generation;
+	}
+	for (int k = 0; k < wantWorkers; ++k)
+	{
+		workers.emplace_back([this, startGeneration]() {
+			WorkLoop(startGeneration);
+		});
+	}
+}
+
+void WorkerPool::StopWorkers()
+{
+	{
+		std::unique_lock lk(poolMx);
+		shouldStop = true;
+	}
+	workCv.notify_all();
+	for (auto &worker : workers)
+	{
+		worker.join();
+	}
+	workers.clear();
+}
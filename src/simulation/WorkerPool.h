@@ -0,0 +1,40 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs a function over a range of indices on a pool of workers. The calling thread takes indices
+// off a shared cursor along with the workers, and the workers wait for the next run in between.
+// Simulation keeps one that TiledUpdate and the air update share, see Simulation::RunOnWorkers.
+class WorkerPool
+{
+public:
+	using Work = std::function<void(int)>;
+
+	~WorkerPool();
+
+	// calls work(k) for each k in [0, count) on threads threads, counting the calling one, and
+	// returns once all of them are done
+	void Run(int threads, int count, const Work &newWork);
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex poolMx;
+	std::condition_variable workCv;
+	std::condition_variable doneCv;
+	uint64_t generation = 0;
+	bool shouldStop = false;
+	const Work *work = nullptr;
+	int workCount = 0;
+	std::atomic<int> nextWork = 0;
+	int busyWorkers = 0;
+
+	void TakeWork();
+	void SetThreads(int threads);
+	void StopWorkers();
+	void WorkLoop(uint64_t seenGeneration);
+};
@@ -32,7 +32,7 @@ void Element::Element_ARAY()
 	HeatConduct = 0;
 	Description = "Ray Emitter. Rays create points when they collide.";
 
-	Properties = TYPE_SOLID;
+	Properties = TYPE_SOLID | PROP_SERIAL;
 
 	LowPressure = IPL;
 	LowPressureTransition = NT;
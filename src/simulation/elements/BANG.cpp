@@ -31,7 +31,7 @@ void Element::Element_BANG()
 	HeatConduct = 88;
 	Description = "TNT, explodes all at once.";
 
-	Properties = TYPE_SOLID | PROP_NEUTPENETRATE;
+	Properties = TYPE_SOLID | PROP_NEUTPENETRATE | PROP_SERIAL;
 
 	LowPressure = IPL;
 	LowPressureTransition = NT;
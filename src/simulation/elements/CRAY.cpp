@@ -34,7 +34,7 @@ void Element::Element_CRAY()
 	HeatConduct = 0;
 	Description = "Particle Ray Emitter. Creates a beam of particles set by its ctype, with a range set by tmp.";
 
-	Properties = TYPE_SOLID;
+	Properties = TYPE_SOLID | PROP_SERIAL;
 	CarriesTypeIn = 1U << FIELD_CTYPE;
 
 	LowPressure = IPL;
@@ -31,7 +31,7 @@ void Element::Element_DRAY()
 	HeatConduct = 0;
 	Description = "Duplicator ray. Replicates a line of particles in front of it.";
 
-	Properties = TYPE_SOLID;
+	Properties = TYPE_SOLID | PROP_SERIAL;
 	CarriesTypeIn = 1U << FIELD_CTYPE;
 
 	LowPressure = IPL;
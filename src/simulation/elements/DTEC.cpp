@@ -31,7 +31,7 @@ void Element::Element_DTEC()
 	HeatConduct = 0;
 	Description = "Detector, creates a spark when something with its ctype is nearby.";
 
-	Properties = TYPE_SOLID;
+	Properties = TYPE_SOLID | PROP_SERIAL;
 	CarriesTypeIn = 1U << FIELD_CTYPE;
 
 	LowPressure = IPL;
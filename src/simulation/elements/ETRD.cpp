@@ -34,7 +34,7 @@ void Element::Element_ETRD()
 	HeatConduct = 251;
 	Description = "Electrode. Creates plasma arcs with electricity. (Use sparingly)";
 
-	Properties = TYPE_SOLID|PROP_CONDUCTS|PROP_LIFE_DEC;
+	Properties = TYPE_SOLID|PROP_CONDUCTS|PROP_LIFE_DEC|PROP_SERIAL;
 
 	LowPressure = IPL;
 	LowPressureTransition = NT;
@@ -37,7 +37,7 @@ void Element::Element_FIGH()
 	HeatConduct = 0;
 	Description = "Fighter. Tries to kill stickmen. You must first give it an element to kill him with.";
 
-	Properties = PROP_NOCTYPEDRAW;
+	Properties = PROP_NOCTYPEDRAW | PROP_SERIAL;
 	CarriesTypeIn = 1U << FIELD_CTYPE;
 
 	LowPressure = IPL;
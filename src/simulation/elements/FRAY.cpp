@@ -32,7 +32,7 @@ void Element::Element_FRAY()
 	HeatConduct = 0;
 	Description = "Force Emitter. Pushes or pulls objects based on its temperature. Use like ARAY.";
 
-	Properties = TYPE_SOLID;
+	Properties = TYPE_SOLID | PROP_SERIAL;
 
 	LowPressure = IPL;
 	LowPressureTransition = NT;
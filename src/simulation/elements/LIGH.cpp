@@ -36,7 +36,7 @@ void Element::Element_LIGH()
 	HeatConduct = 0;
 	Description = "Lightning. Change the brush size to set the size of the lightning.";
 
-	Properties = TYPE_SOLID;
+	Properties = TYPE_SOLID | PROP_SERIAL;
 
 	LowPressure = IPL;
 	LowPressureTransition = NT;
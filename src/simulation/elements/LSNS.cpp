@@ -32,7 +32,7 @@ void Element::Element_LSNS()
 	HeatConduct = 0;
 	Description = "Life sensor, creates a spark when there's a nearby particle with a life higher than its temperature.";
 
-	Properties = TYPE_SOLID;
+	Properties = TYPE_SOLID | PROP_SERIAL;
 
 	LowPressure = IPL;
 	LowPressureTransition = NT;
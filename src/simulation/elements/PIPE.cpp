@@ -37,7 +37,7 @@ void Element::Element_PIPE()
 	HeatConduct = 251;
 	Description = "PIPE, moves particles around. Once the BRCK generates, erase some for the exit. Then the PIPE generates and is usable.";
 
-	Properties = TYPE_SOLID | PROP_LIFE_DEC;
+	Properties = TYPE_SOLID | PROP_LIFE_DEC | PROP_SERIAL;
 	CarriesTypeIn = 1U << FIELD_CTYPE;
 
 	LowPressure = IPL;
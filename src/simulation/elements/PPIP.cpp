@@ -31,7 +31,7 @@ void Element::Element_PPIP()
 	HeatConduct = 251;
 	Description = "Powered version of PIPE, use PSCN/NSCN to Activate/Deactivate.";
 
-	Properties = TYPE_SOLID | PROP_LIFE_DEC;
+	Properties = TYPE_SOLID | PROP_LIFE_DEC | PROP_SERIAL;
 	CarriesTypeIn = 1U << FIELD_CTYPE;
 
 	LowPressure = IPL;
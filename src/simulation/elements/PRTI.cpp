@@ -36,7 +36,7 @@ void Element::Element_PRTI()
 	HeatConduct = 0;
 	Description = "Portal IN. Particles go in here. Also has temperature dependent channels. (same as WIFI)";
 
-	Properties = TYPE_SOLID;
+	Properties = TYPE_SOLID | PROP_SERIAL;
 
 	LowPressure = IPL;
 	LowPressureTransition = NT;
@@ -34,7 +34,7 @@ void Element::Element_PRTO()
 	HeatConduct = 0;
 	Description = "Portal OUT. Particles come out here. Also has temperature dependent channels. (same as WIFI)";
 
-	Properties = TYPE_SOLID;
+	Properties = TYPE_SOLID | PROP_SERIAL;
 
 	LowPressure = IPL;
 	LowPressureTransition = NT;
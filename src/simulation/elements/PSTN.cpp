@@ -38,7 +38,7 @@ void Element::Element_PSTN()
 	HeatConduct = 0;
 	Description = "Piston, pushes particles. PSCN extends, NSCN retracts";
 
-	Properties = TYPE_SOLID;
+	Properties = TYPE_SOLID | PROP_SERIAL;
 	CarriesTypeIn = 1U << FIELD_CTYPE;
 
 	LowPressure = IPL;
@@ -319,6 +319,7 @@ static int MoveStack(Simulation * sim, int stackX, int stackY, int directionX, i
 				sim->parts[jP].x = float(destX);
 				sim->parts[jP].y = float(destY);
 				sim->pmap[destY][destX] = PMAP(jP, sim->parts[jP].type);
+				sim->MarkMapped(destX, destY);
 			}
 			return amount;
 		}
@@ -342,6 +343,7 @@ static int MoveStack(Simulation * sim, int stackX, int stackY, int directionX, i
 				sim->parts[jP].x = float(destX);
 				sim->parts[jP].y = float(destY);
 				sim->pmap[destY][destX] = PMAP(jP, sim->parts[jP].type);
+				sim->MarkMapped(destX, destY);
 			}
 			return possibleMovement;
 		}
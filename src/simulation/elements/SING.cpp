@@ -32,7 +32,7 @@ void Element::Element_SING()
 	HeatConduct = 70;
 	Description = "Singularity. Creates huge amounts of negative pressure and destroys everything.";
 
-	Properties = TYPE_PART|PROP_LIFE_DEC;
+	Properties = TYPE_PART|PROP_LIFE_DEC|PROP_SERIAL;
 
 	LowPressure = IPL;
 	LowPressureTransition = NT;
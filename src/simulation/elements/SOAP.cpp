@@ -35,7 +35,7 @@ void Element::Element_SOAP()
 	HeatConduct = 29;
 	Description = "Soap. Creates bubbles, washes off deco color, and cures virus.";
 
-	Properties = TYPE_LIQUID|PROP_NEUTPENETRATE|PROP_LIFE_DEC;
+	Properties = TYPE_LIQUID|PROP_NEUTPENETRATE|PROP_LIFE_DEC|PROP_SERIAL;
 
 	LowPressure = IPL;
 	LowPressureTransition = NT;
@@ -32,7 +32,7 @@ void Element::Element_SPAWN()
 	HeatConduct = 0;
 	Description = "STKM spawn point.";
 
-	Properties = TYPE_SOLID;
+	Properties = TYPE_SOLID | PROP_SERIAL;
 
 	LowPressure = IPL;
 	LowPressureTransition = NT;
@@ -32,7 +32,7 @@ void Element::Element_SPAWN2()
 	HeatConduct = 0;
 	Description = "STK2 spawn point.";
 
-	Properties = TYPE_SOLID;
+	Properties = TYPE_SOLID | PROP_SERIAL;
 
 	LowPressure = IPL;
 	LowPressureTransition = NT;
@@ -37,7 +37,7 @@ void Element::Element_SPRK()
 	HeatConduct = 251;
 	Description = "Electricity. The basis of all electronics in TPT, travels along conductive elements.";
 
-	Properties = TYPE_SOLID|PROP_LIFE_DEC;
+	Properties = TYPE_SOLID|PROP_LIFE_DEC|PROP_SERIAL;
 	CarriesTypeIn = 1U << FIELD_CTYPE;
 
 	LowPressure = IPL;
@@ -37,7 +37,7 @@ void Element::Element_STKM()
 	HeatConduct = 0;
 	Description = "Stickman. Don't kill him! Control with the arrow keys.";
 
-	Properties = PROP_NOCTYPEDRAW;
+	Properties = PROP_NOCTYPEDRAW | PROP_SERIAL;
 	CarriesTypeIn = 1U << FIELD_CTYPE;
 
 	LowPressure = IPL;
@@ -37,7 +37,7 @@ void Element::Element_STKM2()
 	HeatConduct = 0;
 	Description = "Second stickman. Don't kill him! Control with wasd.";
 
-	Properties = PROP_NOCTYPEDRAW;
+	Properties = PROP_NOCTYPEDRAW | PROP_SERIAL;
 	CarriesTypeIn = 1U << FIELD_CTYPE;
 
 	LowPressure = IPL;
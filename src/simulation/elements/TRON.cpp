@@ -38,7 +38,7 @@ void Element::Element_TRON()
 	HeatConduct = 40;
 	Description = "Smart particles, Travels in straight lines and avoids obstacles. Grows with time.";
 
-	Properties = TYPE_SOLID|PROP_LIFE_DEC|PROP_LIFE_KILL;
+	Properties = TYPE_SOLID|PROP_LIFE_DEC|PROP_LIFE_KILL|PROP_SERIAL;
 
 	LowPressure = IPL;
 	LowPressureTransition = NT;
@@ -32,7 +32,7 @@ void Element::Element_VSNS()
 	HeatConduct = 0;
 	Description = "Velocity sensor, creates a spark when there's a nearby particle with velocity higher than its temperature.";
 
-	Properties = TYPE_SOLID;
+	Properties = TYPE_SOLID | PROP_SERIAL;
 
 	LowPressure = IPL;
 	LowPressureTransition = NT;
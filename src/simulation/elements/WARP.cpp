@@ -78,6 +78,8 @@ static int update(UPDATE_FUNC_ARGS)
 				parts[i].life += 4;
 				pmap[y][x] = r;
 				pmap[y + ry][x + rx] = PMAP(i, parts[i].type);
+				sim->MarkMapped(x, y);
+				sim->MarkMapped(x + rx, y + ry);
 				trade = 5;
 			}
 		}
@@ -50,6 +50,8 @@ static int perform(SimTool *tool, Simulation * sim, Particle * cpart, int x, int
 	sim->pmap[newY][newX] = thisPart;
 	sim->parts[ID(thisPart)].x = float(newX);
 	sim->parts[ID(thisPart)].y = float(newY);
+	sim->MarkMapped(x, y);
+	sim->MarkMapped(newX, newY);
 
 	return 1;
 }